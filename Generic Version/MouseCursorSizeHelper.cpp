@@ -10,432 +10,5960 @@
 
 #include <stdint.h>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // !_WIN32
+
+#if defined(_WIN32) && !defined(REG_NOTIFY_THREAD_AGNOSTIC)
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000L // Missing from the SDKs older than Windows 8
+#endif
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif // __linux__
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOUSE_CURSOR_SIZE_HELPER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // _MSC_VER
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MOUSE_CURSOR_SIZE_HELPER_NEON
+#include <arm_neon.h>
+#endif
+
+// Allow the instructions of a SIMD extension in one function, the right one is chosen at runtime
+#if defined(__GNUC__) || defined(__clang__)
+#define MOUSE_CURSOR_SIZE_HELPER_TARGET(Extension) __attribute__((target(Extension)))
+#else
+#define MOUSE_CURSOR_SIZE_HELPER_TARGET(Extension)
+#endif
+
+// Measure the instrumentation of the hot path, compiled out if MOUSE_CURSOR_SIZE_HELPER_STATS is not defined
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+#define STATS_COUNT(Counter, Value) Instrumentation.Counter.fetch_add(uint64_t(Value), std::memory_order_relaxed)
+#define STATS_TIME_SCOPE(Stage) STAGETIMER StageTimer(Stage)
+#define STATS_TIME(Stage, ...) [&] { STAGETIMER StageTimer(Stage); return __VA_ARGS__; }()
+#else
+#define STATS_COUNT(Counter, Value) ((void)0)
+#define STATS_TIME_SCOPE(Stage) ((void)0)
+#define STATS_TIME(Stage, ...) (__VA_ARGS__)
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+
+std::mutex MouseCursorSizeHelper::CacheMutex;
+MouseCursorSizeHelper::CURSORSIZECACHE MouseCursorSizeHelper::SizeCache = {};
+std::atomic<uint64_t> MouseCursorSizeHelper::CacheHits(0);
+std::atomic<uint64_t> MouseCursorSizeHelper::CacheMisses(0);
+std::mutex MouseCursorSizeHelper::PersistentCacheMutex;
+std::string MouseCursorSizeHelper::PersistentCachePath;
+std::mutex MouseCursorSizeHelper::SettingsProviderMutex;
+std::shared_ptr<MouseCursorSizeHelper::SETTINGSPROVIDER> MouseCursorSizeHelper::CurrentSettingsProvider;
+std::mutex MouseCursorSizeHelper::WatcherMutex;
+std::atomic<uint64_t> MouseCursorSizeHelper::PublishedSize(0);
+std::mutex MouseCursorSizeHelper::AsyncQueryMutex;
+std::shared_ptr<MouseCursorSizeHelper::ASYNCQUERY> MouseCursorSizeHelper::InFlightQuery;
+std::mutex MouseCursorSizeHelper::MonitorMutex;
+std::shared_ptr<MouseCursorSizeHelper::MONITORPROVIDER> MouseCursorSizeHelper::CurrentMonitorProvider;
+std::shared_ptr<const MouseCursorSizeHelper::MONITORCURSORSIZES> MouseCursorSizeHelper::MonitorSizes;
+std::atomic<bool> MouseCursorSizeHelper::IsTracingEnabled(false);
+std::mutex MouseCursorSizeHelper::TraceMutex;
+std::vector<std::unique_ptr<MouseCursorSizeHelper::TRACERING>> MouseCursorSizeHelper::TraceRings;
+std::atomic<uint32_t> MouseCursorSizeHelper::TraceThreadsCount(0);
+const std::array<const char*, TRACE_EVENTS_COUNT> MouseCursorSizeHelper::TraceEventNames = {
+	"Query", "ReadSettings", "PurifyPath", "OpenFile", "ReadDirectory", "DecodeFrame", "ApplyMask", "Flip", "Scan", "Scale"
+};
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+MouseCursorSizeHelper::INSTRUMENTATIONCOUNTERS MouseCursorSizeHelper::Instrumentation;
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+MouseCursorSizeHelper::CHANGEWATCHER MouseCursorSizeHelper::Watcher; // Defined after the members used by its thread, which is stopped before they are destroyed
+MouseCursorSizeHelper::ASYNCTHREADS MouseCursorSizeHelper::AsyncThreads; // Defined last to wait for its threads before the other members are destroyed
 
 /**
  * Get the real current mouse cursor size with scales.
+ * The size is memoized and only computed again when the fingerprint
+ * of the cursor file or of the settings changed.
+ * The buffers of the query are reused by the next calls of the same thread.
  *
  * @return The pair of the real mouse cursor width and height.
  */
 std::pair<float, float> MouseCursorSizeHelper::GetCurrentMouseCursorSize()
 {
-	SIZEDATA SizeData;
-	SizeData.width = DEFAULT_IMAGE_CURSOR_SIZE;
-	SizeData.height = DEFAULT_IMAGE_CURSOR_SIZE;
-	SizeData.isRealSize = false;
+	thread_local QUERYWORKSPACE Workspace;
 
-	std::vector<uint32_t> PixelArray = GetPixelArrayOfCurrentMouseImage(&SizeData);
+	return GetCurrentMouseCursorSize(&Workspace);
+}
 
-	// Compute the origin real size of mouse cursor
-	std::pair<float, float> CursorSize = ComputeCursorSizeFromPixelArray(PixelArray, SizeData);
+/**
+ * Get the real current mouse cursor size with scales, with buffers owned by the caller.
+ * The strings and the decoding buffers are only resized, so no heap memory is allocated
+ * once they are large enough for the current cursor.
+ *
+ * @param Workspace the buffers reused from one call to another, used by one thread at a time.
+ * @return The pair of the real mouse cursor width and height.
+ */
+std::pair<float, float> MouseCursorSizeHelper::GetCurrentMouseCursorSize(QUERYWORKSPACE* Workspace)
+{
+	TRACESPAN Span(TRACE_EVENT_QUERY);
+	STATS_TIME_SCOPE(STATS_STAGE_QUERY);
+	STATS_COUNT(calls, 1);
+
+	ReadCurrentFingerprint(Workspace);
+	const CURSORFINGERPRINT& Fingerprint = Workspace->fingerprint;
+	uint64_t Generation = 0;
 
-	if (!SizeData.isRealSize)
 	{
-		// Scale mouse cursor size by DPI
-		ScaleCursorSizeByDPI(&CursorSize);
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+		if (SizeCache.isValid && IsSameFingerprint(SizeCache.fingerprint, Fingerprint))
+		{
+			CacheHits++;
+			STATS_COUNT(cacheHits, 1);
+			return SizeCache.size;
+		}
+		Generation = SizeCache.generation;
+	}
 
-		// Scale mouse cursor size by defined system mouse size
-		ScaleCursorSizeByMouseSystemScale(&CursorSize);
+	CacheMisses++;
+	std::pair<float, float> CursorSize;
+	if (!LoadPersistentCursorSize(Fingerprint, &CursorSize))
+	{
+		CURSORSIZERECORD Record;
+		CursorSize = ComputeCurrentMouseCursorSize(Fingerprint.settings, Workspace, &Record);
+		StorePersistentCursorSize(Fingerprint, &Record);
 	}
 
-	// Ceil mouse cursor size
-	CeilPair(&CursorSize);
+	// The assignment reuses the capacity of the memoized path. A size computed
+	// while the cache was invalidated may be outdated, so it is not memoized
+	std::lock_guard<std::mutex> Lock(CacheMutex);
+	if (SizeCache.generation == Generation)
+	{
+		SizeCache.isValid = true;
+		SizeCache.fingerprint = Fingerprint;
+		SizeCache.size = CursorSize;
+	}
 
 	return CursorSize;
 }
 
 /**
- * Initialize FirstLastIndexes structure.
+ * Forget the memoized mouse cursor size. The next call of
+ * GetCurrentMouseCursorSize will compute the size again.
+ * The change watcher, if running, publishes the size again.
+ */
+void MouseCursorSizeHelper::Invalidate()
+{
+	{
+		std::lock_guard<std::mutex> Lock(CacheMutex);
+		SizeCache.isValid = false;
+		SizeCache.generation++;
+	}
+
+	WakeChangeWatcher();
+}
+
+/**
+ * Get the counters of the memoized mouse cursor size.
  *
- * @return The initialized FirstLastIndexes structure.
+ * @return The number of cache hits and misses since the start of the program.
  */
-MouseCursorSizeHelper::FIRSTLASTINDEXES MouseCursorSizeHelper::InitFirstLastIndexesStruct()
+MouseCursorSizeHelper::CACHESTATISTICS MouseCursorSizeHelper::GetCacheStatistics()
 {
-	FIRSTLASTINDEXES IndexesStruct;
+	CACHESTATISTICS Statistics;
+	Statistics.hits = CacheHits.load();
+	Statistics.misses = CacheMisses.load();
 
-	IndexesStruct.lastYValue = -1; // Negative value to take first line in account for height calculation
-	IndexesStruct.firstIndexHeight = 0;
-	IndexesStruct.lastIndexHeight = 0;
-	IndexesStruct.firstIndexWidth = 0;
-	IndexesStruct.lastIndexWidth = 0;
-	IndexesStruct.isFirstIndexHeightFound = false;
-	IndexesStruct.isFirstIndexWidthFound = false;
+	return Statistics;
+}
 
-	return IndexesStruct;
+/**
+ * Enable a persistent cache of the computed sizes, stored in a file shared by all the
+ * processes. At startup, a cached size is read back without opening the cursor file.
+ *
+ * @param Path the path of the cache file, an empty path to disable the persistent cache.
+ */
+void MouseCursorSizeHelper::SetPersistentCachePath(const std::string& Path)
+{
+	std::lock_guard<std::mutex> Lock(PersistentCacheMutex);
+	PersistentCachePath = Path;
 }
 
 /**
- * Get the index of the smallest frame in array of pictures.
+ * Change the source of the settings read by each query. The memoized size is kept
+ * until the settings read differ from the ones it was computed with.
  *
- * @param Pictures the array of pictures.
- * @return The index of the smallest frame in array of pictures.
+ * @param Provider the provider of the settings, nullptr to use the one of the platform again.
  */
-int MouseCursorSizeHelper::GetIndexOfSmallestPicture(const std::vector<ICONDIRENTRY>& Pictures)
+void MouseCursorSizeHelper::SetSettingsProvider(const std::shared_ptr<SETTINGSPROVIDER>& Provider)
 {
-	int Index = -1;
-	uint64_t ImageSize = 0xffffffffffffffff; // The MAX value of uint64_t
+	{
+		std::lock_guard<std::mutex> Lock(SettingsProviderMutex);
+		CurrentSettingsProvider = Provider;
+	}
+
+	WakeChangeWatcher();
+}
 
-	for (int i = 0; i < Pictures.size(); i++)
+/**
+ * Start a background thread publishing the mouse cursor size again each time the cursor
+ * file or the settings change. The changes are notified by the system when possible
+ * (inotify on Linux, registry notifications on Windows) and polled otherwise.
+ * A first size is published before returning.
+ *
+ * @param PollInterval the maximum time in milliseconds between two checks of the settings (for example WATCHER_DEFAULT_POLL_INTERVAL).
+ * @return True if the watcher was started, false if it was already running.
+ */
+bool MouseCursorSizeHelper::StartChangeWatcher(const uint32_t& PollInterval)
+{
+	std::lock_guard<std::mutex> Lock(WatcherMutex);
+	if (Watcher.isRunning)
 	{
-		uint64_t EntrySize = uint64_t(Pictures[i].bWidth * Pictures[i].bHeight);
-		if (ImageSize > EntrySize)
+		return false;
+	}
+
+	QUERYWORKSPACE Workspace;
+	PublishMouseCursorSize(GetCurrentMouseCursorSize(&Workspace));
+
+	Watcher.pollInterval = PollInterval;
+	Watcher.watchedDirectory.clear();
+	Watcher.isWakeRequested = false;
+	OpenChangeNotifications();
+
+	Watcher.isRunning = true;
+	Watcher.thread = std::thread(RunChangeWatcher);
+
+	return true;
+}
+
+/**
+ * Stop the background thread started by StartChangeWatcher. The last published size stays readable.
+ */
+void MouseCursorSizeHelper::StopChangeWatcher()
+{
+	std::lock_guard<std::mutex> Lock(WatcherMutex);
+	if (!Watcher.isRunning)
+	{
+		return;
+	}
+
+	Watcher.isRunning = false;
+	SignalChangeWatcher();
+	Watcher.thread.join();
+	CloseChangeNotifications();
+}
+
+/**
+ * Get the mouse cursor size published by the change watcher, without any lock nor system call.
+ * The size and its version are packed in a single atomic value, so they are always consistent.
+ *
+ * @return The last published size and its version, a version of 0 if the watcher was never started.
+ */
+MouseCursorSizeHelper::CURSORSIZESNAPSHOT MouseCursorSizeHelper::GetPublishedMouseCursorSize()
+{
+	uint64_t Packed = PublishedSize.load(std::memory_order_acquire);
+
+	CURSORSIZESNAPSHOT Snapshot;
+	Snapshot.width = float(Packed >> 48);
+	Snapshot.height = float((Packed >> 32) & 0xFFFF);
+	Snapshot.version = uint32_t(Packed);
+
+	return Snapshot;
+}
+
+/**
+ * Get the real current mouse cursor size with scales without blocking the calling thread.
+ * The size is computed by GetCurrentMouseCursorSize on the thread of the executor, so the result
+ * is the one of a synchronous call. The requests made while a computation is in progress share it.
+ *
+ * @param Executor the function running the computation, nullptr to run it on a new thread.
+ * @return The future pair of the real mouse cursor width and height, shared by the coalesced requests.
+ */
+std::shared_future<std::pair<float, float>> MouseCursorSizeHelper::GetCurrentMouseCursorSizeAsync(const TASKEXECUTOR& Executor)
+{
+	return StartAsyncQuery(Executor)->result;
+}
+
+/**
+ * Get the counters and the timings of the queries since the previous snapshot, and reset them.
+ * Each counter is read and reset atomically, but the queries running meanwhile can be
+ * counted in a counter of this snapshot and in another one of the next snapshot.
+ *
+ * @return The counters and the timings of each stage, all zeros if MOUSE_CURSOR_SIZE_HELPER_STATS is not defined.
+ */
+MouseCursorSizeHelper::INSTRUMENTATIONSNAPSHOT MouseCursorSizeHelper::TakeInstrumentationSnapshot()
+{
+	INSTRUMENTATIONSNAPSHOT Snapshot = {};
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+	Snapshot.calls = TakeCounter(&Instrumentation.calls);
+	Snapshot.cacheHits = TakeCounter(&Instrumentation.cacheHits);
+	Snapshot.persistentCacheHits = TakeCounter(&Instrumentation.persistentCacheHits);
+	Snapshot.bytesRead = TakeCounter(&Instrumentation.bytesRead);
+	Snapshot.framesDecoded = TakeCounter(&Instrumentation.framesDecoded);
+	Snapshot.defaultSizeFallbacks = TakeCounter(&Instrumentation.defaultSizeFallbacks);
+	Snapshot.smallestFrameFallbacks = TakeCounter(&Instrumentation.smallestFrameFallbacks);
+
+	for (int i = 0; i < STATS_STAGES_COUNT; i++)
+	{
+		STAGECOUNTERS& Counters = Instrumentation.stages[i];
+		Snapshot.stages[i].count = TakeCounter(&Counters.count);
+		Snapshot.stages[i].totalNanoseconds = TakeCounter(&Counters.totalNanoseconds);
+		Snapshot.stages[i].maxNanoseconds = TakeCounter(&Counters.maxNanoseconds);
+		for (int j = 0; j < STATS_HISTOGRAM_BUCKETS; j++)
 		{
-			Index = i;
-			ImageSize = EntrySize;
+			Snapshot.stages[i].histogram[j] = TakeCounter(&Counters.histogram[j]);
 		}
 	}
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
 
-	return Index;
+	return Snapshot;
 }
 
 /**
- * Get the index of the desired frame in array of pictures.
+ * Enable or disable the tracing of the stages of the queries. Each thread records its spans
+ * in its own ring buffer, without any lock, so a thread recording more than TRACE_RING_CAPACITY
+ * spans between two flushes loses its oldest spans.
  *
- * @param Pictures the array of pictures.
- * @param SizeData the size informations.
- * @return The index of the desired frame in array of pictures.
- * If the desired frame is not founnd, the index of the smallest one is returned.
+ * @param IsEnabled true to record the spans, false to stop recording them.
  */
-int MouseCursorSizeHelper::GetIndexOfDesiredFrame(const std::vector<ICONDIRENTRY>& Pictures, SIZEDATA* SizeData)
+void MouseCursorSizeHelper::SetTracingEnabled(const bool& IsEnabled)
 {
-	int Index = -1;
-	float CursorBaseSize = GetRegistryValueFloat(REG_CURSOR_SOURCES, REG_KEY_CURSOR_BASE_SIZE, -1);
-	float AppliedDPI = GetDPIScale() / 100.0F;
+	IsTracingEnabled.store(IsEnabled, std::memory_order_relaxed);
+}
 
-	if (CursorBaseSize != -1)
+/**
+ * Write the spans recorded since the previous flush to a file, in the trace event format
+ * of Chrome and Perfetto. Each span is a complete event with the identifier of its thread
+ * and the number of bytes it processed. The spans overwritten while they were read are dropped.
+ *
+ * @param Path the path of the trace file, replaced if it exists.
+ * @return True if the trace file was written.
+ */
+bool MouseCursorSizeHelper::FlushTrace(const std::string& Path)
+{
+#ifdef _WIN32
+	std::string ProcessId = std::to_string(GetCurrentProcessId());
+#else
+	std::string ProcessId = std::to_string(getpid());
+#endif // _WIN32
+
+	std::string Trace = "{\"traceEvents\":[";
+	bool IsFirstEvent = true;
 	{
-		float DesiredSize = CursorBaseSize * AppliedDPI;
-		for (int i = 0; i < Pictures.size(); i++)
+		std::lock_guard<std::mutex> Lock(TraceMutex);
+		for (const std::unique_ptr<TRACERING>& Ring : TraceRings)
 		{
-			if (Pictures[i].bWidth == uint8_t(DesiredSize) && Pictures[i].bHeight == uint8_t(DesiredSize))
+			// The spans between the flushed index and the write index are complete
+			uint64_t WriteIndex = Ring->writeIndex.load(std::memory_order_acquire);
+			uint64_t FirstIndex = std::max(Ring->flushedIndex, WriteIndex > TRACE_RING_CAPACITY ? WriteIndex - TRACE_RING_CAPACITY : 0);
+
+			size_t EventsCount = size_t(WriteIndex - FirstIndex);
+			std::vector<uint64_t> Starts(EventsCount), Durations(EventsCount), Bytes(EventsCount);
+			std::vector<uint32_t> Names(EventsCount), ThreadIds(EventsCount);
+			for (size_t i = 0; i < EventsCount; i++)
 			{
-				Index = i;
-				SizeData->isRealSize = true;
-				break;
+				const TRACEEVENT& Event = Ring->events[(FirstIndex + i) % TRACE_RING_CAPACITY];
+				Starts[i] = Event.start.load(std::memory_order_relaxed);
+				Durations[i] = Event.duration.load(std::memory_order_relaxed);
+				Bytes[i] = Event.bytes.load(std::memory_order_relaxed);
+				Names[i] = Event.name.load(std::memory_order_relaxed);
+				ThreadIds[i] = Event.threadId.load(std::memory_order_relaxed);
+			}
+
+			// The spans whose slot was reused by a span started meanwhile may be torn
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t StartIndex = Ring->startIndex.load(std::memory_order_relaxed);
+			Ring->flushedIndex = WriteIndex;
+
+			for (size_t i = 0; i < EventsCount; i++)
+			{
+				if (FirstIndex + i + TRACE_RING_CAPACITY < StartIndex || Names[i] >= uint32_t(TRACE_EVENTS_COUNT))
+				{
+					continue;
+				}
+
+				char Event[256];
+				snprintf(Event, sizeof(Event),
+					"%s\n{\"name\":\"%s\",\"cat\":\"MouseCursorSizeHelper\",\"ph\":\"X\",\"ts\":%llu.%03llu,\"dur\":%llu.%03llu,\"pid\":%s,\"tid\":%u,\"args\":{\"bytes\":%llu}}",
+					IsFirstEvent ? "" : ",", TraceEventNames[Names[i]],
+					static_cast<unsigned long long>(Starts[i] / 1000), static_cast<unsigned long long>(Starts[i] % 1000),
+					static_cast<unsigned long long>(Durations[i] / 1000), static_cast<unsigned long long>(Durations[i] % 1000),
+					ProcessId.c_str(), ThreadIds[i], static_cast<unsigned long long>(Bytes[i]));
+				Trace += Event;
+				IsFirstEvent = false;
 			}
 		}
 	}
+	Trace += "\n],\"displayTimeUnit\":\"ns\"}\n";
 
-	if (Index == -1)
+	return ReplaceFileAtomically(Path, std::vector<uint8_t>(Trace.begin(), Trace.end()));
+}
+
+/**
+ * Change the source of the monitors of the table of the sizes by monitor.
+ * The table is only built again by the next call of UpdateMonitorCursorSizes.
+ *
+ * @param Provider the provider of the monitors, nullptr to use the one of the system again.
+ */
+void MouseCursorSizeHelper::SetMonitorProvider(const std::shared_ptr<MONITORPROVIDER>& Provider)
+{
+	std::lock_guard<std::mutex> Lock(MonitorMutex);
+	CurrentMonitorProvider = Provider;
+}
+
+/**
+ * Build again the table of the real mouse cursor size on each attached monitor.
+ * The settings are read once, then the size is computed once for each distinct
+ * DPI scale with the DPI scale of the settings replaced by the one of the monitors.
+ * The scales out of the table are computed for each of their monitors.
+ *
+ * @return The new table, whose lookups are a single array index.
+ */
+std::shared_ptr<const MouseCursorSizeHelper::MONITORCURSORSIZES> MouseCursorSizeHelper::UpdateMonitorCursorSizes()
+{
+	std::shared_ptr<MONITORCURSORSIZES> Table = std::make_shared<MONITORCURSORSIZES>();
+	Table->dpiScaleSizes.fill(std::pair<float, float>(0.0F, 0.0F));
+
+	CURSORSETTINGS Settings;
+	ReadCursorSettings(&Settings);
+	GetMonitorProvider()->EnumerateMonitors(&Table->monitors);
+	if (Table->monitors.empty())
 	{
-		Index = GetIndexOfSmallestPicture(Pictures);
+		Table->monitors.push_back(MONITORDPI{ 0, Settings.dpiScale });
 	}
 
-	return Index;
+	QUERYWORKSPACE Workspace;
+	for (const MONITORDPI& Monitor : Table->monitors)
+	{
+		long DpiScaleIndex = std::lround(Monitor.dpiScale);
+		Settings.dpiScale = Monitor.dpiScale;
+		if (DpiScaleIndex < 0 || DpiScaleIndex > MONITOR_MAX_DPI_SCALE)
+		{
+			// Clamping would give a monitor the size computed for another scale
+			Table->monitorSizes.push_back(ComputeCurrentMouseCursorSize(Settings, &Workspace, nullptr));
+			continue;
+		}
+
+		// An empty cursor has a size of {0, 0}, so the computed scales are kept apart
+		if (!Table->dpiScaleComputed[size_t(DpiScaleIndex)])
+		{
+			Table->dpiScaleSizes[size_t(DpiScaleIndex)] = ComputeCurrentMouseCursorSize(Settings, &Workspace, nullptr);
+			Table->dpiScaleComputed[size_t(DpiScaleIndex)] = true;
+		}
+		Table->monitorSizes.push_back(Table->dpiScaleSizes[size_t(DpiScaleIndex)]);
+	}
+
+	std::lock_guard<std::mutex> Lock(MonitorMutex);
+	MonitorSizes = Table;
+
+	return MonitorSizes;
+}
+
+/**
+ * Get the table of the real mouse cursor size on each attached monitor,
+ * built on the first call. The table is immutable and can be kept by the caller
+ * until the next update.
+ *
+ * @return The current table, whose lookups are a single array index.
+ */
+std::shared_ptr<const MouseCursorSizeHelper::MONITORCURSORSIZES> MouseCursorSizeHelper::GetMonitorCursorSizes()
+{
+	{
+		std::lock_guard<std::mutex> Lock(MonitorMutex);
+		if (MonitorSizes != nullptr)
+		{
+			return MonitorSizes;
+		}
+	}
+
+	return UpdateMonitorCursorSizes();
+}
+
+/**
+ * Get the real mouse cursor size on a monitor.
+ *
+ * @param MonitorIndex the index of the monitor in the list of the attached monitors.
+ * @return The pair of the real mouse cursor width and height on the monitor, the one of the first monitor if the index is out of the list.
+ */
+std::pair<float, float> MouseCursorSizeHelper::MONITORCURSORSIZES::GetSizeOfMonitor(const size_t& MonitorIndex) const
+{
+	return monitorSizes[MonitorIndex < monitorSizes.size() ? MonitorIndex : 0];
+}
+
+/**
+ * Get the real mouse cursor size for a DPI scale of an attached monitor.
+ *
+ * @param DpiScale the DPI scale in percent, rounded to the nearest integer.
+ * @return The pair of the real mouse cursor width and height, {0, 0} if no monitor has this DPI scale.
+ */
+std::pair<float, float> MouseCursorSizeHelper::MONITORCURSORSIZES::GetSizeOfDpiScale(const float& DpiScale) const
+{
+	long DpiScaleIndex = std::lround(DpiScale);
+	if (DpiScaleIndex < 0 || DpiScaleIndex > MONITOR_MAX_DPI_SCALE)
+	{
+		return std::pair<float, float>(0.0F, 0.0F);
+	}
+
+	return dpiScaleSizes[size_t(DpiScaleIndex)];
+}
+
+/**
+ * Find a monitor by its handle, to keep its index for the next lookups.
+ *
+ * @param Handle the handle of the monitor given by the system.
+ * @return The index of the monitor, -1 if it is not attached.
+ */
+int MouseCursorSizeHelper::MONITORCURSORSIZES::FindMonitor(const uint64_t& Handle) const
+{
+	for (size_t i = 0; i < monitors.size(); i++)
+	{
+		if (monitors[i].handle == Handle)
+		{
+			return int(i);
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Get the real sizes of all the mouse cursors of the current scheme with scales.
+ * The settings are read once for all the cursors and the cursor files are decoded concurrently.
+ * A role not resolved by the settings provider gets the size of the cursor file of the settings.
+ *
+ * @return The pair of the real mouse cursor width and height of each cursor role (Arrow, Hand, IBeam...).
+ */
+std::map<std::string, std::pair<float, float>> MouseCursorSizeHelper::GetCurrentMouseCursorSchemeSizes()
+{
+	std::map<std::string, std::pair<float, float>> SchemeSizes = {};
+	std::shared_ptr<SETTINGSPROVIDER> Provider = GetSettingsProvider();
+	CURSORSETTINGS Settings;
+	ReadCursorSettings(*Provider, &Settings);
+	const size_t RolesCount = std::size(REG_KEYS_CURSOR_ROLES);
+	std::vector<CURSORSETTINGS> RolesSettings(RolesCount, Settings);
+	std::vector<std::pair<float, float>> CursorSizes(RolesCount);
+
+	// The paths are resolved on the calling thread, the provider may not be thread safe for them
+	for (size_t i = 0; i < RolesCount; i++)
+	{
+		if (!Provider->ReadRolePath(REG_KEYS_CURSOR_ROLES[i], &RolesSettings[i].cursorPath))
+		{
+			RolesSettings[i].cursorPath = Settings.cursorPath;
+		}
+	}
+
+	// Each task only writes the size of its own cursor role
+	RunInParallel(RolesCount, [&](size_t Index) {
+		QUERYWORKSPACE Workspace;
+		CursorSizes[Index] = ComputeCurrentMouseCursorSize(RolesSettings[Index], &Workspace, nullptr);
+	});
+
+	for (size_t i = 0; i < RolesCount; i++)
+	{
+		SchemeSizes.insert({ REG_KEYS_CURSOR_ROLES[i], CursorSizes[i] });
+	}
+
+	return SchemeSizes;
+}
+
+/**
+ * Analyze a cursor file without reading any system setting.
+ *
+ * @param Path the path of the cursor file.
+ * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+ * @param Info the informations about the chosen frame of the file.
+ * @return True if the file is a cursor file with a supported frame.
+ */
+bool MouseCursorSizeHelper::AnalyzeCursorFile(const std::string& Path, const int& DesiredSize, CURSORFILEINFO* Info)
+{
+	bool IsAnalyzed = false;
+	CURSORSETTINGS Settings;
+	Settings.cursorPath = Path;
+	Settings.cursorBaseSize = float(DesiredSize);
+	Settings.mouseScale = DEFAULT_MOUSE_SCALE;
+	Settings.dpiScale = 100.0F; // The desired size is not scaled by the DPI
+
+	MAPPEDFILE File;
+	if (OpenMappedFile(Path, &File))
+	{
+		FRAMEVIEW Frame;
+		SIZEDATA SizeData;
+		SizeData.isRealSize = false;
+
+		IsAnalyzed = GetCursorFrame(File.view, Settings, &Frame, &SizeData);
+		if (IsAnalyzed)
+		{
+			QUERYWORKSPACE Workspace;
+			std::pair<float, float> TrimmedSize = ComputeCursorSizeFromFrame(Frame, SizeData, &Workspace);
+
+			Info->frameIndex = Frame.index;
+			Info->frameWidth = SizeData.width;
+			Info->frameHeight = SizeData.height;
+			Info->trimmedWidth = TrimmedSize.first;
+			Info->trimmedHeight = TrimmedSize.second;
+			Info->hotspotX = Frame.hotspotX;
+			Info->hotspotY = Frame.hotspotY;
+			Info->isRealSize = SizeData.isRealSize;
+		}
+
+		CloseMappedFile(&File);
+	}
+
+	return IsAnalyzed;
+}
+
+/**
+ * Analyze all the frames of a cursor file once, to get the real mouse cursor size
+ * for any settings without decoding the file again. The frames are chosen later
+ * with the same rules as the queries: the frame of the exact size, or the smallest one,
+ * in a .cur file, and the frame of the nearest nominal size in an Xcursor file.
+ *
+ * @param Path the path of the cursor file.
+ * @param Metrics the trimmed size and the hotspot of each frame of the file.
+ * @return True if the file is a .cur or an Xcursor file with at least one frame.
+ */
+bool MouseCursorSizeHelper::AnalyzeCursorMetrics(const std::string& Path, CURSORMETRICS* Metrics)
+{
+	Metrics->frames.clear();
+	Metrics->defaultFrameIndex = 0;
+	Metrics->isNearestSize = false;
+
+	MAPPEDFILE File;
+	if (!OpenMappedFile(Path, &File))
+	{
+		return false;
+	}
+
+	QUERYWORKSPACE Workspace;
+	ICONDIR Header;
+	BYTEVIEW Directory;
+	if (ReadIconDir(File.view, &Header) && Header.idType == 2
+		&& GetSubView(File.view, sizeof(ICONDIR), size_t(Header.idCount) * sizeof(ICONDIRENTRY), &Directory))
+	{
+		ICONDIRENTRY Entry;
+		for (int i = 0; i < Header.idCount && ReadIconDirEntry(Directory, i, &Entry); i++)
+		{
+			FRAMEVIEW Frame = {};
+			SIZEDATA SizeData = { Entry.bWidth, Entry.bHeight, false, false, 0, 0 };
+			if (!GetCursorFrameOfEntry(File.view, Directory, i, &Frame, &SizeData))
+			{
+				Frame = {};
+			}
+
+			// The frame is only the real size if its width and height are both the desired size
+			int NominalSize = Entry.bWidth == Entry.bHeight ? int(Entry.bWidth) : -1;
+			Metrics->frames.push_back(ComputeFrameMetrics(Frame, SizeData, NominalSize, &Workspace));
+		}
+		Metrics->defaultFrameIndex = std::max(GetIndexOfSmallestPicture(Directory, int(Metrics->frames.size())), 0);
+	}
+	else if (IsXcursorFile(File.view))
+	{
+		XCURSORINDEX Index;
+		if (IndexXcursorFile(File.view, &Index))
+		{
+			for (int i = 0; i < Index.sizesCount; i++)
+			{
+				FRAMEVIEW Frame = {};
+				SIZEDATA SizeData = { 0, 0, false, false, 0, 0 };
+				if (!GetXcursorFrameView(File.view, Index.sizes[i], &Frame, &SizeData))
+				{
+					Frame = {};
+				}
+				Metrics->frames.push_back(ComputeFrameMetrics(Frame, SizeData, int(Index.sizes[i].nominalSize), &Workspace));
+			}
+		}
+		Metrics->isNearestSize = true;
+	}
+
+	CloseMappedFile(&File);
+
+	return !Metrics->frames.empty();
+}
+
+/**
+ * Get the frame chosen for a cursor base size and a DPI scale, like a query would.
+ *
+ * @param CursorBaseSize the cursor base size, -1 if not defined.
+ * @param DpiScale the DPI scale in percent.
+ * @param IsRealSize true if the chosen frame has the desired size, so its size is not scaled.
+ * @return The metrics of the chosen frame.
+ */
+const MouseCursorSizeHelper::CURSORFRAMEMETRICS& MouseCursorSizeHelper::CURSORMETRICS::SelectFrame(const float& CursorBaseSize, const float& DpiScale, bool* IsRealSize) const
+{
+	float DesiredSize = CursorBaseSize != -1 ? CursorBaseSize * (DpiScale / 100.0F) : 0;
+	size_t Index = size_t(defaultFrameIndex);
+	*IsRealSize = false;
+
+	if (isNearestSize)
+	{
+		// On equal distances, the first frame is kept
+		Index = 0;
+		for (size_t i = 1; i < frames.size(); i++)
+		{
+			if (std::fabs(float(frames[i].nominalSize) - DesiredSize) < std::fabs(float(frames[Index].nominalSize) - DesiredSize))
+			{
+				Index = i;
+			}
+		}
+		*IsRealSize = CursorBaseSize != -1 && uint32_t(frames[Index].nominalSize) == uint32_t(DesiredSize);
+	}
+	else if (CursorBaseSize != -1)
+	{
+		// The sizes are compared as the bytes of the directory of the file
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			if (frames[i].nominalSize == int(uint8_t(DesiredSize)))
+			{
+				Index = i;
+				*IsRealSize = true;
+				break;
+			}
+		}
+	}
+
+	return frames[Index];
+}
+
+/**
+ * Get the real mouse cursor size for some settings, without decoding the file again.
+ * The size is scaled and ceiled like in ComputeCurrentMouseCursorSize.
+ *
+ * @param CursorBaseSize the cursor base size, -1 if not defined.
+ * @param MouseScale the mouse cursor size multiplier.
+ * @param DpiScale the DPI scale in percent.
+ * @return The pair of the real mouse cursor width and height, as computed by a query with these settings.
+ */
+std::pair<float, float> MouseCursorSizeHelper::CURSORMETRICS::GetSize(const float& CursorBaseSize, const float& MouseScale, const float& DpiScale) const
+{
+	bool IsRealSize = false;
+	const CURSORFRAMEMETRICS& Frame = SelectFrame(CursorBaseSize, DpiScale, &IsRealSize);
+	std::pair<float, float> CursorSize(Frame.trimmedWidth, Frame.trimmedHeight);
+
+	if (!IsRealSize)
+	{
+		ScaleCursorSizeByDPI(&CursorSize, DpiScale);
+		ScaleCursorSizeByMouseSystemScale(&CursorSize, MouseScale);
+	}
+	CeilPair(&CursorSize);
+
+	return CursorSize;
+}
+
+/**
+ * Get the real mouse cursor size for a size of the accessibility settings of Windows,
+ * whose cursor base size is 32 pixels plus 16 pixels by step above 1.
+ *
+ * @param Scale the size of the accessibility settings, from CURSOR_MIN_SCALE to CURSOR_MAX_SCALE.
+ * @param DpiScale the DPI scale in percent.
+ * @return The pair of the real mouse cursor width and height.
+ */
+std::pair<float, float> MouseCursorSizeHelper::CURSORMETRICS::GetSizeOfScale(const int& Scale, const float& DpiScale) const
+{
+	float CursorBaseSize = float(DEFAULT_IMAGE_CURSOR_SIZE + CURSOR_BASE_SIZE_PER_SCALE * (Scale - CURSOR_MIN_SCALE));
+
+	return GetSize(CursorBaseSize, float(Scale), DpiScale);
+}
+
+/**
+ * Get the real mouse cursor sizes for all the sizes of the accessibility settings of Windows.
+ *
+ * @param DpiScale the DPI scale in percent.
+ * @return The pair of the real mouse cursor width and height of each size, from CURSOR_MIN_SCALE to CURSOR_MAX_SCALE.
+ */
+std::array<std::pair<float, float>, CURSOR_SCALES_COUNT> MouseCursorSizeHelper::CURSORMETRICS::GetSizesOfScales(const float& DpiScale) const
+{
+	std::array<std::pair<float, float>, CURSOR_SCALES_COUNT> Sizes;
+	for (int i = 0; i < CURSOR_SCALES_COUNT; i++)
+	{
+		Sizes[i] = GetSizeOfScale(CURSOR_MIN_SCALE + i, DpiScale);
+	}
+
+	return Sizes;
+}
+
+/**
+ * Decode the frame of a cursor file chosen for a desired size, and locate its visible part
+ * and its hotspot in the decoded pixels. The frame is decoded once, in the order of its lines
+ * in the file, and the visible part is the bounding box of its visible pixels.
+ *
+ * @param Path the path of the cursor file.
+ * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+ * @param Sprite the decoded pixels of the chosen frame, with its visible part and its hotspot.
+ * @return True if the file is a cursor file with a supported frame.
+ */
+bool MouseCursorSizeHelper::ExtractCursorSprite(const std::string& Path, const int& DesiredSize, CURSORSPRITE* Sprite)
+{
+	bool IsExtracted = false;
+	CURSORSETTINGS Settings;
+	Settings.cursorPath = Path;
+	Settings.cursorBaseSize = float(DesiredSize);
+	Settings.mouseScale = DEFAULT_MOUSE_SCALE;
+	Settings.dpiScale = 100.0F; // The desired size is not scaled by the DPI
+
+	MAPPEDFILE File;
+	if (OpenMappedFile(Path, &File))
+	{
+		FRAMEVIEW Frame;
+		SIZEDATA SizeData;
+		SizeData.isRealSize = false;
+
+		if (GetCursorFrame(File.view, Settings, &Frame, &SizeData))
+		{
+			Sprite->pixels = ExtractPixels(Frame, SizeData);
+			IsExtracted = !Sprite->pixels.empty();
+		}
+
+		if (IsExtracted)
+		{
+			QUERYWORKSPACE Workspace;
+			BOUNDINGBOX Box = ComputeFrameBoundingBox(Frame, SizeData, &Workspace);
+
+			Sprite->frameIndex = Frame.index;
+			Sprite->frameWidth = SizeData.width;
+			Sprite->frameHeight = SizeData.height;
+			Sprite->isBottomUp = SizeData.isBottomUp;
+
+			// The box is relative to the hotspot, so the hotspot is at its opposite from the first visible pixel
+			Sprite->trimmedLeft = Box.isEmpty ? 0 : Frame.hotspotX + Box.left;
+			Sprite->trimmedTop = Box.isEmpty ? 0 : Frame.hotspotY + Box.top;
+			Sprite->trimmedWidth = Box.isEmpty ? 0 : Box.right - Box.left + 1;
+			Sprite->trimmedHeight = Box.isEmpty ? 0 : Box.bottom - Box.top + 1;
+			Sprite->hotspotX = Frame.hotspotX - Sprite->trimmedLeft;
+			Sprite->hotspotY = Frame.hotspotY - Sprite->trimmedTop;
+		}
+
+		CloseMappedFile(&File);
+	}
+
+	return IsExtracted;
+}
+
+/**
+ * Get the visible part of the frame as a view on the decoded pixels, without any copy.
+ * The lines of a bottom-up frame are walked backwards with a negative stride.
+ *
+ * @return The view on the visible pixels, from top to bottom.
+ */
+MouseCursorSizeHelper::SPRITEVIEW MouseCursorSizeHelper::CURSORSPRITE::GetTrimmedView() const
+{
+	SPRITEVIEW View;
+	View.pixels = nullptr;
+	View.stride = isBottomUp ? -ptrdiff_t(frameWidth) : ptrdiff_t(frameWidth);
+	View.width = trimmedWidth;
+	View.height = trimmedHeight;
+
+	if (trimmedWidth > 0 && trimmedHeight > 0)
+	{
+		int TopLine = isBottomUp ? frameHeight - 1 - trimmedTop : trimmedTop;
+		View.pixels = pixels.data() + size_t(TopLine) * size_t(frameWidth) + size_t(trimmedLeft);
+	}
+
+	return View;
+}
+
+/**
+ * Get a line of the view, without any copy.
+ *
+ * @param IndexY the index of the line, from the top of the view.
+ * @return The first pixel of the line.
+ */
+const uint32_t* MouseCursorSizeHelper::SPRITEVIEW::GetLine(const int& IndexY) const
+{
+	return pixels + ptrdiff_t(IndexY) * stride;
+}
+
+/**
+ * Compute the real current mouse cursor size with scales, without the memoized size.
+ *
+ * @param Settings the settings read from the system.
+ * @param Workspace the buffers used to decode the cursor file.
+ * @param Record the record receiving the sizes and the hotspot to store in the persistent cache, nullptr if not needed.
+ * @return The pair of the real mouse cursor width and height.
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCurrentMouseCursorSize(const CURSORSETTINGS& Settings, QUERYWORKSPACE* Workspace, CURSORSIZERECORD* Record)
+{
+	SIZEDATA SizeData;
+	SizeData.width = DEFAULT_IMAGE_CURSOR_SIZE;
+	SizeData.height = DEFAULT_IMAGE_CURSOR_SIZE;
+	SizeData.isRealSize = false;
+	SizeData.isBottomUp = false;
+	SizeData.hotspotX = 0;
+	SizeData.hotspotY = 0;
+
+	// Compute the origin real size of mouse cursor
+	std::pair<float, float> CursorSize = GetCursorSizeOfCurrentMouseImage(Settings, &SizeData, Workspace);
+	if (Record != nullptr)
+	{
+		Record->baseWidth = CursorSize.first;
+		Record->baseHeight = CursorSize.second;
+		Record->hotspotX = SizeData.hotspotX;
+		Record->hotspotY = SizeData.hotspotY;
+		Record->isRealSize = SizeData.isRealSize;
+	}
+
+	if (!SizeData.isRealSize)
+	{
+		TRACESPAN Span(TRACE_EVENT_SCALE);
+		STATS_TIME_SCOPE(STATS_STAGE_SCALE);
+
+		// Scale mouse cursor size by DPI
+		ScaleCursorSizeByDPI(&CursorSize, Settings.dpiScale);
+
+		// Scale mouse cursor size by defined system mouse size
+		ScaleCursorSizeByMouseSystemScale(&CursorSize, Settings.mouseScale);
+	}
+
+	// Ceil mouse cursor size
+	CeilPair(&CursorSize);
+
+	if (Record != nullptr)
+	{
+		Record->width = CursorSize.first;
+		Record->height = CursorSize.second;
+	}
+
+	return CursorSize;
+}
+
+/**
+ * Get the current provider of the settings, created for the platform on the first call.
+ *
+ * @return The provider of the settings read by the queries.
+ */
+std::shared_ptr<MouseCursorSizeHelper::SETTINGSPROVIDER> MouseCursorSizeHelper::GetSettingsProvider()
+{
+	std::lock_guard<std::mutex> Lock(SettingsProviderMutex);
+	if (CurrentSettingsProvider == nullptr)
+	{
+#ifdef _WIN32
+		CurrentSettingsProvider = std::make_shared<REGISTRYSETTINGSPROVIDER>();
+#else
+		CurrentSettingsProvider = std::make_shared<XCURSORSETTINGSPROVIDER>();
+#endif // _WIN32
+	}
+
+	return CurrentSettingsProvider;
+}
+
+/**
+ * Get the current provider of the monitors, the one of the system if none was set.
+ *
+ * @return The provider of the monitors of the table of the sizes by monitor.
+ */
+std::shared_ptr<MouseCursorSizeHelper::MONITORPROVIDER> MouseCursorSizeHelper::GetMonitorProvider()
+{
+	std::lock_guard<std::mutex> Lock(MonitorMutex);
+	if (CurrentMonitorProvider == nullptr)
+	{
+		CurrentMonitorProvider = std::make_shared<SYSTEMMONITORPROVIDER>();
+	}
+
+	return CurrentMonitorProvider;
+}
+
+/**
+ * Build again the table of the sizes by monitor if it was already built,
+ * so its readers follow the changes of the settings.
+ */
+void MouseCursorSizeHelper::RefreshMonitorCursorSizes()
+{
+	bool IsBuilt = false;
+	{
+		std::lock_guard<std::mutex> Lock(MonitorMutex);
+		IsBuilt = MonitorSizes != nullptr;
+	}
+
+	if (IsBuilt)
+	{
+		UpdateMonitorCursorSizes();
+	}
+}
+
+/**
+ * Stop the change watcher still running at the end of the program, before its thread is destroyed.
+ */
+MouseCursorSizeHelper::CHANGEWATCHER::~CHANGEWATCHER()
+{
+	StopChangeWatcher();
+}
+
+/**
+ * Wait for the changes of the cursor file and of the settings, and publish the size after each one.
+ * The settings are read again after each wake up, and the size is only computed again when the
+ * fingerprint of the cursor changed.
+ */
+void MouseCursorSizeHelper::RunChangeWatcher()
+{
+	QUERYWORKSPACE Workspace;
+	PublishMouseCursorSize(GetCurrentMouseCursorSize(&Workspace));
+
+	while (Watcher.isRunning)
+	{
+		// The watched directory follows the cursor file chosen by the settings
+		WatchCursorDirectory(Workspace.fingerprint.settings.cursorPath);
+		if (WaitForChange() && Watcher.isRunning)
+		{
+			// The poll interval is meant for the settings sending no notification, so the whole
+			// snapshot is read again instead of trusting the generation of the provider
+			Workspace.settingsProvider = nullptr;
+			PublishMouseCursorSize(GetCurrentMouseCursorSize(&Workspace));
+			RefreshMonitorCursorSizes();
+		}
+	}
+}
+
+/**
+ * Publish a mouse cursor size for the readers of GetPublishedMouseCursorSize.
+ * The width, the height and the version are packed in 16, 16 and 32 bits.
+ * The version is only incremented when the size changed. Only one thread publishes at a time.
+ *
+ * @param CursorSize the real mouse cursor size with scales, already ceiled.
+ */
+void MouseCursorSizeHelper::PublishMouseCursorSize(const std::pair<float, float>& CursorSize)
+{
+	uint64_t Previous = PublishedSize.load(std::memory_order_relaxed);
+	uint64_t Width = uint64_t(std::min(std::max(CursorSize.first, 0.0F), PUBLISHED_MAX_SIZE));
+	uint64_t Height = uint64_t(std::min(std::max(CursorSize.second, 0.0F), PUBLISHED_MAX_SIZE));
+	uint64_t SizeBits = (Width << 48) | (Height << 32);
+
+	if ((Previous & 0xFFFFFFFF00000000) != SizeBits || uint32_t(Previous) == 0)
+	{
+		// The version 0 is kept for the snapshot published by nobody
+		uint32_t Version = uint32_t(Previous) + 1;
+		PublishedSize.store(SizeBits | (Version != 0 ? Version : 1), std::memory_order_release);
+	}
+}
+
+/**
+ * Wake the change watcher up if it is running, so it checks the settings again.
+ */
+void MouseCursorSizeHelper::WakeChangeWatcher()
+{
+	std::lock_guard<std::mutex> Lock(WatcherMutex);
+	if (Watcher.isRunning)
+	{
+		SignalChangeWatcher();
+	}
+}
+
+/**
+ * Signal the change watcher to stop waiting. The watcher must have its notifications opened.
+ */
+void MouseCursorSizeHelper::SignalChangeWatcher()
+{
+#if defined(_WIN32)
+	SetEvent(Watcher.wakeEvent);
+#elif defined(__linux__)
+	uint64_t Value = 1;
+	ssize_t Written = write(Watcher.wakeDescriptor, &Value, sizeof(Value));
+	(void)Written;
+#else
+	std::lock_guard<std::mutex> Lock(Watcher.wakeMutex);
+	Watcher.isWakeRequested = true;
+	Watcher.wakeCondition.notify_one();
+#endif // _WIN32
+}
+
+/**
+ * Open the notifications of the system waking the change watcher up.
+ * A notification which can't be opened is replaced by the polling.
+ */
+void MouseCursorSizeHelper::OpenChangeNotifications()
+{
+#if defined(_WIN32)
+	Watcher.wakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+	Watcher.directoryNotification = INVALID_HANDLE_VALUE;
+
+	const LPCSTR Locations[2] = { REG_CURSOR_SOURCES, REG_ACCESSIBILITY_GROUP };
+	for (size_t i = 0; i < Watcher.registryKeys.size(); i++)
+	{
+		Watcher.registryEvents[i] = CreateEventA(NULL, FALSE, FALSE, NULL);
+		if (RegOpenKeyExA(HKEY_CURRENT_USER, Locations[i], 0, KEY_NOTIFY, &Watcher.registryKeys[i]) != ERROR_SUCCESS)
+		{
+			Watcher.registryKeys[i] = NULL;
+		}
+		else
+		{
+			RegNotifyChangeKeyValue(Watcher.registryKeys[i], FALSE, REG_NOTIFY_CHANGE_LAST_SET, Watcher.registryEvents[i], TRUE);
+		}
+	}
+#elif defined(__linux__)
+	Watcher.wakeDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	Watcher.notifyDescriptor = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	Watcher.directoryWatch = -1;
+	Watcher.resourcesWatch = -1;
+
+	// The X resources file is in the home directory
+	const char* Home = getenv("HOME");
+	if (Watcher.notifyDescriptor >= 0 && Home != nullptr)
+	{
+		Watcher.resourcesWatch = inotify_add_watch(Watcher.notifyDescriptor, Home, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+	}
+#endif // _WIN32
+}
+
+/**
+ * Close the notifications opened by OpenChangeNotifications.
+ */
+void MouseCursorSizeHelper::CloseChangeNotifications()
+{
+#if defined(_WIN32)
+	for (size_t i = 0; i < Watcher.registryKeys.size(); i++)
+	{
+		if (Watcher.registryKeys[i] != NULL)
+		{
+			RegCloseKey(Watcher.registryKeys[i]);
+		}
+		CloseHandle(Watcher.registryEvents[i]);
+	}
+
+	if (Watcher.directoryNotification != INVALID_HANDLE_VALUE)
+	{
+		FindCloseChangeNotification(Watcher.directoryNotification);
+	}
+	CloseHandle(Watcher.wakeEvent);
+#elif defined(__linux__)
+	// Closing the inotify instance removes all its watches
+	if (Watcher.notifyDescriptor >= 0)
+	{
+		close(Watcher.notifyDescriptor);
+	}
+	if (Watcher.wakeDescriptor >= 0)
+	{
+		close(Watcher.wakeDescriptor);
+	}
+#endif // _WIN32
+}
+
+/**
+ * Watch the directory of the cursor file, instead of the directory watched before.
+ * The directory is watched rather than the file, to be notified when the file is replaced.
+ *
+ * @param CursorPath the path of the cursor file, empty if there is none.
+ */
+void MouseCursorSizeHelper::WatchCursorDirectory(const std::string& CursorPath)
+{
+	size_t Separator = CursorPath.find_last_of("\\/");
+	size_t DirectorySize = Separator == std::string::npos ? 0 : std::max<size_t>(Separator, 1);
+	if (Watcher.watchedDirectory.compare(0, std::string::npos, CursorPath, 0, DirectorySize) == 0)
+	{
+		return;
+	}
+
+	Watcher.watchedDirectory.assign(CursorPath, 0, DirectorySize);
+
+#if defined(_WIN32)
+	if (Watcher.directoryNotification != INVALID_HANDLE_VALUE)
+	{
+		FindCloseChangeNotification(Watcher.directoryNotification);
+	}
+
+	Watcher.directoryNotification = Watcher.watchedDirectory.empty()
+		? INVALID_HANDLE_VALUE
+		: FindFirstChangeNotificationA(Watcher.watchedDirectory.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+#elif defined(__linux__)
+	// The home directory may hold the cursor file too, its watch is kept in this case
+	if (Watcher.directoryWatch >= 0 && Watcher.directoryWatch != Watcher.resourcesWatch)
+	{
+		inotify_rm_watch(Watcher.notifyDescriptor, Watcher.directoryWatch);
+	}
+
+	Watcher.directoryWatch = -1;
+	if (Watcher.notifyDescriptor >= 0 && !Watcher.watchedDirectory.empty())
+	{
+		const uint32_t Events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB;
+		Watcher.directoryWatch = inotify_add_watch(Watcher.notifyDescriptor, Watcher.watchedDirectory.c_str(), Events | IN_MASK_ADD);
+	}
+#endif // _WIN32
+}
+
+/**
+ * Wait for a change notified by the system, a wake up of the watcher or the end of the poll interval.
+ *
+ * @return True if the settings must be checked again, false if only unrelated files changed.
+ */
+bool MouseCursorSizeHelper::WaitForChange()
+{
+	bool IsChanged = true;
+
+#if defined(_WIN32)
+	HANDLE Handles[4];
+	DWORD Count = 0;
+	Handles[Count++] = Watcher.wakeEvent;
+	for (size_t i = 0; i < Watcher.registryKeys.size(); i++)
+	{
+		if (Watcher.registryKeys[i] != NULL)
+		{
+			Handles[Count++] = Watcher.registryEvents[i];
+		}
+	}
+	if (Watcher.directoryNotification != INVALID_HANDLE_VALUE)
+	{
+		Handles[Count++] = Watcher.directoryNotification;
+	}
+
+	DWORD Result = WaitForMultipleObjects(Count, Handles, FALSE, Watcher.pollInterval);
+	if (Result >= WAIT_OBJECT_0 && Result < WAIT_OBJECT_0 + Count)
+	{
+		// The notifications are only signaled once, they are requested again
+		HANDLE Signaled = Handles[Result - WAIT_OBJECT_0];
+		for (size_t i = 0; i < Watcher.registryKeys.size(); i++)
+		{
+			if (Signaled == Watcher.registryEvents[i])
+			{
+				RegNotifyChangeKeyValue(Watcher.registryKeys[i], FALSE, REG_NOTIFY_CHANGE_LAST_SET, Watcher.registryEvents[i], TRUE);
+			}
+		}
+		if (Signaled == Watcher.directoryNotification)
+		{
+			FindNextChangeNotification(Watcher.directoryNotification);
+		}
+	}
+#elif defined(__linux__)
+	pollfd Descriptors[2] = { { Watcher.wakeDescriptor, POLLIN, 0 }, { Watcher.notifyDescriptor, POLLIN, 0 } };
+	nfds_t Count = Watcher.notifyDescriptor >= 0 ? 2 : 1;
+	if (poll(Descriptors, Count, int(Watcher.pollInterval)) > 0)
+	{
+		uint64_t Value;
+		bool IsWoken = (Descriptors[0].revents & POLLIN) != 0 && read(Watcher.wakeDescriptor, &Value, sizeof(Value)) > 0;
+
+		// In the home directory, only the X resources file is related to the settings
+		bool IsRelated = false;
+		alignas(inotify_event) char Buffer[4096];
+		ssize_t Size;
+		while (Count == 2 && (Size = read(Watcher.notifyDescriptor, Buffer, sizeof(Buffer))) > 0)
+		{
+			for (ssize_t Offset = 0; Offset < Size; Offset += ssize_t(sizeof(inotify_event) + reinterpret_cast<inotify_event*>(Buffer + Offset)->len))
+			{
+				const inotify_event* Event = reinterpret_cast<inotify_event*>(Buffer + Offset);
+				IsRelated |= Event->wd == Watcher.directoryWatch
+					|| (Event->wd == Watcher.resourcesWatch && Event->len > 0 && strcmp(Event->name, ".Xresources") == 0);
+			}
+		}
+
+		IsChanged = IsWoken || IsRelated;
+	}
+#else
+	std::unique_lock<std::mutex> Lock(Watcher.wakeMutex);
+	Watcher.wakeCondition.wait_for(Lock, std::chrono::milliseconds(Watcher.pollInterval), [] { return Watcher.isWakeRequested; });
+	Watcher.isWakeRequested = false;
+#endif // _WIN32
+
+	return IsChanged;
+}
+
+/**
+ * Get the computation in progress of the mouse cursor size, or start a new one on the executor.
+ * An error of the executor is reported through the future of the computation.
+ *
+ * @param Executor the function running the computation, nullptr to run it on a new thread.
+ * @return The computation shared by the concurrent requests.
+ */
+std::shared_ptr<MouseCursorSizeHelper::ASYNCQUERY> MouseCursorSizeHelper::StartAsyncQuery(const TASKEXECUTOR& Executor)
+{
+	std::shared_ptr<ASYNCQUERY> Query;
+	{
+		std::lock_guard<std::mutex> Lock(AsyncQueryMutex);
+		if (InFlightQuery != nullptr && !InFlightQuery->isDone)
+		{
+			return InFlightQuery;
+		}
+
+		Query = std::make_shared<ASYNCQUERY>();
+		Query->result = Query->promise.get_future().share();
+		Query->isDone = false;
+		InFlightQuery = Query;
+	}
+
+	// The task is submitted without the lock, as an executor may run it at once on the calling thread
+	try
+	{
+		std::function<void()> Task = [Query] { RunAsyncQuery(Query); };
+		if (Executor != nullptr)
+		{
+			Executor(std::move(Task));
+		}
+		else
+		{
+			RunOnNewThread(Task);
+		}
+	}
+	catch (...)
+	{
+		CompleteAsyncQuery(Query, std::pair<float, float>(0, 0), std::current_exception());
+	}
+
+	return Query;
+}
+
+/**
+ * Compute the mouse cursor size of a shared computation, with the buffers of the executor thread.
+ *
+ * @param Query the computation to complete.
+ */
+void MouseCursorSizeHelper::RunAsyncQuery(const std::shared_ptr<ASYNCQUERY>& Query)
+{
+	std::pair<float, float> CursorSize(0, 0);
+	std::exception_ptr Error;
+	try
+	{
+		CursorSize = GetCurrentMouseCursorSize();
+	}
+	catch (...)
+	{
+		Error = std::current_exception();
+	}
+
+	CompleteAsyncQuery(Query, CursorSize, Error);
+}
+
+/**
+ * Set the result of a shared computation and resume the coroutines awaiting it.
+ * The result is set before the computation is marked as done, so a done computation is always ready.
+ *
+ * @param Query the computation to complete.
+ * @param CursorSize the real mouse cursor size with scales.
+ * @param Error the exception thrown by the computation, nullptr if the size was computed.
+ */
+void MouseCursorSizeHelper::CompleteAsyncQuery(const std::shared_ptr<ASYNCQUERY>& Query, const std::pair<float, float>& CursorSize, const std::exception_ptr& Error)
+{
+	if (Error != nullptr)
+	{
+		Query->promise.set_exception(Error);
+	}
+	else
+	{
+		Query->promise.set_value(CursorSize);
+	}
+
+	std::vector<std::function<void()>> Continuations;
+	{
+		std::lock_guard<std::mutex> Lock(AsyncQueryMutex);
+		Query->isDone = true;
+		Continuations.swap(Query->continuations);
+	}
+
+	for (const std::function<void()>& Continuation : Continuations)
+	{
+		Continuation();
+	}
+}
+
+/**
+ * Add a function to run once a shared computation is done, unless it is already done.
+ *
+ * @param Query the computation awaited.
+ * @param Continuation the function to run on the thread completing the computation.
+ * @return True if the function was added, false if the computation is already done.
+ */
+bool MouseCursorSizeHelper::AddAsyncQueryContinuation(const std::shared_ptr<ASYNCQUERY>& Query, const std::function<void()>& Continuation)
+{
+	std::lock_guard<std::mutex> Lock(AsyncQueryMutex);
+	if (Query->isDone)
+	{
+		return false;
+	}
+
+	Query->continuations.push_back(Continuation);
+
+	return true;
+}
+
+/**
+ * Run a task on a new detached thread, the default executor of the asynchronous queries.
+ * The threads still running at the end of the program are waited for.
+ *
+ * @param Task the task to run.
+ */
+void MouseCursorSizeHelper::RunOnNewThread(const std::function<void()>& Task)
+{
+	std::lock_guard<std::mutex> Lock(AsyncThreads.mutex);
+	std::thread Thread([Task] {
+		Task();
+
+		// The condition is notified under the lock, so it is not destroyed before
+		std::lock_guard<std::mutex> EndLock(AsyncThreads.mutex);
+		AsyncThreads.runningCount--;
+		AsyncThreads.condition.notify_all();
+	});
+
+	AsyncThreads.runningCount++;
+	Thread.detach();
+}
+
+/**
+ * Wait for the threads of the default executor still running at the end of the program.
+ */
+MouseCursorSizeHelper::ASYNCTHREADS::~ASYNCTHREADS()
+{
+	std::unique_lock<std::mutex> Lock(mutex);
+	condition.wait(Lock, [this] { return runningCount == 0; });
+}
+
+/**
+ * Start a span of the trace if the tracing is enabled.
+ *
+ * @param Name the name of the span (TRACE_EVENT_QUERY...).
+ */
+MouseCursorSizeHelper::TRACESPAN::TRACESPAN(const int& Name)
+	: name(-1), start(0), bytes(0)
+{
+	if (IsTracingEnabled.load(std::memory_order_relaxed))
+	{
+		name = Name;
+		start = GetTraceTime();
+	}
+}
+
+/**
+ * Record the span in the ring of its thread at the end of the traced scope.
+ */
+MouseCursorSizeHelper::TRACESPAN::~TRACESPAN()
+{
+	if (name != -1)
+	{
+		RecordTraceEvent(name, start, bytes);
+	}
+}
+
+/**
+ * Give back the ring of a thread at its end, so the ring is reused by the next new thread.
+ * The spans still in the ring are written by the next flushes.
+ */
+MouseCursorSizeHelper::TRACETHREAD::~TRACETHREAD()
+{
+	if (ring != nullptr)
+	{
+		ring->isOwned.store(false, std::memory_order_release);
+	}
+}
+
+/**
+ * Get the current time of the trace.
+ *
+ * @return The time in nanoseconds of the steady clock.
+ */
+uint64_t MouseCursorSizeHelper::GetTraceTime()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Write a span in the ring of the current thread, without any lock once the thread owns its ring.
+ * The start index is published before the span is written and the write index after,
+ * so a flush reading the slot meanwhile knows that the span may be torn.
+ *
+ * @param Name the name of the span (TRACE_EVENT_QUERY...).
+ * @param Start the start of the span in nanoseconds of the steady clock.
+ * @param Bytes the bytes processed by the span.
+ */
+void MouseCursorSizeHelper::RecordTraceEvent(const int& Name, const uint64_t& Start, const uint64_t& Bytes)
+{
+	thread_local TRACETHREAD Thread = { nullptr, 0 };
+	if (Thread.ring == nullptr)
+	{
+		AcquireTraceRing(&Thread);
+	}
+
+	TRACERING* Ring = Thread.ring;
+	uint64_t Index = Ring->writeIndex.load(std::memory_order_relaxed);
+	Ring->startIndex.store(Index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	TRACEEVENT& Event = Ring->events[Index % TRACE_RING_CAPACITY];
+	Event.start.store(Start, std::memory_order_relaxed);
+	Event.duration.store(GetTraceTime() - Start, std::memory_order_relaxed);
+	Event.bytes.store(Bytes, std::memory_order_relaxed);
+	Event.name.store(uint32_t(Name), std::memory_order_relaxed);
+	Event.threadId.store(Thread.threadId, std::memory_order_relaxed);
+
+	Ring->writeIndex.store(Index + 1, std::memory_order_release);
+}
+
+/**
+ * Give a ring to a thread for its first span, reusing the ring of an ended thread if any.
+ *
+ * @param Thread the thread without ring, with its new ring and identifier.
+ */
+void MouseCursorSizeHelper::AcquireTraceRing(TRACETHREAD* Thread)
+{
+	Thread->threadId = TraceThreadsCount.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	std::lock_guard<std::mutex> Lock(TraceMutex);
+	for (const std::unique_ptr<TRACERING>& Ring : TraceRings)
+	{
+		if (!Ring->isOwned.load(std::memory_order_acquire))
+		{
+			Ring->isOwned.store(true, std::memory_order_relaxed);
+			Thread->ring = Ring.get();
+			return;
+		}
+	}
+
+	TraceRings.push_back(std::unique_ptr<TRACERING>(new TRACERING()));
+	TraceRings.back()->isOwned.store(true, std::memory_order_relaxed);
+	Thread->ring = TraceRings.back().get();
+}
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+/**
+ * Start the timing of a run of a stage.
+ *
+ * @param Stage the timed stage (STATS_STAGE_QUERY...).
+ */
+MouseCursorSizeHelper::STAGETIMER::STAGETIMER(const int& Stage)
+	: stage(Stage), start(std::chrono::steady_clock::now())
+{
+}
+
+/**
+ * Record the duration of the run of the stage at the end of the timed scope.
+ */
+MouseCursorSizeHelper::STAGETIMER::~STAGETIMER()
+{
+	std::chrono::nanoseconds Duration = std::chrono::steady_clock::now() - start;
+	RecordStageTime(stage, uint64_t(Duration.count()));
+}
+
+/**
+ * Add the duration of a run to the counters of a stage, without any lock.
+ *
+ * @param Stage the timed stage (STATS_STAGE_QUERY...).
+ * @param Nanoseconds the duration of the run.
+ */
+void MouseCursorSizeHelper::RecordStageTime(const int& Stage, const uint64_t& Nanoseconds)
+{
+	STAGECOUNTERS& Counters = Instrumentation.stages[Stage];
+	Counters.count.fetch_add(1, std::memory_order_relaxed);
+	Counters.totalNanoseconds.fetch_add(Nanoseconds, std::memory_order_relaxed);
+
+	// The bucket is the index of the highest set bit of the duration
+	int Bucket = std::min(63 - CountLeadingZeros64(Nanoseconds | 1), STATS_HISTOGRAM_BUCKETS - 1);
+	Counters.histogram[Bucket].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t Max = Counters.maxNanoseconds.load(std::memory_order_relaxed);
+	while (Nanoseconds > Max && !Counters.maxNanoseconds.compare_exchange_weak(Max, Nanoseconds, std::memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * Read a counter of the instrumentation and reset it.
+ *
+ * @param Counter the counter to read.
+ * @return The value of the counter before its reset.
+ */
+uint64_t MouseCursorSizeHelper::TakeCounter(std::atomic<uint64_t>* Counter)
+{
+	return Counter->exchange(0, std::memory_order_relaxed);
+}
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+
+/**
+ * Read all the settings needed to compute the mouse cursor size, in one snapshot of the current provider.
+ *
+ * @param Settings the settings read from the system, the capacity of its path is reused.
+ */
+void MouseCursorSizeHelper::ReadCursorSettings(CURSORSETTINGS* Settings)
+{
+	ReadCursorSettings(*GetSettingsProvider(), Settings);
+}
+
+/**
+ * Read all the settings needed to compute the mouse cursor size, in one snapshot of a provider.
+ *
+ * @param Provider the provider of the settings.
+ * @param Settings the settings read from the system, the capacity of its path is reused.
+ */
+void MouseCursorSizeHelper::ReadCursorSettings(SETTINGSPROVIDER& Provider, CURSORSETTINGS* Settings)
+{
+	TRACESPAN Span(TRACE_EVENT_READ_SETTINGS);
+	STATS_TIME_SCOPE(STATS_STAGE_READ_SETTINGS);
+	Provider.ReadSettings(Settings);
+}
+
+/**
+ * Get the generation of the settings of a provider which doesn't follow their changes.
+ *
+ * @param Generation always 0.
+ * @return False, so the settings are read at each query.
+ */
+bool MouseCursorSizeHelper::SETTINGSPROVIDER::GetSettingsGeneration(uint64_t* Generation)
+{
+	*Generation = 0;
+
+	return false;
+}
+
+/**
+ * Read again the settings not followed by the generation, with a provider following all of them.
+ *
+ * @param Settings the settings read before, left unchanged.
+ */
+void MouseCursorSizeHelper::SETTINGSPROVIDER::ReadUnwatchedSettings(CURSORSETTINGS* Settings)
+{
+	(void)Settings;
+}
+
+/**
+ * Read the path of the cursor file of a role with a provider which doesn't know the roles.
+ *
+ * @param Role the name of the role.
+ * @param Path the path, left unchanged.
+ * @return False, so the cursor file of the settings is used for every role.
+ */
+bool MouseCursorSizeHelper::SETTINGSPROVIDER::ReadRolePath(const LPCSTR& Role, std::string* Path)
+{
+	(void)Role;
+	(void)Path;
+
+	return false;
+}
+
+/**
+ * Create a provider of the settings of the registry, whose notifications are opened by the first query.
+ */
+MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::REGISTRYSETTINGSPROVIDER() : isNotificationsOpened(false), isWatched(false), registryKeys(), registryEvents(), generation(0)
+{
+}
+
+/**
+ * Close the notifications of the registry keys.
+ */
+MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::~REGISTRYSETTINGSPROVIDER()
+{
+#ifdef _WIN32
+	for (size_t i = 0; i < registryKeys.size() && isNotificationsOpened; i++)
+	{
+		if (registryKeys[i] != NULL)
+		{
+			RegCloseKey(registryKeys[i]);
+		}
+		if (registryEvents[i] != NULL)
+		{
+			CloseHandle(registryEvents[i]);
+		}
+	}
+#endif // _WIN32
+}
+
+/**
+ * Get the generation of the settings of the registry, incremented each time a key of the
+ * settings is notified as changed. A notification costs a wait without timeout on its event,
+ * instead of opening the keys. The DPI is not notified, it is read by ReadUnwatchedSettings.
+ *
+ * @param Generation the number of changes notified.
+ * @return True if all the keys are watched, false on the platforms other than Windows.
+ */
+bool MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::GetSettingsGeneration(uint64_t* Generation)
+{
+	std::lock_guard<std::mutex> Lock(notificationsMutex);
+
+#ifdef _WIN32
+	// The notifications must survive the thread requesting them, which may end before the next query
+	const DWORD Filter = REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC;
+	if (!isNotificationsOpened)
+	{
+		const LPCSTR Locations[2] = { REG_CURSOR_SOURCES, REG_ACCESSIBILITY_GROUP };
+		isWatched = true;
+		for (size_t i = 0; i < registryKeys.size(); i++)
+		{
+			registryEvents[i] = CreateEventA(NULL, FALSE, FALSE, NULL);
+			if (RegOpenKeyExA(HKEY_CURRENT_USER, Locations[i], 0, KEY_NOTIFY, &registryKeys[i]) != ERROR_SUCCESS)
+			{
+				registryKeys[i] = NULL;
+			}
+			isWatched = isWatched && registryEvents[i] != NULL && registryKeys[i] != NULL
+				&& RegNotifyChangeKeyValue(registryKeys[i], FALSE, Filter, registryEvents[i], TRUE) == ERROR_SUCCESS;
+		}
+		isNotificationsOpened = true;
+	}
+
+	for (size_t i = 0; i < registryKeys.size() && isWatched; i++)
+	{
+		// The notifications are only signaled once, they are requested again before the settings are read
+		if (WaitForSingleObject(registryEvents[i], 0) == WAIT_OBJECT_0)
+		{
+			isWatched = RegNotifyChangeKeyValue(registryKeys[i], FALSE, Filter, registryEvents[i], TRUE) == ERROR_SUCCESS;
+			generation++;
+		}
+	}
+#endif // _WIN32
+
+	*Generation = generation;
+
+	return isWatched;
+}
+
+/**
+ * Read the settings from the registry and the DPI of the main monitor.
+ * The path of the cursor file is read in a buffer of the thread, reused by the next queries.
+ *
+ * @param Settings the settings read from the system, the capacity of its path is reused.
+ */
+void MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::ReadSettings(CURSORSETTINGS* Settings)
+{
+	thread_local std::string RawPath;
+	RawPath.clear();
+	Settings->cursorBaseSize = -1;
+	Settings->mouseScale = DEFAULT_MOUSE_SCALE;
+
+#ifdef _WIN32
+	HKEY CursorsKey;
+	if (RegOpenKeyExA(HKEY_CURRENT_USER, REG_CURSOR_SOURCES, 0, KEY_QUERY_VALUE, &CursorsKey) == ERROR_SUCCESS)
+	{
+		GetRegistryValueString(CursorsKey, REG_KEY_CURSOR_FILE, &RawPath);
+		Settings->cursorBaseSize = GetRegistryValueFloat(CursorsKey, REG_KEY_CURSOR_BASE_SIZE, -1);
+		RegCloseKey(CursorsKey);
+	}
+
+	HKEY AccessibilityKey;
+	if (RegOpenKeyExA(HKEY_CURRENT_USER, REG_ACCESSIBILITY_GROUP, 0, KEY_QUERY_VALUE, &AccessibilityKey) == ERROR_SUCCESS)
+	{
+		Settings->mouseScale = GetRegistryValueFloat(AccessibilityKey, REG_KEY_CURSOR_SIZE, DEFAULT_MOUSE_SCALE);
+		RegCloseKey(AccessibilityKey);
+	}
+#endif // _WIN32
+
+	PurifyPath(RawPath, &Settings->cursorPath);
+	Settings->dpiScale = GetDPIScale();
+}
+
+/**
+ * Read again the DPI of the main monitor, which isn't notified by the registry.
+ *
+ * @param Settings the settings read before, receiving the current DPI.
+ */
+void MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::ReadUnwatchedSettings(CURSORSETTINGS* Settings)
+{
+	Settings->dpiScale = GetDPIScale();
+}
+
+/**
+ * Read the path of the cursor file of a role from the registry.
+ *
+ * @param Role the name of the registry value of the role.
+ * @param Path the purified path of the cursor file of the role, empty for the default cursor.
+ * @return True if the cursors registry key was opened, false on the platforms other than Windows.
+ */
+bool MouseCursorSizeHelper::REGISTRYSETTINGSPROVIDER::ReadRolePath(const LPCSTR& Role, std::string* Path)
+{
+	bool IsRead = false;
+
+#ifdef _WIN32
+	thread_local std::string RawPath;
+	RawPath.clear();
+
+	HKEY CursorsKey;
+	if (RegOpenKeyExA(HKEY_CURRENT_USER, REG_CURSOR_SOURCES, 0, KEY_QUERY_VALUE, &CursorsKey) == ERROR_SUCCESS)
+	{
+		GetRegistryValueString(CursorsKey, Role, &RawPath);
+		RegCloseKey(CursorsKey);
+		PurifyPath(RawPath, Path);
+		IsRead = true;
+	}
+#else
+	(void)Role;
+	(void)Path;
+#endif // _WIN32
+
+	return IsRead;
+}
+
+/**
+ * Create a provider of the settings of the X Window System, with nothing read yet.
+ */
+MouseCursorSizeHelper::XCURSORSETTINGSPROVIDER::XCURSORSETTINGSPROVIDER() : isCursorPathFound(false), resourcesSize(-1), resourcesModificationTime(0), xftDpi(DEFAULT_APPLIED_DPI)
+{
+	AppendExpandedHome("~/.Xresources", strlen("~/.Xresources"), &resourcesPath);
+}
+
+/**
+ * Read the settings of the X Window System. Xcursor draws the frame of the size it chose
+ * without scaling it, so the DPI scale is always 100 percent and the base size is the size
+ * chosen by Xcursor: XCURSOR_SIZE, or a size depending on the Xft.dpi resource if not defined.
+ *
+ * @param Settings the settings read from the system, the capacity of its path is reused.
+ */
+void MouseCursorSizeHelper::XCURSORSETTINGSPROVIDER::ReadSettings(CURSORSETTINGS* Settings)
+{
+	const char* CursorSize = getenv("XCURSOR_SIZE");
+	const char* Theme = getenv("XCURSOR_THEME");
+	const char* SearchPath = getenv("XCURSOR_PATH");
+	Theme = Theme != nullptr && *Theme != 0 ? Theme : XCURSOR_DEFAULT_THEME;
+	SearchPath = SearchPath != nullptr && *SearchPath != 0 ? SearchPath : XCURSOR_DEFAULT_PATH;
+
+	std::lock_guard<std::mutex> Lock(cacheMutex);
+
+	int64_t ResourcesSize;
+	int64_t ResourcesModificationTime;
+	GetFileSizeAndModificationTime(resourcesPath, &ResourcesSize, &ResourcesModificationTime);
+	if (ResourcesSize != resourcesSize || ResourcesModificationTime != resourcesModificationTime)
+	{
+		xftDpi = GetXftDpi(resourcesPath);
+		resourcesSize = ResourcesSize;
+		resourcesModificationTime = ResourcesModificationTime;
+	}
+
+	// The comparisons with the cached environment do not allocate any memory
+	if (!isCursorPathFound || theme != Theme || searchPath != SearchPath)
+	{
+		theme = Theme;
+		searchPath = SearchPath;
+		FindXcursorFile(theme, searchPath, XCURSOR_ARROW_NAME, &cursorPath);
+		isCursorPathFound = true;
+	}
+
+	int Size = CursorSize != nullptr ? atoi(CursorSize) : 0;
+	if (Size <= 0)
+	{
+		Size = int(xftDpi * XCURSOR_SIZE_PER_DPI);
+	}
+
+	Settings->cursorPath = cursorPath;
+	Settings->cursorBaseSize = float(Size);
+	Settings->mouseScale = DEFAULT_MOUSE_SCALE;
+	Settings->dpiScale = 100.0F;
+}
+
+/**
+ * Create a provider returning the settings passed as parameter.
+ *
+ * @param Settings the settings returned by each read.
+ */
+MouseCursorSizeHelper::MEMORYSETTINGSPROVIDER::MEMORYSETTINGSPROVIDER(const CURSORSETTINGS& Settings) : settings(Settings), generation(0), readsCount(0)
+{
+}
+
+/**
+ * Change the settings returned by the next reads.
+ *
+ * @param Settings the settings returned by each read.
+ */
+void MouseCursorSizeHelper::MEMORYSETTINGSPROVIDER::SetSettings(const CURSORSETTINGS& Settings)
+{
+	std::lock_guard<std::mutex> Lock(settingsMutex);
+	settings = Settings;
+	generation++;
+}
+
+/**
+ * Get the number of reads of the settings, to check how many times the queries read them.
+ *
+ * @return The number of reads since the creation of the provider.
+ */
+uint64_t MouseCursorSizeHelper::MEMORYSETTINGSPROVIDER::GetReadsCount() const
+{
+	return readsCount.load();
+}
+
+/**
+ * Copy the settings stored in memory.
+ *
+ * @param Settings the settings stored, the capacity of its path is reused.
+ */
+void MouseCursorSizeHelper::MEMORYSETTINGSPROVIDER::ReadSettings(CURSORSETTINGS* Settings)
+{
+	readsCount++;
+
+	std::lock_guard<std::mutex> Lock(settingsMutex);
+	*Settings = settings;
+}
+
+/**
+ * Get the generation of the settings stored in memory.
+ *
+ * @param Generation the number of changes of the settings.
+ * @return True, the settings only change with SetSettings.
+ */
+bool MouseCursorSizeHelper::MEMORYSETTINGSPROVIDER::GetSettingsGeneration(uint64_t* Generation)
+{
+	std::lock_guard<std::mutex> Lock(settingsMutex);
+	*Generation = generation;
+
+	return true;
+}
+
+#ifdef _WIN32
+/**
+ * Add a monitor enumerated by EnumDisplayMonitors to the list of the monitors.
+ *
+ * @param Monitor the handle of the monitor.
+ * @param Hdc unused.
+ * @param Rect unused.
+ * @param Data the list of the monitors.
+ * @return TRUE to continue the enumeration.
+ */
+BOOL CALLBACK MouseCursorSizeHelper::AddEnumeratedMonitor(HMONITOR Monitor, HDC Hdc, LPRECT Rect, LPARAM Data)
+{
+	(void)Hdc;
+	(void)Rect;
+	reinterpret_cast<std::vector<MONITORDPI>*>(Data)->push_back(MONITORDPI{ uint64_t(uintptr_t(Monitor)), 0.0F });
+
+	return TRUE;
+}
+#endif // _WIN32
+
+/**
+ * Enumerate the monitors of the system with their effective DPI scale. The functions of
+ * Windows 8.1 and 10 are loaded at runtime, and the thread is made per-monitor DPI aware
+ * while the DPIs are read, otherwise the DPI of the main monitor would be returned for all of them.
+ *
+ * @param Monitors the attached monitors, empty on the platforms other than Windows.
+ */
+void MouseCursorSizeHelper::SYSTEMMONITORPROVIDER::EnumerateMonitors(std::vector<MONITORDPI>* Monitors)
+{
+	Monitors->clear();
+
+#ifdef _WIN32
+	typedef HRESULT(WINAPI* GETDPIFORMONITORFUNCTION)(HMONITOR Monitor, int DpiType, UINT* DpiX, UINT* DpiY);
+	typedef HANDLE(WINAPI* SETTHREADDPIAWARENESSCONTEXTFUNCTION)(HANDLE Context);
+	static const HANDLE PER_MONITOR_AWARE_V2_CONTEXT = reinterpret_cast<HANDLE>(intptr_t(-4)); // DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2
+	static const int EFFECTIVE_DPI = 0; // MDT_EFFECTIVE_DPI
+
+	static const HMODULE ShcoreModule = LoadLibraryA("Shcore.dll");
+	static const GETDPIFORMONITORFUNCTION GetDpiForMonitorFunction = ShcoreModule != NULL
+		? reinterpret_cast<GETDPIFORMONITORFUNCTION>(GetProcAddress(ShcoreModule, "GetDpiForMonitor")) : nullptr;
+	static const SETTHREADDPIAWARENESSCONTEXTFUNCTION SetThreadDpiAwarenessContextFunction =
+		reinterpret_cast<SETTHREADDPIAWARENESSCONTEXTFUNCTION>(GetProcAddress(GetModuleHandleA("user32.dll"), "SetThreadDpiAwarenessContext"));
+
+	EnumDisplayMonitors(NULL, NULL, AddEnumeratedMonitor, reinterpret_cast<LPARAM>(Monitors));
+
+	HANDLE PreviousContext = SetThreadDpiAwarenessContextFunction != nullptr ? SetThreadDpiAwarenessContextFunction(PER_MONITOR_AWARE_V2_CONTEXT) : NULL;
+	float MainDpiScale = GetDPIScale();
+	for (MONITORDPI& Monitor : *Monitors)
+	{
+		UINT DpiX = 0;
+		UINT DpiY = 0;
+		bool IsRead = GetDpiForMonitorFunction != nullptr
+			&& SUCCEEDED(GetDpiForMonitorFunction(reinterpret_cast<HMONITOR>(uintptr_t(Monitor.handle)), EFFECTIVE_DPI, &DpiX, &DpiY));
+		Monitor.dpiScale = IsRead ? float(DPI_FACTOR * DpiX) : MainDpiScale;
+	}
+
+	if (PreviousContext != NULL)
+	{
+		SetThreadDpiAwarenessContextFunction(PreviousContext);
+	}
+#endif // _WIN32
+}
+
+/**
+ * Create a provider returning the monitors passed as parameter.
+ *
+ * @param Monitors the monitors returned by each enumeration.
+ */
+MouseCursorSizeHelper::MEMORYMONITORPROVIDER::MEMORYMONITORPROVIDER(const std::vector<MONITORDPI>& Monitors) : monitors(Monitors)
+{
+}
+
+/**
+ * Change the monitors returned by the next enumerations.
+ *
+ * @param Monitors the monitors returned by each enumeration.
+ */
+void MouseCursorSizeHelper::MEMORYMONITORPROVIDER::SetMonitors(const std::vector<MONITORDPI>& Monitors)
+{
+	std::lock_guard<std::mutex> Lock(monitorsMutex);
+	monitors = Monitors;
+}
+
+/**
+ * Copy the monitors stored in memory.
+ *
+ * @param Monitors the monitors stored, the capacity of the list is reused.
+ */
+void MouseCursorSizeHelper::MEMORYMONITORPROVIDER::EnumerateMonitors(std::vector<MONITORDPI>* Monitors)
+{
+	std::lock_guard<std::mutex> Lock(monitorsMutex);
+	*Monitors = monitors;
+}
+
+/**
+ * Read the fingerprint of the current settings and cursor file into the workspace.
+ * This only needs the settings and a stat of the file, not its content. The settings read
+ * by the previous query of the workspace are reused while the generation of their provider
+ * stays the same, only the settings it doesn't follow (like the DPI) are read again.
+ *
+ * @param Workspace the workspace receiving the fingerprint of the current mouse cursor.
+ */
+void MouseCursorSizeHelper::ReadCurrentFingerprint(QUERYWORKSPACE* Workspace)
+{
+	CURSORFINGERPRINT* Fingerprint = &Workspace->fingerprint;
+	std::shared_ptr<SETTINGSPROVIDER> Provider = GetSettingsProvider();
+	uint64_t Generation = 0;
+	bool IsGenerationValid = Provider->GetSettingsGeneration(&Generation);
+
+	if (IsGenerationValid && Provider == Workspace->settingsProvider && Generation == Workspace->settingsGeneration)
+	{
+		Provider->ReadUnwatchedSettings(&Fingerprint->settings);
+	}
+	else
+	{
+		ReadCursorSettings(*Provider, &Fingerprint->settings);
+		Workspace->settingsProvider = IsGenerationValid ? Provider : nullptr;
+		Workspace->settingsGeneration = Generation;
+	}
+	GetFileSizeAndModificationTime(Fingerprint->settings.cursorPath, &Fingerprint->fileSize, &Fingerprint->fileModificationTime);
+}
+
+/**
+ * Check if two fingerprints are the same.
+ *
+ * @param First the first fingerprint to compare.
+ * @param Second the second fingerprint to compare.
+ * @return True if both fingerprints give the same mouse cursor size.
+ */
+bool MouseCursorSizeHelper::IsSameFingerprint(const CURSORFINGERPRINT& First, const CURSORFINGERPRINT& Second)
+{
+	return First.fileSize == Second.fileSize
+		&& First.fileModificationTime == Second.fileModificationTime
+		&& First.settings.cursorBaseSize == Second.settings.cursorBaseSize
+		&& First.settings.mouseScale == Second.settings.mouseScale
+		&& First.settings.dpiScale == Second.settings.dpiScale
+		&& First.settings.cursorPath == Second.settings.cursorPath;
+}
+
+/**
+ * Read the size of the current mouse cursor from the persistent cache file.
+ * The cursor file is not opened when its size and modification time did not change. When only
+ * its modification time changed, its content is hashed and the record is kept if it is the same.
+ *
+ * @param Fingerprint the fingerprint of the current mouse cursor.
+ * @param CursorSize the real mouse cursor size with scales, read from the cache.
+ * @return True if the persistent cache is enabled and has a record for the current mouse cursor.
+ */
+bool MouseCursorSizeHelper::LoadPersistentCursorSize(const CURSORFINGERPRINT& Fingerprint, std::pair<float, float>* CursorSize)
+{
+	bool IsLoaded = false;
+	bool IsTouched = false;
+	CURSORSIZERECORD Record;
+	InitPersistentRecordKey(Fingerprint, &Record);
+
+	{
+		std::lock_guard<std::mutex> Lock(PersistentCacheMutex);
+		MAPPEDFILE Cache;
+		size_t Slot = 0;
+
+		if (!PersistentCachePath.empty() && Fingerprint.fileSize >= 0 && OpenMappedFile(PersistentCachePath, &Cache))
+		{
+			if (IsValidPersistentCache(Cache.view) && FindPersistentRecord(Cache.view, Record, &Slot))
+			{
+				CURSORSIZERECORD Cached;
+				memcpy(&Cached, Cache.view.data + sizeof(PERSISTENTCACHEHEADER) + Slot * sizeof(CURSORSIZERECORD), sizeof(CURSORSIZERECORD));
+				IsLoaded = Cached.fileSize == Record.fileSize && Cached.fileModificationTime == Record.fileModificationTime;
+
+				uint64_t ContentHash = 0;
+				IsTouched = !IsLoaded && Cached.fileSize == Record.fileSize
+					&& GetFileContentHash(Fingerprint.settings.cursorPath, &ContentHash) && ContentHash == Cached.contentHash;
+
+				if (IsLoaded || IsTouched)
+				{
+					STATS_COUNT(persistentCacheHits, 1);
+					Cached.fileModificationTime = Record.fileModificationTime;
+					Record = Cached;
+					*CursorSize = std::pair<float, float>(Cached.width, Cached.height);
+				}
+			}
+
+			CloseMappedFile(&Cache);
+		}
+	}
+
+	// The record of a touched file is written again with its new modification time
+	if (IsTouched)
+	{
+		WritePersistentRecord(Record);
+	}
+
+	return IsLoaded || IsTouched;
+}
+
+/**
+ * Store a computed size of the current mouse cursor in the persistent cache file.
+ *
+ * @param Fingerprint the fingerprint of the current mouse cursor.
+ * @param Record the computed sizes and hotspot, completed with the key of the current mouse cursor.
+ */
+void MouseCursorSizeHelper::StorePersistentCursorSize(const CURSORFINGERPRINT& Fingerprint, CURSORSIZERECORD* Record)
+{
+	bool IsEnabled = false;
+	{
+		std::lock_guard<std::mutex> Lock(PersistentCacheMutex);
+		IsEnabled = !PersistentCachePath.empty();
+	}
+
+	if (IsEnabled && Fingerprint.fileSize >= 0)
+	{
+		CURSORSIZERECORD Key;
+		InitPersistentRecordKey(Fingerprint, &Key);
+		Record->keyHash = Key.keyHash;
+		Record->pathHash = Key.pathHash;
+		Record->pathLength = Key.pathLength;
+		Record->reserved = 0;
+		Record->fileSize = Key.fileSize;
+		Record->fileModificationTime = Key.fileModificationTime;
+		Record->cursorBaseSize = Key.cursorBaseSize;
+		Record->mouseScale = Key.mouseScale;
+		Record->dpiScale = Key.dpiScale;
+
+		if (GetFileContentHash(Fingerprint.settings.cursorPath, &Record->contentHash))
+		{
+			WritePersistentRecord(*Record);
+		}
+	}
+}
+
+/**
+ * Initialize the key of a record of the persistent cache: the cursor path, the settings and
+ * the size and modification time of the cursor file. The other fields are set to 0. The path
+ * isn't stored, it is identified by its length and by two hashes from different seeds.
+ *
+ * @param Fingerprint the fingerprint of the mouse cursor.
+ * @param Record the record to initialize.
+ */
+void MouseCursorSizeHelper::InitPersistentRecordKey(const CURSORFINGERPRINT& Fingerprint, CURSORSIZERECORD* Record)
+{
+	memset(Record, 0, sizeof(CURSORSIZERECORD));
+	Record->fileSize = Fingerprint.fileSize;
+	Record->fileModificationTime = Fingerprint.fileModificationTime;
+	Record->cursorBaseSize = Fingerprint.settings.cursorBaseSize;
+	Record->mouseScale = Fingerprint.settings.mouseScale;
+	Record->dpiScale = Fingerprint.settings.dpiScale;
+
+	const std::string& Path = Fingerprint.settings.cursorPath;
+	uint64_t KeyHash = HashBytes(reinterpret_cast<const uint8_t*>(Path.data()), Path.size(), HASH_OFFSET_BASIS);
+	KeyHash = HashBytes(reinterpret_cast<const uint8_t*>(&Record->cursorBaseSize), 3 * sizeof(float), KeyHash);
+
+	// The hash 0 marks the empty slots
+	Record->keyHash = KeyHash != 0 ? KeyHash : 1;
+	Record->pathHash = HashBytes(reinterpret_cast<const uint8_t*>(Path.data()), Path.size(), PATH_HASH_SEED);
+	Record->pathLength = uint32_t(Path.size());
+}
+
+/**
+ * Check if a view holds a whole persistent cache file of the current version.
+ *
+ * @param Cache the view of the persistent cache file.
+ * @return True if the header and all the records are available.
+ */
+bool MouseCursorSizeHelper::IsValidPersistentCache(const BYTEVIEW& Cache)
+{
+	PERSISTENTCACHEHEADER Header;
+	bool IsValid = Cache.size == sizeof(PERSISTENTCACHEHEADER) + PERSISTENT_CACHE_SLOTS * sizeof(CURSORSIZERECORD);
+
+	if (IsValid)
+	{
+		memcpy(&Header, Cache.data, sizeof(PERSISTENTCACHEHEADER));
+		IsValid = Header.magic == PERSISTENT_CACHE_MAGIC && Header.version == PERSISTENT_CACHE_VERSION && Header.slotsCount == PERSISTENT_CACHE_SLOTS;
+	}
+
+	return IsValid;
+}
+
+/**
+ * Find the slot of a record in the persistent cache, with a linear probing from the slot given by its key hash.
+ *
+ * @param Cache the view of a valid persistent cache file.
+ * @param Key the record holding the key to find.
+ * @param Slot the slot of the record if found. Otherwise, the first empty slot, or the first probed one if the cache is full.
+ * @return True if a record with the same key was found.
+ */
+bool MouseCursorSizeHelper::FindPersistentRecord(const BYTEVIEW& Cache, const CURSORSIZERECORD& Key, size_t* Slot)
+{
+	const uint8_t* Records = Cache.data + sizeof(PERSISTENTCACHEHEADER);
+	size_t FirstSlot = size_t(Key.keyHash % PERSISTENT_CACHE_SLOTS);
+	*Slot = FirstSlot;
+
+	for (size_t i = 0; i < PERSISTENT_CACHE_SLOTS; i++)
+	{
+		size_t Index = (FirstSlot + i) % PERSISTENT_CACHE_SLOTS;
+		CURSORSIZERECORD Record;
+		memcpy(&Record, Records + Index * sizeof(CURSORSIZERECORD), sizeof(CURSORSIZERECORD));
+
+		if (Record.keyHash == 0)
+		{
+			*Slot = Index;
+			return false;
+		}
+		if (Record.keyHash == Key.keyHash && Record.pathHash == Key.pathHash && Record.pathLength == Key.pathLength
+			&& Record.cursorBaseSize == Key.cursorBaseSize
+			&& Record.mouseScale == Key.mouseScale && Record.dpiScale == Key.dpiScale)
+		{
+			*Slot = Index;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Write a record in the persistent cache file, replacing the record with the same key.
+ * The whole file is written to a temporary file renamed over the cache file, so the
+ * other processes never read a partially written cache.
+ *
+ * @param Record the record to write.
+ */
+void MouseCursorSizeHelper::WritePersistentRecord(const CURSORSIZERECORD& Record)
+{
+	std::lock_guard<std::mutex> Lock(PersistentCacheMutex);
+
+	if (!PersistentCachePath.empty())
+	{
+		std::vector<uint8_t> Datas(sizeof(PERSISTENTCACHEHEADER) + PERSISTENT_CACHE_SLOTS * sizeof(CURSORSIZERECORD), 0);
+		MAPPEDFILE Cache;
+
+		// The records of an invalid or outdated cache file are dropped
+		if (OpenMappedFile(PersistentCachePath, &Cache))
+		{
+			if (IsValidPersistentCache(Cache.view))
+			{
+				memcpy(Datas.data(), Cache.view.data, Datas.size());
+			}
+			CloseMappedFile(&Cache);
+		}
+
+		PERSISTENTCACHEHEADER Header = { PERSISTENT_CACHE_MAGIC, PERSISTENT_CACHE_VERSION, PERSISTENT_CACHE_SLOTS, 0 };
+		memcpy(Datas.data(), &Header, sizeof(PERSISTENTCACHEHEADER));
+
+		size_t Slot = 0;
+		FindPersistentRecord(BYTEVIEW{ Datas.data(), Datas.size() }, Record, &Slot);
+		memcpy(Datas.data() + sizeof(PERSISTENTCACHEHEADER) + Slot * sizeof(CURSORSIZERECORD), &Record, sizeof(CURSORSIZERECORD));
+
+		ReplaceFileAtomically(PersistentCachePath, Datas);
+	}
+}
+
+/**
+ * Hash the content of a file.
+ *
+ * @param Path the path of the file.
+ * @param ContentHash the hash of the content of the file.
+ * @return True if the file was read.
+ */
+bool MouseCursorSizeHelper::GetFileContentHash(const std::string& Path, uint64_t* ContentHash)
+{
+	MAPPEDFILE File;
+	bool IsRead = OpenMappedFile(Path, &File);
+
+	if (IsRead)
+	{
+		*ContentHash = HashBytes(File.view.data, File.view.size, HASH_OFFSET_BASIS);
+		CloseMappedFile(&File);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Hash bytes with the 64 bits FNV-1a function.
+ *
+ * @param Bytes the bytes to hash.
+ * @param Size the number of bytes.
+ * @param Seed the hash of the previous bytes, HASH_OFFSET_BASIS for the first ones.
+ * @return The hash of the bytes.
+ */
+uint64_t MouseCursorSizeHelper::HashBytes(const uint8_t* Bytes, const size_t& Size, const uint64_t& Seed)
+{
+	uint64_t Hash = Seed;
+
+	for (size_t i = 0; i < Size; i++)
+	{
+		Hash = (Hash ^ Bytes[i]) * HASH_PRIME;
+	}
+
+	return Hash;
+}
+
+/**
+ * Replace the content of a file in one step. The datas are written to a temporary file of the
+ * same directory, which is then renamed over the file.
+ *
+ * @param Path the path of the file to replace.
+ * @param Datas the new content of the file.
+ * @return True if the file was replaced.
+ */
+bool MouseCursorSizeHelper::ReplaceFileAtomically(const std::string& Path, const std::vector<uint8_t>& Datas)
+{
+#ifdef _WIN32
+	std::string TempPath = Path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+	std::string TempPath = Path + "." + std::to_string(getpid()) + ".tmp";
+#endif // _WIN32
+
+	bool IsReplaced = false;
+	{
+		std::ofstream Stream(TempPath, std::ios::binary | std::ios::trunc);
+		if (Stream.is_open())
+		{
+			Stream.write(reinterpret_cast<const char*>(Datas.data()), std::streamsize(Datas.size()));
+			Stream.close();
+			IsReplaced = !Stream.fail();
+		}
+	}
+
+#ifdef _WIN32
+	IsReplaced = IsReplaced && MoveFileExA(TempPath.c_str(), Path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	IsReplaced = IsReplaced && rename(TempPath.c_str(), Path.c_str()) == 0;
+#endif // _WIN32
+
+	if (!IsReplaced)
+	{
+		remove(TempPath.c_str());
+	}
+
+	return IsReplaced;
+}
+
+/**
+ * Get the index of the smallest frame in array of pictures.
+ *
+ * @param Directory the view of the array of pictures.
+ * @param Count the number of pictures in the array.
+ * @return The index of the smallest frame in array of pictures.
+ */
+int MouseCursorSizeHelper::GetIndexOfSmallestPicture(const BYTEVIEW& Directory, const int& Count)
+{
+	int Index = -1;
+	uint64_t ImageSize = 0xffffffffffffffff; // The MAX value of uint64_t
+	ICONDIRENTRY Entry;
+
+	for (int i = 0; i < Count && ReadIconDirEntry(Directory, i, &Entry); i++)
+	{
+		uint64_t EntrySize = uint64_t(Entry.bWidth * Entry.bHeight);
+		if (ImageSize > EntrySize)
+		{
+			Index = i;
+			ImageSize = EntrySize;
+		}
+	}
+
+	return Index;
+}
+
+/**
+ * Get the index of the desired frame in array of pictures.
+ *
+ * @param Directory the view of the array of pictures.
+ * @param Count the number of pictures in the array.
+ * @param Settings the settings read from the system.
+ * @param SizeData the size informations.
+ * @return The index of the desired frame in array of pictures.
+ * If the desired frame is not founnd, the index of the smallest one is returned.
+ */
+int MouseCursorSizeHelper::GetIndexOfDesiredFrame(const BYTEVIEW& Directory, const int& Count, const CURSORSETTINGS& Settings, SIZEDATA* SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_READ_DIRECTORY);
+	Span.bytes = Directory.size;
+
+	int Index = -1;
+	float CursorBaseSize = Settings.cursorBaseSize;
+	float AppliedDPI = Settings.dpiScale / 100.0F;
+	ICONDIRENTRY Entry;
+
+	if (CursorBaseSize != -1)
+	{
+		float DesiredSize = CursorBaseSize * AppliedDPI;
+		for (int i = 0; i < Count && ReadIconDirEntry(Directory, i, &Entry); i++)
+		{
+			if (Entry.bWidth == uint8_t(DesiredSize) && Entry.bHeight == uint8_t(DesiredSize))
+			{
+				Index = i;
+				SizeData->isRealSize = true;
+				break;
+			}
+		}
+	}
+
+	if (Index == -1)
+	{
+		Index = GetIndexOfSmallestPicture(Directory, Count);
+		if (CursorBaseSize != -1)
+		{
+			STATS_COUNT(smallestFrameFallbacks, 1);
+		}
+	}
+
+	return Index;
+}
+
+/**
+ * Invert the lines order of an array to invert its height, in place.
+ *
+ * @param Array the array to be processed.
+ * @param SizeData the size informations.
+ */
+void MouseCursorSizeHelper::InvertArrayHeight(std::vector<uint32_t>* Array, SIZEDATA* SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_FLIP);
+	Span.bytes = Array->size() * sizeof(uint32_t);
+
+	if (!Array->empty())
+	{
+		uint32_t* Top = Array->data();
+		uint32_t* Bottom = Array->data() + size_t(SizeData->height - 1) * SizeData->width;
+
+		for (; Top < Bottom; Top += SizeData->width, Bottom -= SizeData->width) {
+			std::swap_ranges(Top, Top + SizeData->width, Bottom);
+		}
+	}
+
+	SizeData->isBottomUp = !SizeData->isBottomUp;
+}
+
+/**
+ * Get the views on the pixels and on the mask of a picture of the cursor file.
+ *
+ * @param Image the view of the picture datas in the cursor file.
+ * @param BmpHeader the bitmap header with metadatas of the cursor icon.
+ * @param Frame the views on the pixels and on the mask of the picture.
+ * @param SizeData the size informations.
+ * @return True if the picture has a supported format and all its datas are in the file.
+ */
+bool MouseCursorSizeHelper::GetFrameView(const BYTEVIEW& Image, const BITMAPINFOHEADER& BmpHeader, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_DECODE_FRAME);
+	Span.bytes = Image.size;
+
+	bool IsValid = false;
+
+	// Validate size and format
+	int BitCount = BmpHeader.biBitCount;
+	bool IsSupportedBitCount = BitCount == 1 || BitCount == 4 || BitCount == 8 || BitCount == 24 || BitCount == 32;
+	if (IsSupportedBitCount && BmpHeader.biCompression == BI_RGB && BmpHeader.biWidth > 0) {
+		int Width = BmpHeader.biWidth;
+		int Height = abs(BmpHeader.biHeight) / 2; // Half the height is for the mask
+		size_t MaskWidth = ((Width + 31) / 32) * BYTES_PER_PIXEL; // Width rounded to the nearest multiple of 32 bits
+		size_t PixelsStride = ((size_t(Width) * BitCount + 31) / 32) * BYTES_PER_PIXEL; // Lines are aligned on 32 bits
+		size_t PixelsSize = PixelsStride * size_t(Height);
+
+		// Up to 8 bits per pixel, the pixels are indexes in the palette following the header
+		size_t PaletteCount = 0;
+		if (BitCount <= 8)
+		{
+			PaletteCount = BmpHeader.biClrUsed != 0 && BmpHeader.biClrUsed < (1U << BitCount) ? BmpHeader.biClrUsed : (1U << BitCount);
+		}
+		size_t PaletteSize = PaletteCount * BYTES_PER_PIXEL;
+
+		// The pixels are followed by the mask (1 bit per pixel)
+		IsValid = GetSubView(Image, BmpHeader.biSize, PaletteSize, &Frame->palette)
+			&& GetSubView(Image, BmpHeader.biSize + PaletteSize, PixelsSize, &Frame->pixels)
+			&& GetSubView(Image, BmpHeader.biSize + PaletteSize + PixelsSize, MaskWidth * size_t(Height), &Frame->mask);
+
+		if (IsValid)
+		{
+			Frame->png = BYTEVIEW{ nullptr, 0 };
+			Frame->pixelsStride = PixelsStride;
+			Frame->bitCount = BitCount;
+			Frame->maskStride = MaskWidth;
+			SizeData->width = Width;
+			SizeData->height = Height;
+			SizeData->isBottomUp = true; // The lines of a DIB are stored from bottom to top
+		}
+	}
+
+	return IsValid;
+}
+
+/**
+ * Extract the pixels from the cursor file.
+ *
+ * @param Frame the views on the pixels and on the mask of the picture.
+ * @param SizeData the size informations.
+ * @return The pixel array of the mouse cursor picture.
+ */
+std::vector<uint32_t> MouseCursorSizeHelper::ExtractPixels(const FRAMEVIEW& Frame, const SIZEDATA& SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_APPLY_MASK);
+	Span.bytes = Frame.pixels.size + Frame.mask.size + Frame.png.size;
+
+	std::vector<uint32_t> Pixels(size_t(SizeData.width) * size_t(SizeData.height));
+
+	if (Frame.png.size != 0)
+	{
+		// Only the alpha channel of a PNG picture is decoded
+		QUERYWORKSPACE Workspace;
+		bool IsDecoded = DecodePngAlphaRows(Frame.png, &Workspace, [&](const int& IndexY, const uint8_t* Alpha) {
+			for (int x = 0; x < SizeData.width; x++) {
+				Pixels[size_t(IndexY) * SizeData.width + x] = uint32_t(Alpha[x]) << 24;
+			}
+		});
+
+		if (!IsDecoded)
+		{
+			Pixels.clear();
+		}
+
+		return Pixels;
+	}
+
+	if (Frame.bitCount != 32)
+	{
+		// The pictures without alpha channel only give the visibility of their pixels
+		std::array<uint8_t, 256> PaletteTable = BuildPaletteVisibilityTable(Frame);
+		for (int y = 0; y < SizeData.height; y++) {
+			const uint8_t* Line = Frame.pixels.data + y * Frame.pixelsStride;
+			const uint8_t* MaskLine = Frame.mask.data + y * Frame.maskStride;
+
+			for (int x = 0; x < SizeData.width; x += 8) {
+				uint8_t Bits = GetVisiblePixelsByte(Frame, PaletteTable, Line, MaskLine, SizeData.width, x / 8);
+				for (int i = 0; i < 8 && x + i < SizeData.width; i++) {
+					Pixels[size_t(y) * SizeData.width + x + i] = (Bits & (1 << i)) != 0 ? 0xFF000000 : 0;
+				}
+			}
+		}
+
+		return Pixels;
+	}
+
+	// Read the pixels and combine them with the mask to set transparency
+	for (int y = 0; y < SizeData.height; y++) {
+		const uint8_t* MaskLine = Frame.mask.data != nullptr ? Frame.mask.data + y * Frame.maskStride : nullptr;
+		const uint8_t* PixelsLine = Frame.pixels.data + size_t(y) * SizeData.width * BYTES_PER_PIXEL;
+
+		for (int x = 0; x < SizeData.width; x++) {
+			bool IsTransparent = MaskLine != nullptr && (MaskLine[x / 8] & (0x80 >> (x % 8))) != 0;
+
+			// Completely transparent pixel if masked
+			Pixels[size_t(y) * SizeData.width + x] = IsTransparent ? 0 : ReadUInt32(PixelsLine + size_t(x) * BYTES_PER_PIXEL);
+		}
+	}
+
+	return Pixels;
+}
+
+/**
+ * Get the views on the desired picture of the cursor file.
+ *
+ * @param File the view of the whole cursor file.
+ * @param Settings the settings read from the system.
+ * @param Frame the views on the pixels and on the mask of the picture.
+ * @param SizeData the size informations.
+ * @return True if a picture with a supported format was found.
+ */
+bool MouseCursorSizeHelper::GetCursorFrame(const BYTEVIEW& File, const CURSORSETTINGS& Settings, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	bool IsFound = false;
+	ICONDIR Header;
+	BYTEVIEW Directory;
+
+	// The type of file is a .cur file
+	if (ReadIconDir(File, &Header) && Header.idType == 2
+		&& GetSubView(File, sizeof(ICONDIR), size_t(Header.idCount) * sizeof(ICONDIRENTRY), &Directory))
+	{
+		// Read data for the desired frame of the file
+		int FrameIndex = GetIndexOfDesiredFrame(Directory, Header.idCount, Settings, SizeData);
+		IsFound = GetCursorFrameOfEntry(File, Directory, FrameIndex, Frame, SizeData);
+	}
+	// The type of file is an Xcursor file, the cursor format of the X Window System
+	else if (IsXcursorFile(File))
+	{
+		IsFound = GetXcursorFrame(File, Settings, Frame, SizeData);
+	}
+
+	return IsFound;
+}
+
+/**
+ * Get the views on a picture of a .cur file.
+ *
+ * @param File the view of the whole cursor file.
+ * @param Directory the view of the array of pictures.
+ * @param FrameIndex the index of the picture in the array.
+ * @param Frame the views on the pixels and on the mask of the picture, with its hotspot.
+ * @param SizeData the size informations.
+ * @return True if the picture has a supported format.
+ */
+bool MouseCursorSizeHelper::GetCursorFrameOfEntry(const BYTEVIEW& File, const BYTEVIEW& Directory, const int& FrameIndex, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	ICONDIRENTRY Entry;
+	BYTEVIEW Image;
+	BITMAPINFOHEADER BmpHeader;
+	bool IsFound = ReadIconDirEntry(Directory, FrameIndex, &Entry)
+		&& GetSubView(File, Entry.dwImageOffset, File.size - std::min<size_t>(Entry.dwImageOffset, File.size), &Image)
+		&& (IsPngPicture(Image)
+			? GetPngFrameView(Image, Frame, SizeData)
+			: ReadBitmapInfoHeader(Image, &BmpHeader) && GetFrameView(Image, BmpHeader, Frame, SizeData));
+
+	if (IsFound)
+	{
+		// In a .cur file, the planes and bits count fields hold the hotspot
+		Frame->index = FrameIndex;
+		Frame->hotspotX = Entry.wPlanes;
+		Frame->hotspotY = Entry.wBitCount;
+	}
+
+	return IsFound;
+}
+
+/**
+ * Compute the metrics of a frame, its visible pixels being scanned once.
+ *
+ * @param Frame the views on the pixels of the frame, nullptr views if the frame is not supported.
+ * @param SizeData the size informations of the frame.
+ * @param NominalSize the size choosing the frame as the real size.
+ * @param Workspace the buffers used to decode the frame.
+ * @return The metrics of the frame, with the default size of a query if the frame is not supported.
+ */
+MouseCursorSizeHelper::CURSORFRAMEMETRICS MouseCursorSizeHelper::ComputeFrameMetrics(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, const int& NominalSize, QUERYWORKSPACE* Workspace)
+{
+	CURSORFRAMEMETRICS Metrics;
+	Metrics.nominalSize = NominalSize;
+	Metrics.frameWidth = SizeData.width;
+	Metrics.frameHeight = SizeData.height;
+	Metrics.trimmedWidth = DEFAULT_ORIGIN_MOUSE_WIDTH;
+	Metrics.trimmedHeight = DEFAULT_ORIGIN_MOUSE_HEIGHT;
+	Metrics.hotspotX = 0;
+	Metrics.hotspotY = 0;
+
+	if (Frame.pixels.data != nullptr || Frame.png.data != nullptr)
+	{
+		std::pair<float, float> TrimmedSize = ComputeCursorSizeFromFrame(Frame, SizeData, Workspace);
+		Metrics.trimmedWidth = TrimmedSize.first;
+		Metrics.trimmedHeight = TrimmedSize.second;
+		Metrics.hotspotX = Frame.hotspotX;
+		Metrics.hotspotY = Frame.hotspotY;
+	}
+
+	return Metrics;
+}
+
+/**
+ * Get the datas of the cursor file
+ *
+ * @param File the view of the whole cursor file.
+ * @param Settings the settings read from the system.
+ * @param SizeData the size informations, with the hotspot of the chosen frame.
+ * @return The pixel array of the mouse cursor picture.
+ */
+std::vector<uint32_t> MouseCursorSizeHelper::GetCursorFileDatas(const BYTEVIEW& File, const CURSORSETTINGS& Settings, SIZEDATA* SizeData)
+{
+	std::vector<uint32_t> PixelArray = {};
+	FRAMEVIEW Frame;
+
+	if (GetCursorFrame(File, Settings, &Frame, SizeData))
+	{
+		PixelArray = ExtractPixels(Frame, *SizeData);
+		SizeData->hotspotX = Frame.hotspotX;
+		SizeData->hotspotY = Frame.hotspotY;
+	}
+
+	return PixelArray;
+}
+
+/**
+ * Compute the size of the current mouse cursor picture, without scales.
+ * The pixels are read directly from the cursor file, no pixel array is built.
+ *
+ * @param Settings the settings read from the system.
+ * @param SizeData the size informations.
+ * @param Workspace the buffers used to decode the picture.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::GetCursorSizeOfCurrentMouseImage(const CURSORSETTINGS& Settings, SIZEDATA* SizeData, QUERYWORKSPACE* Workspace)
+{
+	std::pair<float, float> CursorSize = std::pair<float, float>(DEFAULT_ORIGIN_MOUSE_WIDTH, DEFAULT_ORIGIN_MOUSE_HEIGHT);
+	bool IsComputed = false;
+
+	if (!Settings.cursorPath.empty())
+	{
+		MAPPEDFILE File;
+
+		if (STATS_TIME(STATS_STAGE_OPEN_FILE, OpenMappedFile(Settings.cursorPath, &File)))
+		{
+			STATS_COUNT(bytesRead, File.view.size);
+
+			// The frames of an animated cursor are chosen while its size is computed
+			FRAMEVIEW Frame;
+			if (IsAnimatedCursorFile(File.view))
+			{
+				IsComputed = STATS_TIME(STATS_STAGE_COMPUTE_SIZE, ComputeAnimatedCursorSize(File.view, Settings, SizeData, &CursorSize));
+			}
+			else if (STATS_TIME(STATS_STAGE_SELECT_FRAME, GetCursorFrame(File.view, Settings, &Frame, SizeData)))
+			{
+				CursorSize = STATS_TIME(STATS_STAGE_COMPUTE_SIZE, ComputeCursorSizeFromFrame(Frame, *SizeData, Workspace));
+				SizeData->hotspotX = Frame.hotspotX;
+				SizeData->hotspotY = Frame.hotspotY;
+				IsComputed = true;
+			}
+
+			CloseMappedFile(&File);
+		}
+	}
+
+	if (!IsComputed)
+	{
+		STATS_COUNT(defaultSizeFallbacks, 1);
+	}
+
+	return CursorSize;
+}
+
+/**
+ * Check if a file is an Xcursor file, starting with the "Xcur" magic number.
+ *
+ * @param File the view of the whole file.
+ * @return True if the file is an Xcursor file.
+ */
+bool MouseCursorSizeHelper::IsXcursorFile(const BYTEVIEW& File)
+{
+	return File.size >= XCURSOR_FILE_HEADER_SIZE && ReadUInt32(File.data) == XCURSOR_MAGIC;
+}
+
+/**
+ * Index the images of an Xcursor file by nominal size, reading its table of contents once.
+ * The images themselves are not read.
+ *
+ * @param File the view of the whole Xcursor file.
+ * @param Index the nominal sizes of the file, with the position of their first image.
+ * @return True if the table of contents is in the file and contains at least one image.
+ */
+bool MouseCursorSizeHelper::IndexXcursorFile(const BYTEVIEW& File, XCURSORINDEX* Index)
+{
+	TRACESPAN Span(TRACE_EVENT_READ_DIRECTORY);
+	Index->sizesCount = 0;
+
+	uint32_t HeaderSize = ReadUInt32(File.data + 4);
+	uint32_t TocCount = ReadUInt32(File.data + 12);
+	BYTEVIEW Toc;
+	if (HeaderSize < XCURSOR_FILE_HEADER_SIZE || TocCount > XCURSOR_MAX_TOC_ENTRIES
+		|| !GetSubView(File, HeaderSize, size_t(TocCount) * XCURSOR_TOC_ENTRY_SIZE, &Toc))
+	{
+		return false;
+	}
+	Span.bytes = Toc.size;
+
+	for (uint32_t i = 0; i < TocCount; i++)
+	{
+		const uint8_t* Entry = Toc.data + size_t(i) * XCURSOR_TOC_ENTRY_SIZE;
+		if (ReadUInt32(Entry) != XCURSOR_IMAGE_TYPE)
+		{
+			continue;
+		}
+
+		// The images of the same nominal size are the frames of an animation
+		uint32_t NominalSize = ReadUInt32(Entry + 4);
+		int SizeIndex = 0;
+		while (SizeIndex < Index->sizesCount && Index->sizes[SizeIndex].nominalSize != NominalSize)
+		{
+			SizeIndex++;
+		}
+
+		if (SizeIndex < Index->sizesCount)
+		{
+			Index->sizes[SizeIndex].imagesCount++;
+		}
+		else if (Index->sizesCount < XCURSOR_MAX_NOMINAL_SIZES)
+		{
+			XCURSORSIZE* Size = &Index->sizes[Index->sizesCount++];
+			Size->nominalSize = NominalSize;
+			Size->tocIndex = int(i);
+			Size->position = ReadUInt32(Entry + 8);
+			Size->imagesCount = 1;
+		}
+	}
+
+	return Index->sizesCount > 0;
+}
+
+/**
+ * Get the index of the nominal size nearest to the desired size, like Xcursor does.
+ *
+ * @param Index the nominal sizes of the Xcursor file.
+ * @param Settings the settings read from the system.
+ * @param SizeData the size informations.
+ * @return The index of the nearest nominal size, the smallest one if the cursor base size is not defined.
+ */
+int MouseCursorSizeHelper::GetIndexOfNearestXcursorSize(const XCURSORINDEX& Index, const CURSORSETTINGS& Settings, SIZEDATA* SizeData)
+{
+	int NearestIndex = 0;
+	float DesiredSize = Settings.cursorBaseSize != -1 ? Settings.cursorBaseSize * Settings.dpiScale / 100.0F : 0;
+
+	for (int i = 1; i < Index.sizesCount; i++)
+	{
+		// On equal distances, the first size of the table of contents is kept
+		if (std::fabs(float(Index.sizes[i].nominalSize) - DesiredSize) < std::fabs(float(Index.sizes[NearestIndex].nominalSize) - DesiredSize))
+		{
+			NearestIndex = i;
+		}
+	}
+
+	SizeData->isRealSize = Settings.cursorBaseSize != -1 && Index.sizes[NearestIndex].nominalSize == uint32_t(DesiredSize);
+	if (Settings.cursorBaseSize != -1 && !SizeData->isRealSize)
+	{
+		STATS_COUNT(smallestFrameFallbacks, 1);
+	}
+
+	return NearestIndex;
+}
+
+/**
+ * Get the views on the first image of a nominal size of an Xcursor file.
+ * The pixels are premultiplied ARGB values, stored from top to bottom without any mask.
+ *
+ * @param File the view of the whole Xcursor file.
+ * @param Size the nominal size of the image.
+ * @param Frame the views on the pixels of the image.
+ * @param SizeData the size informations.
+ * @return True if the image is valid and all its pixels are in the file.
+ */
+bool MouseCursorSizeHelper::GetXcursorFrameView(const BYTEVIEW& File, const XCURSORSIZE& Size, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_DECODE_FRAME);
+
+	BYTEVIEW Header;
+	if (!GetSubView(File, Size.position, XCURSOR_IMAGE_HEADER_SIZE, &Header))
+	{
+		return false;
+	}
+
+	// The chunk header (size, type, nominal size and version) is followed by the image header
+	uint32_t Width = ReadUInt32(Header.data + 16);
+	uint32_t Height = ReadUInt32(Header.data + 20);
+	uint32_t HotspotX = ReadUInt32(Header.data + 24);
+	uint32_t HotspotY = ReadUInt32(Header.data + 28);
+	bool IsValid = ReadUInt32(Header.data) >= XCURSOR_IMAGE_HEADER_SIZE
+		&& ReadUInt32(Header.data + 4) == XCURSOR_IMAGE_TYPE
+		&& ReadUInt32(Header.data + 8) == Size.nominalSize
+		&& Width > 0 && Width <= XCURSOR_IMAGE_MAX_SIZE && Height > 0 && Height <= XCURSOR_IMAGE_MAX_SIZE
+		&& HotspotX <= Width && HotspotY <= Height
+		&& GetSubView(File, size_t(Size.position) + XCURSOR_IMAGE_HEADER_SIZE, size_t(Width) * Height * BYTES_PER_PIXEL, &Frame->pixels);
+
+	if (IsValid)
+	{
+		Frame->mask = BYTEVIEW{ nullptr, 0 };
+		Frame->maskStride = 0;
+		Frame->png = BYTEVIEW{ nullptr, 0 };
+		Frame->palette = BYTEVIEW{ nullptr, 0 };
+		Frame->pixelsStride = size_t(Width) * BYTES_PER_PIXEL;
+		Frame->bitCount = 32;
+		Frame->hotspotX = int(HotspotX);
+		Frame->hotspotY = int(HotspotY);
+		SizeData->width = int(Width);
+		SizeData->height = int(Height);
+		SizeData->isBottomUp = false;
+	}
+
+	return IsValid;
+}
+
+/**
+ * Get the views on the image of an Xcursor file whose nominal size is the nearest to the desired size.
+ * Only the table of contents and the chosen image are read.
+ *
+ * @param File the view of the whole Xcursor file.
+ * @param Settings the settings read from the system.
+ * @param Frame the views on the pixels of the image.
+ * @param SizeData the size informations.
+ * @return True if an image was found and is valid.
+ */
+bool MouseCursorSizeHelper::GetXcursorFrame(const BYTEVIEW& File, const CURSORSETTINGS& Settings, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	XCURSORINDEX Index;
+	bool IsFound = false;
+
+	if (IndexXcursorFile(File, &Index))
+	{
+		const XCURSORSIZE& Size = Index.sizes[GetIndexOfNearestXcursorSize(Index, Settings, SizeData)];
+		IsFound = GetXcursorFrameView(File, Size, Frame, SizeData);
+		if (IsFound)
+		{
+			Frame->index = Size.tocIndex;
+		}
+	}
+
+	return IsFound;
+}
+
+/**
+ * Check if a file is an animated cursor file (.ani), a RIFF file of type ACON.
+ *
+ * @param File the view of the whole file.
+ * @return True if the file is an animated cursor file.
+ */
+bool MouseCursorSizeHelper::IsAnimatedCursorFile(const BYTEVIEW& File)
+{
+	return File.size >= 12 && IsChunkId(File.data, "RIFF") && IsChunkId(File.data + 8, "ACON");
+}
+
+/**
+ * Read the chunk of a RIFF file at an offset, and move the offset to the next chunk.
+ *
+ * @param View the view of the chunks.
+ * @param Offset the offset of the chunk in the view, moved to the next chunk.
+ * @param Chunk the chunk read.
+ * @return True if the chunk is entirely contained in the view.
+ */
+bool MouseCursorSizeHelper::ReadRiffChunk(const BYTEVIEW& View, size_t* Offset, RIFFCHUNK* Chunk)
+{
+	BYTEVIEW Header;
+	bool IsRead = GetSubView(View, *Offset, 8, &Header);
+
+	if (IsRead)
+	{
+		uint32_t Size = ReadUInt32(Header.data + 4);
+		Chunk->id = Header.data;
+		IsRead = GetSubView(View, *Offset + 8, Size, &Chunk->datas);
+
+		// The chunks are aligned on 2 bytes
+		*Offset += 8 + size_t(Size) + (Size & 1);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Check the identifier of a RIFF chunk.
+ *
+ * @param Id the four characters of the identifier.
+ * @param ExpectedId the expected identifier.
+ * @return True if both identifiers are the same.
+ */
+bool MouseCursorSizeHelper::IsChunkId(const uint8_t* Id, const char* ExpectedId)
+{
+	return std::memcmp(Id, ExpectedId, 4) == 0;
+}
+
+/**
+ * Read the header of an animated cursor file.
+ *
+ * @param Datas the datas of the anih chunk.
+ * @param Header the header read.
+ * @return True if the chunk is big enough to contain the header.
+ */
+bool MouseCursorSizeHelper::ReadAniHeader(const BYTEVIEW& Datas, ANIHEADER* Header)
+{
+	bool IsRead = Datas.size >= sizeof(ANIHEADER);
+
+	if (IsRead)
+	{
+		Header->cbSize = ReadUInt32(Datas.data);
+		Header->nFrames = ReadUInt32(Datas.data + 4);
+		Header->nSteps = ReadUInt32(Datas.data + 8);
+		Header->iWidth = ReadUInt32(Datas.data + 12);
+		Header->iHeight = ReadUInt32(Datas.data + 16);
+		Header->iBitCount = ReadUInt32(Datas.data + 20);
+		Header->nPlanes = ReadUInt32(Datas.data + 24);
+		Header->iDispRate = ReadUInt32(Datas.data + 28);
+		Header->bfAttributes = ReadUInt32(Datas.data + 32);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Index the chunks of an animated cursor file. No frame is decoded, the index only keeps views on them.
+ *
+ * @param File the view of the whole animated cursor file.
+ * @param Index the index of the animation.
+ * @return True if the file has a header and frames stored as cursor files.
+ */
+bool MouseCursorSizeHelper::IndexAnimatedCursor(const BYTEVIEW& File, ANIINDEX* Index)
+{
+	bool IsHeaderFound = false;
+	Index->frames.clear();
+	Index->rates = BYTEVIEW{ nullptr, 0 };
+	Index->sequence = BYTEVIEW{ nullptr, 0 };
+
+	if (IsAnimatedCursorFile(File))
+	{
+		// Some writers store a wrong RIFF size, the chunks are read until the end of the file at most
+		BYTEVIEW Chunks = BYTEVIEW{ nullptr, 0 };
+		size_t RiffEnd = std::min<size_t>(File.size, size_t(ReadUInt32(File.data + 4)) + 8);
+		GetSubView(File, 12, RiffEnd - std::min<size_t>(RiffEnd, 12), &Chunks);
+
+		size_t Offset = 0;
+		RIFFCHUNK Chunk;
+		while (ReadRiffChunk(Chunks, &Offset, &Chunk))
+		{
+			if (IsChunkId(Chunk.id, "anih"))
+			{
+				IsHeaderFound = ReadAniHeader(Chunk.datas, &Index->header);
+			}
+			else if (IsChunkId(Chunk.id, "rate"))
+			{
+				Index->rates = Chunk.datas;
+			}
+			else if (IsChunkId(Chunk.id, "seq "))
+			{
+				Index->sequence = Chunk.datas;
+			}
+			else if (IsChunkId(Chunk.id, "LIST") && Chunk.datas.size >= 4 && IsChunkId(Chunk.datas.data, "fram"))
+			{
+				BYTEVIEW Frames;
+				GetSubView(Chunk.datas, 4, Chunk.datas.size - 4, &Frames);
+
+				size_t FrameOffset = 0;
+				RIFFCHUNK FrameChunk;
+				while (ReadRiffChunk(Frames, &FrameOffset, &FrameChunk))
+				{
+					if (IsChunkId(FrameChunk.id, "icon"))
+					{
+						Index->frames.push_back(FrameChunk.datas);
+					}
+				}
+			}
+		}
+	}
+
+	// Raw bitmap frames are not supported, only frames stored as cursor files
+	return IsHeaderFound && (Index->header.bfAttributes & ANI_FLAG_ICON_FRAMES) != 0 && !Index->frames.empty();
+}
+
+/**
+ * Get the frames displayed by an animation, each one only once.
+ *
+ * @param Index the index of the animation.
+ * @return The sorted indexes of the displayed frames.
+ */
+std::vector<uint32_t> MouseCursorSizeHelper::GetUsedFramesOfAnimation(const ANIINDEX& Index)
+{
+	std::vector<uint32_t> UsedFrames;
+	size_t StepsCount = Index.sequence.size / sizeof(uint32_t);
+
+	if (StepsCount > 0)
+	{
+		// The sequence can display the same frame several times
+		for (size_t i = 0; i < StepsCount; i++)
+		{
+			uint32_t FrameIndex = ReadUInt32(Index.sequence.data + i * sizeof(uint32_t));
+			if (FrameIndex < Index.frames.size())
+			{
+				UsedFrames.push_back(FrameIndex);
+			}
+		}
+
+		std::sort(UsedFrames.begin(), UsedFrames.end());
+		UsedFrames.erase(std::unique(UsedFrames.begin(), UsedFrames.end()), UsedFrames.end());
+	}
+	else
+	{
+		// Without sequence, the frames are displayed in order
+		for (size_t i = 0; i < Index.frames.size(); i++)
+		{
+			UsedFrames.push_back(uint32_t(i));
+		}
+	}
+
+	return UsedFrames;
+}
+
+/**
+ * Compute the size of an animated cursor, without scales.
+ * The size is the one of the union of the visible parts of all the displayed frames, aligned on their hotspots.
+ * Each displayed frame is decoded once, in parallel when there are enough of them.
+ *
+ * @param File the view of the whole animated cursor file.
+ * @param Settings the settings read from the system.
+ * @param SizeData the size informations.
+ * @param CursorSize the computed original real size of mouse cursor (without scales).
+ * @return True if at least one frame has a visible pixel.
+ */
+bool MouseCursorSizeHelper::ComputeAnimatedCursorSize(const BYTEVIEW& File, const CURSORSETTINGS& Settings, SIZEDATA* SizeData, std::pair<float, float>* CursorSize)
+{
+	bool IsComputed = false;
+	ANIINDEX Index;
+
+	if (IndexAnimatedCursor(File, &Index))
+	{
+		std::vector<uint32_t> UsedFrames = GetUsedFramesOfAnimation(Index);
+		std::vector<BOUNDINGBOX> Boxes(UsedFrames.size());
+		std::vector<uint8_t> AreRealSizes(UsedFrames.size(), 0);
+
+		auto DecodeFrame = [&](size_t FrameIndex) {
+			QUERYWORKSPACE Workspace;
+			FRAMEVIEW Frame;
+			SIZEDATA FrameSizeData;
+			FrameSizeData.isRealSize = false;
+			Boxes[FrameIndex].isEmpty = true;
+
+			if (GetCursorFrame(Index.frames[UsedFrames[FrameIndex]], Settings, &Frame, &FrameSizeData))
+			{
+				Boxes[FrameIndex] = ComputeFrameBoundingBox(Frame, FrameSizeData, &Workspace);
+				AreRealSizes[FrameIndex] = FrameSizeData.isRealSize;
+
+				// The hotspot of the animation is the one of its first used frame
+				if (FrameIndex == 0)
+				{
+					SizeData->hotspotX = Frame.hotspotX;
+					SizeData->hotspotY = Frame.hotspotY;
+				}
+			}
+		};
+
+		if (UsedFrames.size() >= ANI_MIN_PARALLEL_FRAMES)
+		{
+			RunInParallel(UsedFrames.size(), DecodeFrame);
+		}
+		else
+		{
+			for (size_t i = 0; i < UsedFrames.size(); i++)
+			{
+				DecodeFrame(i);
+			}
+		}
+
+		BOUNDINGBOX Union;
+		Union.isEmpty = true;
+		bool IsRealSize = true;
+		for (size_t i = 0; i < Boxes.size(); i++)
+		{
+			MergeBoundingBoxes(Boxes[i], &Union);
+			IsRealSize = IsRealSize && AreRealSizes[i];
+		}
+
+		IsComputed = !Union.isEmpty;
+		if (IsComputed)
+		{
+			*CursorSize = std::pair<float, float>(float(Union.right - Union.left + 1), float(Union.bottom - Union.top + 1));
+			SizeData->isRealSize = IsRealSize;
+		}
+	}
+
+	return IsComputed;
+}
+
+/**
+ * Compute the bounding box of the visible pixels of a picture, relative to its hotspot.
+ *
+ * @param Frame the views on the pixels and on the mask of the picture.
+ * @param SizeData the size informations.
+ * @param Workspace the buffers used to decode a PNG picture.
+ * @return The bounding box of the visible pixels.
+ */
+MouseCursorSizeHelper::BOUNDINGBOX MouseCursorSizeHelper::ComputeFrameBoundingBox(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace)
+{
+	TRACESPAN Span(TRACE_EVENT_SCAN);
+	Span.bytes = Frame.pixels.size + Frame.mask.size + Frame.png.size;
+	STATS_COUNT(framesDecoded, 1);
+
+	BOUNDINGBOX Box;
+	Box.isEmpty = true;
+
+	auto AddLine = [&Box](const int& IndexY, const int& FirstIndex, const int& LastIndex) {
+		if (Box.isEmpty)
+		{
+			Box.left = FirstIndex;
+			Box.right = LastIndex;
+			Box.top = IndexY;
+			Box.isEmpty = false;
+		}
+
+		Box.left = std::min(Box.left, FirstIndex);
+		Box.right = std::max(Box.right, LastIndex);
+		Box.bottom = IndexY;
+	};
+
+	if (Frame.png.size != 0)
+	{
+		bool IsDecoded = DecodePngAlphaRows(Frame.png, Workspace, [&](const int& IndexY, const uint8_t* Alpha) {
+			int FirstIndex = 0;
+			int LastIndex = 0;
+			if (ScanAlphaLine(Alpha, SizeData.width, &FirstIndex, &LastIndex))
+			{
+				AddLine(IndexY, FirstIndex, LastIndex);
+			}
+		});
+
+		if (!IsDecoded)
+		{
+			Box.isEmpty = true;
+		}
+	}
+	else if (Frame.bitCount != 32)
+	{
+		std::array<uint8_t, 256> PaletteTable = BuildPaletteVisibilityTable(Frame);
+		for (int y = 0; y < SizeData.height; y++)
+		{
+			int FirstIndex = 0;
+			int LastIndex = 0;
+			int LineIndex = SizeData.isBottomUp ? SizeData.height - 1 - y : y;
+
+			if (ScanLowDepthLine(Frame, PaletteTable, SizeData.width, LineIndex, &FirstIndex, &LastIndex))
+			{
+				AddLine(y, FirstIndex, LastIndex);
+			}
+		}
+	}
+	else
+	{
+		static const LINESCANFUNCTION ScanLine = GetLineScanFunction();
+		bool IsMaskConsistent = Frame.mask.data != nullptr;
+		for (int y = 0; y < SizeData.height; y++)
+		{
+			int FirstIndex = 0;
+			int LastIndex = 0;
+			int LineIndex = SizeData.isBottomUp ? SizeData.height - 1 - y : y;
+			const uint8_t* Line = Frame.pixels.data + size_t(LineIndex) * SizeData.width * BYTES_PER_PIXEL;
+			const uint8_t* MaskLine = Frame.mask.data != nullptr ? Frame.mask.data + LineIndex * Frame.maskStride : nullptr;
+			bool IsFound = IsMaskConsistent
+				? ScanLineFromMask(Line, MaskLine, SizeData.width, &FirstIndex, &LastIndex, &IsMaskConsistent)
+				: ScanLine(Line, MaskLine, SizeData.width, &FirstIndex, &LastIndex);
+
+			if (IsFound)
+			{
+				AddLine(y, FirstIndex, LastIndex);
+			}
+		}
+	}
+
+	if (!Box.isEmpty)
+	{
+		Box.left -= Frame.hotspotX;
+		Box.right -= Frame.hotspotX;
+		Box.top -= Frame.hotspotY;
+		Box.bottom -= Frame.hotspotY;
+	}
+
+	return Box;
+}
+
+/**
+ * Merge a bounding box into a union of bounding boxes.
+ *
+ * @param Box the bounding box to merge.
+ * @param Union the union of bounding boxes.
+ */
+void MouseCursorSizeHelper::MergeBoundingBoxes(const BOUNDINGBOX& Box, BOUNDINGBOX* Union)
+{
+	if (!Box.isEmpty)
+	{
+		if (Union->isEmpty)
+		{
+			*Union = Box;
+		}
+		else
+		{
+			Union->left = std::min(Union->left, Box.left);
+			Union->top = std::min(Union->top, Box.top);
+			Union->right = std::max(Union->right, Box.right);
+			Union->bottom = std::max(Union->bottom, Box.bottom);
+		}
+	}
+}
+
+/**
+ * Check if a picture of a cursor file is stored as PNG instead of bitmap.
+ *
+ * @param Image the view of the picture datas in the cursor file.
+ * @return True if the picture starts with the PNG signature.
+ */
+bool MouseCursorSizeHelper::IsPngPicture(const BYTEVIEW& Image)
+{
+	static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	return Image.size >= sizeof(PNG_SIGNATURE) && std::memcmp(Image.data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0;
+}
+
+/**
+ * Read a big endian unsigned 32 bits value.
+ *
+ * @param Bytes the bytes of the value.
+ * @return The value.
+ */
+uint32_t MouseCursorSizeHelper::ReadUInt32BigEndian(const uint8_t* Bytes)
+{
+	return (uint32_t(Bytes[0]) << 24) | (uint32_t(Bytes[1]) << 16) | (uint32_t(Bytes[2]) << 8) | uint32_t(Bytes[3]);
+}
+
+/**
+ * Read the header of a PNG picture, which must be its first chunk.
+ *
+ * @param Image the view of the PNG picture.
+ * @param Header the header read.
+ * @return True if the header describes a supported picture.
+ */
+bool MouseCursorSizeHelper::ReadPngHeader(const BYTEVIEW& Image, PNGHEADER* Header)
+{
+	BYTEVIEW Record;
+	bool IsRead = GetSubView(Image, 8, 8 + 13, &Record) && ReadUInt32BigEndian(Record.data) == 13 && IsChunkId(Record.data + 4, "IHDR");
+
+	if (IsRead)
+	{
+		Header->width = ReadUInt32BigEndian(Record.data + 8);
+		Header->height = ReadUInt32BigEndian(Record.data + 12);
+		Header->bitDepth = Record.data[16];
+		Header->colorType = Record.data[17];
+		Header->compression = Record.data[18];
+		Header->filter = Record.data[19];
+		Header->interlace = Record.data[20];
+
+		int Depth = Header->bitDepth;
+		bool IsValidDepth = false;
+		switch (Header->colorType)
+		{
+		case 0:
+			IsValidDepth = Depth == 1 || Depth == 2 || Depth == 4 || Depth == 8 || Depth == 16;
+			break;
+		case 3:
+			IsValidDepth = Depth == 1 || Depth == 2 || Depth == 4 || Depth == 8;
+			break;
+		case 2:
+		case 4:
+		case 6:
+			IsValidDepth = Depth == 8 || Depth == 16;
+			break;
+		}
+
+		// Interlaced pictures would need the whole alpha channel to be decoded at once
+		IsRead = IsValidDepth && Header->compression == 0 && Header->filter == 0 && Header->interlace == 0
+			&& Header->width > 0 && Header->width <= PNG_MAX_PICTURE_SIZE
+			&& Header->height > 0 && Header->height <= PNG_MAX_PICTURE_SIZE;
+	}
+
+	return IsRead;
+}
+
+/**
+ * Get the view on a picture stored as PNG. The picture is not decoded.
+ *
+ * @param Image the view of the PNG picture in the cursor file.
+ * @param Frame the view on the PNG picture.
+ * @param SizeData the size informations.
+ * @return True if the picture is a supported PNG picture.
+ */
+bool MouseCursorSizeHelper::GetPngFrameView(const BYTEVIEW& Image, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+	TRACESPAN Span(TRACE_EVENT_DECODE_FRAME);
+	Span.bytes = Image.size;
+
+	PNGHEADER Header;
+	bool IsValid = ReadPngHeader(Image, &Header);
+
+	if (IsValid)
+	{
+		Frame->pixels = BYTEVIEW{ nullptr, 0 };
+		Frame->mask = BYTEVIEW{ nullptr, 0 };
+		Frame->maskStride = 0;
+		Frame->palette = BYTEVIEW{ nullptr, 0 };
+		Frame->pixelsStride = 0;
+		Frame->bitCount = 32;
+		Frame->png = Image;
+		SizeData->width = int(Header.width);
+		SizeData->height = int(Header.height);
+		SizeData->isBottomUp = false; // The lines of a PNG are stored from top to bottom
+	}
+
+	return IsValid;
+}
+
+/**
+ * Decode the alpha channel of a PNG picture line by line, from top to bottom.
+ * The lines are inflated and unfiltered one at a time, only two lines are kept in memory.
+ * The pictures without transparency are not decompressed, all their lines are opaque.
+ *
+ * @param Png the view of the PNG picture.
+ * @param Workspace the buffers of the lines and of the decompression window, only grown when too small.
+ * @param ProcessRow the function receiving the index and the alpha channel (1 byte per pixel) of each line.
+ * @return True if all the lines were decoded.
+ */
+template <typename ROWFUNCTION>
+bool MouseCursorSizeHelper::DecodePngAlphaRows(const BYTEVIEW& Png, QUERYWORKSPACE* Workspace, const ROWFUNCTION& ProcessRow)
+{
+	PNGHEADER Header;
+	if (!ReadPngHeader(Png, &Header))
+	{
+		return false;
+	}
+
+	// Find the transparency and the first chunk of compressed datas
+	BYTEVIEW Transparency = BYTEVIEW{ nullptr, 0 };
+	BYTEVIEW Datas = BYTEVIEW{ nullptr, 0 };
+	size_t DatasOffset = 0;
+	size_t Offset = 8;
+	BYTEVIEW ChunkHeader;
+	BYTEVIEW Chunk;
+	while (Datas.data == nullptr && GetSubView(Png, Offset, 8, &ChunkHeader)
+		&& GetSubView(Png, Offset + 8, ReadUInt32BigEndian(ChunkHeader.data), &Chunk) && !IsChunkId(ChunkHeader.data + 4, "IEND"))
+	{
+		if (IsChunkId(ChunkHeader.data + 4, "tRNS"))
+		{
+			Transparency = Chunk;
+		}
+		else if (IsChunkId(ChunkHeader.data + 4, "IDAT"))
+		{
+			Datas = Chunk;
+			DatasOffset = Offset + 8;
+		}
+
+		// Skip the length, the type, the datas and the CRC of the chunk
+		Offset += 12 + Chunk.size;
+	}
+
+	int Channels = Header.colorType == 2 ? 3 : Header.colorType == 4 ? 2 : Header.colorType == 6 ? 4 : 1;
+	size_t PixelBits = size_t(Channels) * Header.bitDepth;
+	size_t RowSize = (Header.width * PixelBits + 7) / 8;
+	size_t PixelSize = std::max<size_t>(1, PixelBits / 8);
+
+	// The previous line, the current line (both with their filter type) and the alpha channel
+	Workspace->pngLines.resize(2 * (RowSize + 1) + Header.width);
+	uint8_t* PreviousRow = Workspace->pngLines.data();
+	uint8_t* Row = PreviousRow + RowSize + 1;
+	uint8_t* Alpha = Row + RowSize + 1;
+	std::fill(PreviousRow, Row, uint8_t(0));
+	std::fill(Alpha, Alpha + Header.width, uint8_t(0xFF));
+
+	bool IsOpaque = Header.colorType != 4 && Header.colorType != 6 && Transparency.size == 0;
+	if (IsOpaque)
+	{
+		for (uint32_t y = 0; y < Header.height; y++)
+		{
+			ProcessRow(int(y), Alpha);
+		}
+
+		return true;
+	}
+
+	if (Datas.data == nullptr)
+	{
+		return false;
+	}
+
+	// The compressed datas start with the zlib header (deflate, no preset dictionary)
+	INFLATESTATE State;
+	Workspace->inflateWindow.resize(INFLATE_WINDOW_SIZE);
+	InitInflateState(Png, DatasOffset, Datas.size, Workspace->inflateWindow.data(), &State);
+	uint32_t CompressionMethod = 0;
+	uint32_t Flags = 0;
+	if (!ReadInflateBits(&State, 8, &CompressionMethod) || !ReadInflateBits(&State, 8, &Flags)
+		|| (CompressionMethod & 0x0F) != 8 || (CompressionMethod * 256 + Flags) % 31 != 0 || (Flags & 0x20) != 0)
+	{
+		return false;
+	}
+
+	// Each line starts with the type of its filter
+	for (uint32_t y = 0; y < Header.height; y++)
+	{
+		if (!Inflate(&State, Row, RowSize + 1) || !UnfilterPngRow(Row[0], Row + 1, PreviousRow + 1, RowSize, PixelSize))
+		{
+			return false;
+		}
+
+		ExtractPngAlpha(Row + 1, Header, Transparency, Alpha);
+		ProcessRow(int(y), Alpha);
+		std::swap(Row, PreviousRow);
+	}
+
+	return true;
+}
+
+/**
+ * Revert the filter of a line of a PNG picture, in place.
+ *
+ * @param Filter the type of the filter of the line.
+ * @param Row the filtered line, unfiltered in place.
+ * @param PreviousRow the previous unfiltered line (zeros for the first line).
+ * @param RowSize the number of bytes of a line.
+ * @param PixelSize the number of bytes of a pixel, rounded up to 1.
+ * @return True if the filter type is valid.
+ */
+bool MouseCursorSizeHelper::UnfilterPngRow(const uint8_t& Filter, uint8_t* Row, const uint8_t* PreviousRow, const size_t& RowSize, const size_t& PixelSize)
+{
+	bool IsValid = Filter <= 4;
+
+	switch (Filter)
+	{
+	case 1: // Sub
+		for (size_t i = PixelSize; i < RowSize; i++) {
+			Row[i] = uint8_t(Row[i] + Row[i - PixelSize]);
+		}
+		break;
+	case 2: // Up
+		for (size_t i = 0; i < RowSize; i++) {
+			Row[i] = uint8_t(Row[i] + PreviousRow[i]);
+		}
+		break;
+	case 3: // Average
+		for (size_t i = 0; i < RowSize; i++) {
+			int Left = i >= PixelSize ? Row[i - PixelSize] : 0;
+			Row[i] = uint8_t(Row[i] + ((Left + PreviousRow[i]) >> 1));
+		}
+		break;
+	case 4: // Paeth
+		for (size_t i = 0; i < RowSize; i++) {
+			int Left = i >= PixelSize ? Row[i - PixelSize] : 0;
+			int Up = PreviousRow[i];
+			int UpLeft = i >= PixelSize ? PreviousRow[i - PixelSize] : 0;
+			int Estimate = Left + Up - UpLeft;
+			int LeftDistance = abs(Estimate - Left);
+			int UpDistance = abs(Estimate - Up);
+			int UpLeftDistance = abs(Estimate - UpLeft);
+			int Predictor = LeftDistance <= UpDistance && LeftDistance <= UpLeftDistance ? Left : UpDistance <= UpLeftDistance ? Up : UpLeft;
+			Row[i] = uint8_t(Row[i] + Predictor);
+		}
+		break;
+	}
+
+	return IsValid;
+}
+
+/**
+ * Extract the alpha channel of an unfiltered line of a PNG picture.
+ * A 16 bits alpha keeps its high byte, but is never rounded down to 0 if it is not 0.
+ *
+ * @param Row the unfiltered line.
+ * @param Header the header of the picture.
+ * @param Transparency the datas of the tRNS chunk (empty if there is none).
+ * @param Alpha the alpha channel of the line (1 byte per pixel).
+ */
+void MouseCursorSizeHelper::ExtractPngAlpha(const uint8_t* Row, const PNGHEADER& Header, const BYTEVIEW& Transparency, uint8_t* Alpha)
+{
+	int Depth = Header.bitDepth;
+
+	switch (Header.colorType)
+	{
+	case 4:
+	case 6:
+	{
+		size_t SampleSize = size_t(Depth / 8);
+		size_t PixelSize = (Header.colorType == 6 ? 4 : 2) * SampleSize;
+		const uint8_t* Sample = Row + PixelSize - SampleSize;
+
+		for (uint32_t x = 0; x < Header.width; x++, Sample += PixelSize) {
+			Alpha[x] = SampleSize == 1 || Sample[0] != 0 ? Sample[0] : uint8_t(Sample[1] != 0);
+		}
+		break;
+	}
+	case 3:
+		// The palette indexes without transparency are opaque
+		for (uint32_t x = 0; x < Header.width; x++) {
+			uint16_t PaletteIndex = ReadPngSample(Row, x, Depth);
+			Alpha[x] = PaletteIndex < Transparency.size ? Transparency.data[PaletteIndex] : 0xFF;
+		}
+		break;
+	case 0:
+	case 2:
+	{
+		// Only the pixels of the transparent color are transparent
+		int Channels = Header.colorType == 2 ? 3 : 1;
+		if (Transparency.size < size_t(Channels) * 2)
+		{
+			std::fill(Alpha, Alpha + Header.width, uint8_t(0xFF));
+			break;
+		}
+
+		for (uint32_t x = 0; x < Header.width; x++) {
+			bool IsTransparent = true;
+			for (int Channel = 0; Channel < Channels && IsTransparent; Channel++) {
+				uint16_t Key = uint16_t((Transparency.data[Channel * 2] << 8) | Transparency.data[Channel * 2 + 1]);
+				IsTransparent = ReadPngSample(Row, size_t(x) * Channels + Channel, Depth) == Key;
+			}
+			Alpha[x] = IsTransparent ? 0 : 0xFF;
+		}
+		break;
+	}
+	}
+}
+
+/**
+ * Read a sample of an unfiltered line of a PNG picture.
+ *
+ * @param Row the unfiltered line.
+ * @param Index the index of the sample in the line.
+ * @param BitDepth the number of bits of a sample.
+ * @return The value of the sample.
+ */
+uint16_t MouseCursorSizeHelper::ReadPngSample(const uint8_t* Row, const size_t& Index, const int& BitDepth)
+{
+	if (BitDepth == 16)
+	{
+		return uint16_t((Row[Index * 2] << 8) | Row[Index * 2 + 1]);
+	}
+	if (BitDepth == 8)
+	{
+		return Row[Index];
+	}
+
+	// The samples smaller than a byte are packed from the high bits
+	size_t BitIndex = Index * BitDepth;
+	return uint16_t((Row[BitIndex / 8] >> (8 - BitDepth - BitIndex % 8)) & ((1 << BitDepth) - 1));
+}
+
+/**
+ * Build the table of the visible pixels of a byte of palette indexes.
+ * Without mask, a pixel is visible if its color is not black (a black pixel leaves the screen unchanged).
+ *
+ * @param Frame the views on the palette and on the pixels of the picture.
+ * @return The table giving for each byte of indexes the bits i set if the pixel i of the byte is visible.
+ */
+std::array<uint8_t, 256> MouseCursorSizeHelper::BuildPaletteVisibilityTable(const FRAMEVIEW& Frame)
+{
+	std::array<uint8_t, 256> Table = {};
+	std::array<bool, 256> IsColored = {};
+
+	for (size_t i = 0; i < Frame.palette.size / BYTES_PER_PIXEL; i++)
+	{
+		const uint8_t* Color = Frame.palette.data + i * BYTES_PER_PIXEL;
+		IsColored[i] = (Color[0] | Color[1] | Color[2]) != 0;
+	}
+
+	// A byte holds 8 / BitCount indexes, the first one in the highest bits
+	if (Frame.bitCount <= 8)
+	{
+		int PixelsPerByte = 8 / Frame.bitCount;
+		int IndexMask = (1 << Frame.bitCount) - 1;
+		for (int Byte = 0; Byte < 256; Byte++)
+		{
+			for (int i = 0; i < PixelsPerByte; i++)
+			{
+				int PaletteIndex = (Byte >> (8 - Frame.bitCount * (i + 1))) & IndexMask;
+				Table[Byte] |= uint8_t(IsColored[PaletteIndex] << i);
+			}
+		}
+	}
+
+	return Table;
+}
+
+/**
+ * Get the visibility of 8 consecutive pixels of a line of a picture without alpha channel (1, 4, 8 or 24 bits per pixel).
+ * A pixel is visible if it is not masked or if its color is not black. The pixels are processed with the
+ * palette and mask tables, a whole byte of indexes at a time.
+ *
+ * @param Frame the views on the palette, the pixels and the mask of the picture.
+ * @param PaletteTable the table of the visible pixels of a byte of palette indexes.
+ * @param Line the line of the pixels.
+ * @param MaskLine the line of the mask.
+ * @param Width the number of pixels of the line.
+ * @param ByteIndex the index of the group of 8 pixels in the line.
+ * @return The bits i set if the pixel 8 * ByteIndex + i is visible.
+ */
+uint8_t MouseCursorSizeHelper::GetVisiblePixelsByte(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const uint8_t* Line, const uint8_t* MaskLine, const int& Width, const int& ByteIndex)
+{
+	// The pixels out of the mask are visible whatever their color
+	uint8_t Bits = MaskExpansionTable[MaskLine[ByteIndex]];
+
+	if (ByteIndex < Width / 8)
+	{
+		const uint8_t* Pixels = Line + size_t(ByteIndex) * Frame.bitCount;
+
+		switch (Frame.bitCount)
+		{
+		case 1:
+			Bits |= PaletteTable[Pixels[0]];
+			break;
+		case 4:
+			Bits |= uint8_t(PaletteTable[Pixels[0]] | (PaletteTable[Pixels[1]] << 2) | (PaletteTable[Pixels[2]] << 4) | (PaletteTable[Pixels[3]] << 6));
+			break;
+		case 8:
+			Bits |= uint8_t(PaletteTable[Pixels[0]] | (PaletteTable[Pixels[1]] << 1) | (PaletteTable[Pixels[2]] << 2) | (PaletteTable[Pixels[3]] << 3)
+				| (PaletteTable[Pixels[4]] << 4) | (PaletteTable[Pixels[5]] << 5) | (PaletteTable[Pixels[6]] << 6) | (PaletteTable[Pixels[7]] << 7));
+			break;
+		case 24:
+			for (int i = 0; i < 8; i++) {
+				Bits |= uint8_t(((Pixels[i * 3] | Pixels[i * 3 + 1] | Pixels[i * 3 + 2]) != 0) << i);
+			}
+			break;
+		}
+	}
+	else
+	{
+		// The last pixels don't fill a whole byte, the bits after the end of the line are cleared
+		Bits &= uint8_t((1 << (Width % 8)) - 1);
+		for (int x = ByteIndex * 8; x < Width; x++) {
+			Bits |= uint8_t(IsVisibleLowDepthPixel(Frame, PaletteTable, Line, x) << (x % 8));
+		}
+	}
+
+	return Bits;
+}
+
+/**
+ * Check if 64 consecutive pixels of a line of a picture without alpha channel are all masked and black.
+ * These pixels are the most common ones, their bytes are checked a word at a time.
+ *
+ * @param Frame the views on the palette, the pixels and the mask of the picture.
+ * @param Line the line of the pixels.
+ * @param MaskLine the line of the mask.
+ * @param ByteIndex the index of the first group of 8 pixels in the line.
+ * @return True if the 64 pixels are masked and their palette index or color is zero.
+ */
+bool MouseCursorSizeHelper::IsMaskedBlackRun(const FRAMEVIEW& Frame, const uint8_t* Line, const uint8_t* MaskLine, const int& ByteIndex)
+{
+	uint64_t Mask;
+	std::memcpy(&Mask, MaskLine + ByteIndex, sizeof(uint64_t));
+
+	return Mask == ~uint64_t(0) && IsZeroBytes(Line + size_t(ByteIndex) * Frame.bitCount, size_t(Frame.bitCount) * 8);
+}
+
+/**
+ * Check if bytes are all zero, 8 bytes at a time.
+ *
+ * @param Bytes the bytes to check.
+ * @param Count the number of bytes to check, a multiple of 8.
+ * @return True if all the bytes are zero.
+ */
+bool MouseCursorSizeHelper::IsZeroBytes(const uint8_t* Bytes, const size_t& Count)
+{
+	uint64_t Union = 0;
+
+	for (size_t i = 0; i < Count; i += sizeof(uint64_t))
+	{
+		uint64_t Word;
+		std::memcpy(&Word, Bytes + i, sizeof(uint64_t));
+		Union |= Word;
+	}
+
+	return Union == 0;
+}
+
+/**
+ * Check if the color of a pixel of a picture without alpha channel is not black, regardless of the mask.
+ *
+ * @param Frame the views on the palette and on the pixels of the picture.
+ * @param PaletteTable the table of the visible pixels of a byte of palette indexes.
+ * @param Line the line of the pixels.
+ * @param IndexX the index of the pixel in the line.
+ * @return True if the color of the pixel is not black.
+ */
+bool MouseCursorSizeHelper::IsVisibleLowDepthPixel(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const uint8_t* Line, const int& IndexX)
+{
+	if (Frame.bitCount == 24)
+	{
+		const uint8_t* Color = Line + IndexX * 3;
+		return (Color[0] | Color[1] | Color[2]) != 0;
+	}
+
+	int PixelsPerByte = 8 / Frame.bitCount;
+	return (PaletteTable[Line[IndexX / PixelsPerByte]] & (1 << (IndexX % PixelsPerByte))) != 0;
+}
+
+/**
+ * Get the first and last visible pixels of a line of a picture without alpha channel.
+ * Like the other line scans, the line is read from both ends until a visible pixel is found.
+ *
+ * @param Frame the views on the palette, the pixels and the mask of the picture.
+ * @param PaletteTable the table of the visible pixels of a byte of palette indexes.
+ * @param Width the number of pixels of the line.
+ * @param LineIndex the index of the line in memory.
+ * @param FirstIndex the index of the first visible pixel.
+ * @param LastIndex the index of the last visible pixel.
+ * @return True if the line has a visible pixel.
+ */
+bool MouseCursorSizeHelper::ScanLowDepthLine(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const int& Width, const int& LineIndex, int* FirstIndex, int* LastIndex)
+{
+	const uint8_t* Line = Frame.pixels.data + LineIndex * Frame.pixelsStride;
+	const uint8_t* MaskLine = Frame.mask.data + LineIndex * Frame.maskStride;
+	int BytesCount = (Width + 7) / 8;
+	int FullBytes = Width / 8;
+
+	// The lines of a monochrome picture have the same layout as the lines of the mask, both are read 32 pixels at a time
+	if (Frame.bitCount == 1)
+	{
+		uint32_t ColoredOnes = PaletteTable[0xFF] != 0 ? ~uint32_t(0) : 0;
+		uint32_t ColoredZeros = PaletteTable[0x00] != 0 ? ~uint32_t(0) : 0;
+		return ScanMaskLine(MaskLine, Line, ColoredOnes, ColoredZeros, Width, FirstIndex, LastIndex);
+	}
+
+	// The runs of masked pixels with a black palette index or color are skipped 64 pixels at a time
+	bool IsZeroBlack = PaletteTable[0] == 0;
+
+	int First = 0;
+	uint8_t FirstBits = 0;
+	while (First < BytesCount)
+	{
+		if (IsZeroBlack && First + 8 <= FullBytes && IsMaskedBlackRun(Frame, Line, MaskLine, First))
+		{
+			First += 8;
+		}
+		else if ((FirstBits = GetVisiblePixelsByte(Frame, PaletteTable, Line, MaskLine, Width, First)) == 0)
+		{
+			First++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	bool IsFound = First < BytesCount;
+	if (IsFound)
+	{
+		int Last = BytesCount - 1;
+		uint8_t LastBits = 0;
+		while (Last > First)
+		{
+			if (IsZeroBlack && Last < FullBytes && Last - 8 >= First && IsMaskedBlackRun(Frame, Line, MaskLine, Last - 7))
+			{
+				Last -= 8;
+			}
+			else if ((LastBits = GetVisiblePixelsByte(Frame, PaletteTable, Line, MaskLine, Width, Last)) == 0)
+			{
+				Last--;
+			}
+			else
+			{
+				break;
+			}
+		}
+		if (Last == First)
+		{
+			LastBits = FirstBits;
+		}
+
+		*FirstIndex = First * 8 + CountTrailingZeros(FirstBits);
+		*LastIndex = Last * 8 + 31 - CountLeadingZeros(LastBits);
+	}
+
+	return IsFound;
+}
+
+/**
+ * Compute the mouse cursor size from a picture without alpha channel (1, 4, 8 or 24 bits per pixel).
+ *
+ * @param Frame the views on the palette, the pixels and the mask of the picture.
+ * @param SizeData the size informations.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromLowDepthFrame(const FRAMEVIEW& Frame, const SIZEDATA& SizeData)
+{
+	std::array<uint8_t, 256> PaletteTable = BuildPaletteVisibilityTable(Frame);
+	FIRSTLASTINDEXES FirstLastIndexes = InitFirstLastIndexesStruct();
+	float Width = 0;
+
+	for (int y = 0; y < SizeData.height; y++) {
+		int FirstIndex = 0;
+		int LastIndex = 0;
+		int LineIndex = SizeData.isBottomUp ? SizeData.height - 1 - y : y;
+
+		if (ScanLowDepthLine(Frame, PaletteTable, SizeData.width, LineIndex, &FirstIndex, &LastIndex))
+		{
+			GetFirstAndLastIndexesFromLine(FirstIndex, LastIndex, &FirstLastIndexes, y);
+		}
+
+		// Compute valid width of the line
+		Width = std::max(Width, float(FirstLastIndexes.lastIndexWidth - FirstLastIndexes.firstIndexWidth + 1));
+	}
+
+	return std::pair<float, float>(Width, float(FirstLastIndexes.lastIndexHeight - FirstLastIndexes.firstIndexHeight + 1));
+}
+
+/**
+ * Compute the mouse cursor size from a picture stored as PNG.
+ * Only the alpha channel is decoded, line by line, no pixel array is built.
+ *
+ * @param Frame the view on the PNG picture.
+ * @param SizeData the size informations.
+ * @param Workspace the buffers used to decode the picture.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromPng(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace)
+{
+	std::pair<float, float> CursorSize = std::pair<float, float>(DEFAULT_ORIGIN_MOUSE_WIDTH, DEFAULT_ORIGIN_MOUSE_HEIGHT);
+	FIRSTLASTINDEXES FirstLastIndexes = InitFirstLastIndexesStruct();
+	float Width = 0;
+
+	bool IsDecoded = DecodePngAlphaRows(Frame.png, Workspace, [&](const int& IndexY, const uint8_t* Alpha) {
+		int FirstIndex = 0;
+		int LastIndex = 0;
+		if (ScanAlphaLine(Alpha, SizeData.width, &FirstIndex, &LastIndex))
+		{
+			GetFirstAndLastIndexesFromLine(FirstIndex, LastIndex, &FirstLastIndexes, IndexY);
+		}
+
+		// Compute valid width of the line
+		Width = std::max(Width, float(FirstLastIndexes.lastIndexWidth - FirstLastIndexes.firstIndexWidth + 1));
+	});
+
+	if (IsDecoded)
+	{
+		CursorSize = std::pair<float, float>(Width, float(FirstLastIndexes.lastIndexHeight - FirstLastIndexes.firstIndexHeight + 1));
+	}
+
+	return CursorSize;
+}
+
+/**
+ * Get the first and last pixels of a line with a non zero alpha.
+ *
+ * @param Alpha the alpha channel of the line (1 byte per pixel).
+ * @param Width the number of pixels of the line.
+ * @param FirstIndex the index of the first visible pixel.
+ * @param LastIndex the index of the last visible pixel.
+ * @return True if the line has a visible pixel.
+ */
+bool MouseCursorSizeHelper::ScanAlphaLine(const uint8_t* Alpha, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	int First = 0;
+	while (First < Width && Alpha[First] == 0)
+	{
+		First++;
+	}
+
+	bool IsFound = First < Width;
+	if (IsFound)
+	{
+		int Last = Width - 1;
+		while (Alpha[Last] == 0)
+		{
+			Last--;
+		}
+
+		*FirstIndex = First;
+		*LastIndex = Last;
+	}
+
+	return IsFound;
+}
+
+/**
+ * Initialize the decompression of the datas of a PNG picture.
+ *
+ * @param Png the view of the PNG picture.
+ * @param Offset the offset of the datas of the first IDAT chunk in the picture.
+ * @param Size the size of the datas of the first IDAT chunk.
+ * @param Window the buffer of the last decompressed bytes (INFLATE_WINDOW_SIZE bytes).
+ * @param State the state of the decompression.
+ */
+void MouseCursorSizeHelper::InitInflateState(const BYTEVIEW& Png, const size_t& Offset, const size_t& Size, uint8_t* Window, INFLATESTATE* State)
+{
+	State->png = Png;
+	State->inputOffset = Offset;
+	State->chunkEnd = Offset + Size;
+	State->isInputAvailable = true;
+	State->bitBuffer = 0;
+	State->bitCount = 0;
+	State->isInBlock = false;
+	State->isFinalBlock = false;
+	State->blockType = 0;
+	State->storedRemaining = 0;
+	State->matchRemaining = 0;
+	State->matchDistance = 0;
+	State->window = Window; // Only the bytes already decompressed are read back
+	State->outputCount = 0;
+}
+
+/**
+ * Read the next compressed byte. The compressed datas can be split in several consecutive IDAT chunks.
+ *
+ * @param State the state of the decompression.
+ * @param Byte the byte read.
+ * @return True if there was a byte left.
+ */
+bool MouseCursorSizeHelper::ReadNextInflateByte(INFLATESTATE* State, uint8_t* Byte)
+{
+	while (State->inputOffset == State->chunkEnd && State->isInputAvailable)
+	{
+		// Skip the CRC of the current chunk
+		BYTEVIEW ChunkHeader;
+		BYTEVIEW Chunk;
+		size_t NextChunk = State->chunkEnd + 4;
+		State->isInputAvailable = GetSubView(State->png, NextChunk, 8, &ChunkHeader) && IsChunkId(ChunkHeader.data + 4, "IDAT")
+			&& GetSubView(State->png, NextChunk + 8, ReadUInt32BigEndian(ChunkHeader.data), &Chunk);
+
+		if (State->isInputAvailable)
+		{
+			State->inputOffset = NextChunk + 8;
+			State->chunkEnd = State->inputOffset + Chunk.size;
+		}
+	}
+
+	bool IsRead = State->inputOffset < State->chunkEnd;
+	if (IsRead)
+	{
+		*Byte = State->png.data[State->inputOffset++];
+	}
+
+	return IsRead;
+}
+
+/**
+ * Fill the bit buffer with the next compressed bytes, as long as there are some.
+ *
+ * @param State the state of the decompression.
+ */
+void MouseCursorSizeHelper::RefillInflateBits(INFLATESTATE* State)
+{
+	// Most of the time, the missing bytes are all in the current chunk
+	size_t MissingBytes = size_t(63 - State->bitCount) / 8;
+	if (State->chunkEnd - State->inputOffset >= MissingBytes)
+	{
+		for (size_t i = 0; i < MissingBytes; i++)
+		{
+			State->bitBuffer |= uint64_t(State->png.data[State->inputOffset + i]) << State->bitCount;
+			State->bitCount += 8;
+		}
+		State->inputOffset += MissingBytes;
+		return;
+	}
+
+	uint8_t Byte;
+	while (State->bitCount <= 56 && ReadNextInflateByte(State, &Byte))
+	{
+		State->bitBuffer |= uint64_t(Byte) << State->bitCount;
+		State->bitCount += 8;
+	}
+}
+
+/**
+ * Read bits of the compressed datas, the first read bit being the lowest one.
+ *
+ * @param State the state of the decompression.
+ * @param Count the number of bits to read (16 at most).
+ * @param Bits the bits read.
+ * @return True if there were enough bits left.
+ */
+bool MouseCursorSizeHelper::ReadInflateBits(INFLATESTATE* State, const int& Count, uint32_t* Bits)
+{
+	if (State->bitCount < Count)
+	{
+		RefillInflateBits(State);
+	}
+
+	bool IsRead = State->bitCount >= Count;
+	if (IsRead)
+	{
+		*Bits = uint32_t(State->bitBuffer & ((uint64_t(1) << Count) - 1));
+		State->bitBuffer >>= Count;
+		State->bitCount -= Count;
+	}
+
+	return IsRead;
+}
+
+/**
+ * Build the canonical Huffman table of a block from the lengths of its codes.
+ *
+ * @param Lengths the length of the code of each symbol (0 if the symbol is not used).
+ * @param Count the number of symbols.
+ * @param Table the built table.
+ * @return True if the lengths describe valid codes.
+ */
+bool MouseCursorSizeHelper::BuildHuffmanTable(const uint8_t* Lengths, const int& Count, HUFFMANTABLE* Table)
+{
+	Table->counts.fill(0);
+	Table->fastSymbols.fill(0);
+	for (int Symbol = 0; Symbol < Count; Symbol++)
+	{
+		Table->counts[Lengths[Symbol]]++;
+	}
+	Table->counts[0] = 0;
+
+	// There can't be more codes of a length than the shorter codes leave
+	int Left = 1;
+	std::array<uint16_t, 16> Offsets;
+	std::array<uint32_t, 16> NextCodes;
+	Offsets[1] = 0;
+	NextCodes[1] = 0;
+	for (int Length = 1; Length < 16; Length++)
+	{
+		Left = (Left << 1) - Table->counts[Length];
+		if (Left < 0)
+		{
+			return false;
+		}
+		if (Length < 15)
+		{
+			Offsets[Length + 1] = uint16_t(Offsets[Length] + Table->counts[Length]);
+			NextCodes[Length + 1] = (NextCodes[Length] + Table->counts[Length]) << 1;
+		}
+	}
+
+	for (int Symbol = 0; Symbol < Count; Symbol++)
+	{
+		int Length = Lengths[Symbol];
+		if (Length != 0)
+		{
+			Table->symbols[Offsets[Length]++] = uint16_t(Symbol);
+
+			// The codes are read from their highest bit, the fast table is indexed by the reversed codes
+			uint32_t Code = NextCodes[Length]++;
+			if (Length <= 9)
+			{
+				uint32_t ReversedCode = 0;
+				for (int i = 0; i < Length; i++)
+				{
+					ReversedCode |= ((Code >> i) & 1) << (Length - 1 - i);
+				}
+				for (uint32_t Index = ReversedCode; Index < Table->fastSymbols.size(); Index += 1U << Length)
+				{
+					Table->fastSymbols[Index] = uint16_t((Length << 9) | Symbol);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Decode the next symbol of the compressed datas.
+ *
+ * @param State the state of the decompression.
+ * @param Table the Huffman table of the symbols.
+ * @param Symbol the decoded symbol.
+ * @return True if a valid code was read.
+ */
+bool MouseCursorSizeHelper::DecodeHuffmanSymbol(INFLATESTATE* State, const HUFFMANTABLE& Table, int* Symbol)
+{
+	if (State->bitCount < 15)
+	{
+		RefillInflateBits(State);
+	}
+
+	// Most of the codes are short enough to be found in the fast table
+	uint16_t FastSymbol = Table.fastSymbols[State->bitBuffer & 0x1FF];
+	int FastLength = FastSymbol >> 9;
+	if (FastLength != 0 && FastLength <= State->bitCount)
+	{
+		*Symbol = FastSymbol & 0x1FF;
+		State->bitBuffer >>= FastLength;
+		State->bitCount -= FastLength;
+		return true;
+	}
+
+	// The longer codes are read bit by bit
+	int Code = 0;
+	int First = 0;
+	int Index = 0;
+	for (int Length = 1; Length < 16 && Length <= State->bitCount; Length++)
+	{
+		Code |= int((State->bitBuffer >> (Length - 1)) & 1);
+		int Count = Table.counts[Length];
+		if (Code - First < Count)
+		{
+			*Symbol = Table.symbols[Index + Code - First];
+			State->bitBuffer >>= Length;
+			State->bitCount -= Length;
+			return true;
+		}
+		Index += Count;
+		First = (First + Count) << 1;
+		Code <<= 1;
+	}
+
+	return false;
+}
+
+/**
+ * Read the header of the next compressed block, with its Huffman tables.
+ *
+ * @param State the state of the decompression.
+ * @return True if the header is valid.
+ */
+bool MouseCursorSizeHelper::ReadInflateBlockHeader(INFLATESTATE* State)
+{
+	static const uint8_t CODE_LENGTHS_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	uint32_t Header = 0;
+
+	if (!ReadInflateBits(State, 3, &Header))
+	{
+		return false;
+	}
+
+	State->isFinalBlock = (Header & 1) != 0;
+	State->blockType = int(Header >> 1);
+	State->isInBlock = true;
+
+	if (State->blockType == 0)
+	{
+		// A stored block starts at the next byte with its length and the complement of its length
+		uint32_t Length = 0;
+		uint32_t LengthComplement = 0;
+		uint32_t Padding = 0;
+		bool IsValid = ReadInflateBits(State, State->bitCount % 8, &Padding)
+			&& ReadInflateBits(State, 16, &Length) && ReadInflateBits(State, 16, &LengthComplement)
+			&& Length == (~LengthComplement & 0xFFFF);
+
+		State->storedRemaining = Length;
+		return IsValid;
+	}
+
+	uint8_t Lengths[288 + 32] = { 0 };
+	int LiteralsCount = 288;
+	int DistancesCount = 32;
+
+	if (State->blockType == 1)
+	{
+		// Fixed codes
+		std::fill(Lengths, Lengths + 144, uint8_t(8));
+		std::fill(Lengths + 144, Lengths + 256, uint8_t(9));
+		std::fill(Lengths + 256, Lengths + 280, uint8_t(7));
+		std::fill(Lengths + 280, Lengths + 288, uint8_t(8));
+		std::fill(Lengths + 288, Lengths + 320, uint8_t(5));
+	}
+	else if (State->blockType == 2)
+	{
+		// Dynamic codes, their lengths are compressed with another Huffman code
+		uint32_t LiteralsCountBits = 0;
+		uint32_t DistancesCountBits = 0;
+		uint32_t CodeLengthsCountBits = 0;
+		if (!ReadInflateBits(State, 5, &LiteralsCountBits) || !ReadInflateBits(State, 5, &DistancesCountBits) || !ReadInflateBits(State, 4, &CodeLengthsCountBits))
+		{
+			return false;
+		}
+
+		LiteralsCount = int(LiteralsCountBits) + 257;
+		DistancesCount = int(DistancesCountBits) + 1;
+		if (LiteralsCount > 286 || DistancesCount > 30)
+		{
+			return false;
+		}
+
+		uint8_t CodeLengths[19] = { 0 };
+		for (uint32_t i = 0; i < CodeLengthsCountBits + 4; i++)
+		{
+			uint32_t CodeLength = 0;
+			if (!ReadInflateBits(State, 3, &CodeLength))
+			{
+				return false;
+			}
+			CodeLengths[CODE_LENGTHS_ORDER[i]] = uint8_t(CodeLength);
+		}
+
+		HUFFMANTABLE CodeLengthsTable;
+		if (!BuildHuffmanTable(CodeLengths, 19, &CodeLengthsTable))
+		{
+			return false;
+		}
+
+		int Index = 0;
+		while (Index < LiteralsCount + DistancesCount)
+		{
+			int Symbol = 0;
+			uint32_t Repeat = 0;
+			uint8_t RepeatedLength = 0;
+			if (!DecodeHuffmanSymbol(State, CodeLengthsTable, &Symbol))
+			{
+				return false;
+			}
+
+			if (Symbol < 16)
+			{
+				Lengths[Index++] = uint8_t(Symbol);
+				continue;
+			}
+			if (Symbol == 16)
+			{
+				// Repeat the previous length 3 to 6 times
+				if (Index == 0 || !ReadInflateBits(State, 2, &Repeat))
+				{
+					return false;
+				}
+				RepeatedLength = Lengths[Index - 1];
+				Repeat += 3;
+			}
+			else if (Symbol == 17)
+			{
+				// Repeat a zero length 3 to 10 times
+				if (!ReadInflateBits(State, 3, &Repeat))
+				{
+					return false;
+				}
+				Repeat += 3;
+			}
+			else
+			{
+				// Repeat a zero length 11 to 138 times
+				if (!ReadInflateBits(State, 7, &Repeat))
+				{
+					return false;
+				}
+				Repeat += 11;
+			}
+
+			if (Index + int(Repeat) > LiteralsCount + DistancesCount)
+			{
+				return false;
+			}
+			std::fill(Lengths + Index, Lengths + Index + Repeat, RepeatedLength);
+			Index += int(Repeat);
+		}
+
+		// The end of block code is needed
+		if (Lengths[256] == 0)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return BuildHuffmanTable(Lengths, LiteralsCount, &State->literals)
+		&& BuildHuffmanTable(Lengths + LiteralsCount, DistancesCount, &State->distances);
+}
+
+/**
+ * Decompress the next bytes of the datas of a PNG picture.
+ * The decompression stops as soon as the requested bytes are produced, and continues at the next call.
+ *
+ * @param State the state of the decompression.
+ * @param Output the decompressed bytes.
+ * @param Count the number of bytes to decompress.
+ * @return True if all the requested bytes were decompressed.
+ */
+bool MouseCursorSizeHelper::Inflate(INFLATESTATE* State, uint8_t* Output, const size_t& Count)
+{
+	static const uint16_t LENGTH_BASES[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t LENGTH_EXTRA_BITS[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t DISTANCE_BASES[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t DISTANCE_EXTRA_BITS[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	constexpr size_t WINDOW_MASK = INFLATE_WINDOW_SIZE - 1;
+
+	size_t Produced = 0;
+	bool IsValid = true;
+
+	auto EmitByte = [&](const uint8_t& Byte) {
+		Output[Produced++] = Byte;
+		State->window[State->outputCount & WINDOW_MASK] = Byte;
+		State->outputCount++;
+	};
+
+	while (IsValid && Produced < Count)
+	{
+		if (State->matchRemaining > 0)
+		{
+			EmitByte(State->window[(State->outputCount - State->matchDistance) & WINDOW_MASK]);
+			State->matchRemaining--;
+		}
+		else if (!State->isInBlock)
+		{
+			IsValid = !State->isFinalBlock && ReadInflateBlockHeader(State);
+		}
+		else if (State->blockType == 0)
+		{
+			uint32_t Byte = 0;
+			if (State->storedRemaining == 0)
+			{
+				State->isInBlock = false;
+			}
+			else if ((IsValid = ReadInflateBits(State, 8, &Byte)))
+			{
+				EmitByte(uint8_t(Byte));
+				State->storedRemaining--;
+			}
+		}
+		else
+		{
+			int Symbol = 0;
+			IsValid = DecodeHuffmanSymbol(State, State->literals, &Symbol);
+
+			if (!IsValid)
+			{
+				break;
+			}
+			if (Symbol < 256)
+			{
+				EmitByte(uint8_t(Symbol));
+			}
+			else if (Symbol == 256)
+			{
+				State->isInBlock = false;
+			}
+			else
+			{
+				// A match copies previous bytes of the window
+				int LengthIndex = Symbol - 257;
+				int DistanceSymbol = 0;
+				uint32_t LengthExtra = 0;
+				uint32_t DistanceExtra = 0;
+				IsValid = LengthIndex < 29 && ReadInflateBits(State, LENGTH_EXTRA_BITS[LengthIndex], &LengthExtra)
+					&& DecodeHuffmanSymbol(State, State->distances, &DistanceSymbol) && DistanceSymbol < 30
+					&& ReadInflateBits(State, DISTANCE_EXTRA_BITS[DistanceSymbol], &DistanceExtra);
+
+				if (IsValid)
+				{
+					State->matchRemaining = LENGTH_BASES[LengthIndex] + LengthExtra;
+					State->matchDistance = DISTANCE_BASES[DistanceSymbol] + DistanceExtra;
+					IsValid = State->matchDistance <= State->outputCount;
+				}
+			}
+		}
+	}
+
+	return IsValid;
+}
+
+/**
+ * Map a file in memory in read only mode.
+ * If the file can't be mapped, it is read into a buffer instead.
+ *
+ * @param Path the path of the file to map.
+ * @param File the mapped file, to close with CloseMappedFile.
+ * @return True if the datas of the file are available.
+ */
+bool MouseCursorSizeHelper::OpenMappedFile(const std::string& Path, MAPPEDFILE* File)
+{
+	TRACESPAN Span(TRACE_EVENT_OPEN_FILE);
+	File->view.data = nullptr;
+	File->view.size = 0;
+	File->isMapped = false;
+	File->fileHandle = nullptr;
+	File->mappingHandle = nullptr;
+
+#ifdef _WIN32
+	HANDLE FileHandle = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER FileSize;
+		HANDLE MappingHandle = NULL;
+		if (GetFileSizeEx(FileHandle, &FileSize) && FileSize.QuadPart > 0)
+		{
+			MappingHandle = CreateFileMappingA(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		}
+
+		const void* Datas = MappingHandle != NULL ? MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (Datas != NULL)
+		{
+			File->view.data = static_cast<const uint8_t*>(Datas);
+			File->view.size = size_t(FileSize.QuadPart);
+			File->isMapped = true;
+			File->fileHandle = FileHandle;
+			File->mappingHandle = MappingHandle;
+			Span.bytes = File->view.size;
+			return true;
+		}
+
+		if (MappingHandle != NULL)
+		{
+			CloseHandle(MappingHandle);
+		}
+		CloseHandle(FileHandle);
+	}
+#else
+	int FileDescriptor = open(Path.c_str(), O_RDONLY);
+	if (FileDescriptor >= 0)
+	{
+		struct stat FileStatus;
+		void* Datas = MAP_FAILED;
+		if (fstat(FileDescriptor, &FileStatus) == 0 && FileStatus.st_size > 0)
+		{
+			Datas = mmap(nullptr, size_t(FileStatus.st_size), PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+		}
+
+		// The mapping stays valid after closing the file descriptor
+		close(FileDescriptor);
+
+		if (Datas != MAP_FAILED)
+		{
+			File->view.data = static_cast<const uint8_t*>(Datas);
+			File->view.size = size_t(FileStatus.st_size);
+			File->isMapped = true;
+			Span.bytes = File->view.size;
+			return true;
+		}
+	}
+#endif // _WIN32
+
+	// Fallback: read the whole file into a buffer
+	std::ifstream Stream(Path, std::ios::binary | std::ios::ate);
+	if (!Stream.fail() && Stream.is_open())
+	{
+		std::streamoff FileSize = Stream.tellg();
+		if (FileSize > 0)
+		{
+			File->buffer.resize(size_t(FileSize));
+			Stream.seekg(0, std::ios::beg);
+			if (Stream.read(reinterpret_cast<char*>(File->buffer.data()), FileSize))
+			{
+				File->view.data = File->buffer.data();
+				File->view.size = File->buffer.size();
+				Span.bytes = File->view.size;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Release a file opened with OpenMappedFile.
+ *
+ * @param File the mapped file to close.
+ */
+void MouseCursorSizeHelper::CloseMappedFile(MAPPEDFILE* File)
+{
+	if (File->isMapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(File->view.data);
+		CloseHandle(File->mappingHandle);
+		CloseHandle(File->fileHandle);
+#else
+		munmap(const_cast<uint8_t*>(File->view.data), File->view.size);
+#endif // _WIN32
+	}
+
+	File->buffer.clear();
+	File->view.data = nullptr;
+	File->view.size = 0;
+	File->isMapped = false;
+}
+
+/**
+ * Get a bounds checked view on a part of another view.
+ *
+ * @param View the view containing the part.
+ * @param Offset the offset of the part in the view.
+ * @param Size the size of the part.
+ * @param SubView the view of the part.
+ * @return True if the part is entirely contained in the view.
+ */
+bool MouseCursorSizeHelper::GetSubView(const BYTEVIEW& View, const size_t& Offset, const size_t& Size, BYTEVIEW* SubView)
+{
+	bool IsInView = Offset <= View.size && Size <= View.size - Offset;
+
+	if (IsInView)
+	{
+		SubView->data = View.data + Offset;
+		SubView->size = Size;
+	}
+
+	return IsInView;
+}
+
+/**
+ * Read the header of a cursor file.
+ *
+ * @param File the view of the whole cursor file.
+ * @param Header the header read.
+ * @return True if the file is big enough to contain the header.
+ */
+bool MouseCursorSizeHelper::ReadIconDir(const BYTEVIEW& File, ICONDIR* Header)
+{
+	BYTEVIEW Record;
+	bool IsRead = GetSubView(File, 0, sizeof(ICONDIR), &Record);
+
+	if (IsRead)
+	{
+		Header->idReserved = ReadUInt16(Record.data);
+		Header->idType = ReadUInt16(Record.data + 2);
+		Header->idCount = ReadUInt16(Record.data + 4);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Read an entry of the array of pictures of a cursor file.
+ *
+ * @param Directory the view of the array of pictures.
+ * @param Index the index of the entry to read.
+ * @param Entry the entry read.
+ * @return True if the entry is contained in the array.
+ */
+bool MouseCursorSizeHelper::ReadIconDirEntry(const BYTEVIEW& Directory, const int& Index, ICONDIRENTRY* Entry)
+{
+	BYTEVIEW Record;
+	bool IsRead = Index >= 0 && GetSubView(Directory, size_t(Index) * sizeof(ICONDIRENTRY), sizeof(ICONDIRENTRY), &Record);
+
+	if (IsRead)
+	{
+		Entry->bWidth = Record.data[0];
+		Entry->bHeight = Record.data[1];
+		Entry->bColorCount = Record.data[2];
+		Entry->bReserved = Record.data[3];
+		Entry->wPlanes = ReadUInt16(Record.data + 4);
+		Entry->wBitCount = ReadUInt16(Record.data + 6);
+		Entry->dwBytesInRes = ReadUInt32(Record.data + 8);
+		Entry->dwImageOffset = ReadUInt32(Record.data + 12);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Read the bitmap header of a picture of a cursor file.
+ *
+ * @param Image the view of the picture datas in the cursor file.
+ * @param BmpHeader the bitmap header read.
+ * @return True if the picture is big enough to contain the bitmap header.
+ */
+bool MouseCursorSizeHelper::ReadBitmapInfoHeader(const BYTEVIEW& Image, BITMAPINFOHEADER* BmpHeader)
+{
+	BYTEVIEW Record;
+	bool IsRead = GetSubView(Image, 0, sizeof(BITMAPINFOHEADER), &Record) && ReadUInt32(Record.data) >= sizeof(BITMAPINFOHEADER);
+
+	if (IsRead)
+	{
+		BmpHeader->biSize = ReadUInt32(Record.data);
+		BmpHeader->biWidth = int32_t(ReadUInt32(Record.data + 4));
+		BmpHeader->biHeight = int32_t(ReadUInt32(Record.data + 8));
+		BmpHeader->biPlanes = ReadUInt16(Record.data + 12);
+		BmpHeader->biBitCount = ReadUInt16(Record.data + 14);
+		BmpHeader->biCompression = ReadUInt32(Record.data + 16);
+		BmpHeader->biSizeImage = ReadUInt32(Record.data + 20);
+		BmpHeader->biXPelsPerMeter = int32_t(ReadUInt32(Record.data + 24));
+		BmpHeader->biYPelsPerMeter = int32_t(ReadUInt32(Record.data + 28));
+		BmpHeader->biClrUsed = ReadUInt32(Record.data + 32);
+		BmpHeader->biClrImportant = ReadUInt32(Record.data + 36);
+	}
+
+	return IsRead;
+}
+
+/**
+ * Compute the mouse cursor size from its image pixels array.
+ *
+ * @param PixelArray the pixels array of the mouse cursor image.
+ * @param SizeData the size informations.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromPixelArray(const std::vector<uint32_t>& PixelArray, const SIZEDATA& SizeData)
+{
+	std::pair<float, float> CursorSize = std::pair<float, float>(DEFAULT_ORIGIN_MOUSE_WIDTH, DEFAULT_ORIGIN_MOUSE_HEIGHT);
+
+	if (!PixelArray.empty())
+	{
+		CursorSize = ComputeCursorSizeFromLines(reinterpret_cast<const uint8_t*>(PixelArray.data()), nullptr, 0, SizeData);
+	}
+
+	return CursorSize;
+}
+
+/**
+ * Compute the mouse cursor size from the views on its picture in the cursor file.
+ * The mask is applied while the pixels are scanned, in a single pass.
+ *
+ * @param Frame the views on the pixels and on the mask of the picture.
+ * @param SizeData the size informations.
+ * @param Workspace the buffers used to decode a PNG picture.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromFrame(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace)
+{
+	TRACESPAN Span(TRACE_EVENT_SCAN);
+	Span.bytes = Frame.pixels.size + Frame.mask.size + Frame.png.size;
+	STATS_COUNT(framesDecoded, 1);
+
+	if (Frame.png.size != 0)
+	{
+		return ComputeCursorSizeFromPng(Frame, SizeData, Workspace);
+	}
+	if (Frame.bitCount != 32)
+	{
+		return ComputeCursorSizeFromLowDepthFrame(Frame, SizeData);
+	}
+
+	return ComputeCursorSizeFromLines(Frame.pixels.data, Frame.mask.data, Frame.maskStride, SizeData);
+}
+
+/**
+ * Compute the mouse cursor size from the lines of its picture.
+ * The lines are read from top to bottom, whatever their order in memory.
+ *
+ * @param Pixels the pixels of the picture (4 bytes per pixel, alpha in the last one).
+ * @param Mask the AND mask of the picture (1 bit per pixel), nullptr if there is none.
+ * @param MaskStride the number of bytes of a line of the mask.
+ * @param SizeData the size informations.
+ * @return The computed original real size of mouse cursor (without scales).
+ */
+std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromLines(const uint8_t* Pixels, const uint8_t* Mask, const size_t& MaskStride, const SIZEDATA& SizeData)
+{
+	static const LINESCANFUNCTION ScanLine = GetLineScanFunction();
+	FIRSTLASTINDEXES FirstLastIndexes = InitFirstLastIndexesStruct();
+	float Width = 0;
+	float Height = 0;
+	bool IsMaskConsistent = Mask != nullptr;
+
+	// Compute the first and last indexes from the valid pixels
+	for (int y = 0; y < SizeData.height; y++) {
+		int FirstIndex = 0;
+		int LastIndex = 0;
+		int LineIndex = SizeData.isBottomUp ? SizeData.height - 1 - y : y;
+		const uint8_t* Line = Pixels + size_t(LineIndex) * SizeData.width * BYTES_PER_PIXEL;
+		const uint8_t* MaskLine = Mask != nullptr ? Mask + LineIndex * MaskStride : nullptr;
+		bool IsFound = IsMaskConsistent
+			? ScanLineFromMask(Line, MaskLine, SizeData.width, &FirstIndex, &LastIndex, &IsMaskConsistent)
+			: ScanLine(Line, MaskLine, SizeData.width, &FirstIndex, &LastIndex);
+
+		if (IsFound)
+		{
+			GetFirstAndLastIndexesFromLine(FirstIndex, LastIndex, &FirstLastIndexes, y);
+		}
+
+		// Compute valid width of the line
+		float LineWidth = float(FirstLastIndexes.lastIndexWidth - FirstLastIndexes.firstIndexWidth + 1);
+		if (Width < LineWidth)
+		{
+			Width = LineWidth;
+		}
+	}
+
+	// Compute valid Height
+	Height = float(FirstLastIndexes.lastIndexHeight - FirstLastIndexes.firstIndexHeight + 1);
+
+	return std::pair<float, float>(Width, Height);
+}
+
+/**
+ * Get the first and last valid pixels of a line, reading the mask first.
+ * The mask gives the first and last unmasked pixels. If both of them have a non zero alpha, they are
+ * also the first and last valid pixels and the colors of the other pixels are not read. Otherwise, the
+ * whole line is scanned with its alpha channel, and the mask is reported as inconsistent so that the
+ * next lines of the picture are directly scanned with their alpha channel.
+ *
+ * @param Line the pixels of the line (4 bytes per pixel, alpha in the last one).
+ * @param MaskLine the AND mask of the line (1 bit per pixel).
+ * @param Width the number of pixels of the line.
+ * @param FirstIndex the index of the first valid pixel.
+ * @param LastIndex the index of the last valid pixel.
+ * @param IsMaskConsistent set to false if the mask does not match the alpha channel of the line.
+ * @return True if the line has a valid pixel.
+ */
+bool MouseCursorSizeHelper::ScanLineFromMask(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex, bool* IsMaskConsistent)
+{
+	static const LINESCANFUNCTION ScanLine = GetLineScanFunction();
+	bool IsFound = ScanMaskLine(MaskLine, nullptr, 0, 0, Width, FirstIndex, LastIndex);
+
+	if (IsFound && (Line[size_t(*FirstIndex) * BYTES_PER_PIXEL + 3] == 0 || Line[size_t(*LastIndex) * BYTES_PER_PIXEL + 3] == 0))
+	{
+		IsFound = ScanLine(Line, MaskLine, Width, FirstIndex, LastIndex);
+		*IsMaskConsistent = false;
+	}
+
+	return IsFound;
+}
+
+/**
+ * Get the first and last unmasked pixels of a line of the AND mask. For a monochrome picture, the
+ * masked pixels with a colored palette index are covered too.
+ * The mask is inverted and scanned 32 pixels at a time from both ends, with bit scans.
+ *
+ * @param MaskLine the AND mask of the line (1 bit per pixel, a line is a whole number of 32 bits words).
+ * @param ColorLine the palette indexes of a monochrome line (1 bit per pixel), nullptr to only read the mask.
+ * @param ColoredOnes all bits set if the palette index 1 is colored.
+ * @param ColoredZeros all bits set if the palette index 0 is colored.
+ * @param Width the number of pixels of the line.
+ * @param FirstIndex the index of the first covered pixel.
+ * @param LastIndex the index of the last covered pixel.
+ * @return True if the line has a covered pixel.
+ */
+bool MouseCursorSizeHelper::ScanMaskLine(const uint8_t* MaskLine, const uint8_t* ColorLine, const uint32_t& ColoredOnes, const uint32_t& ColoredZeros, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	int WordsCount = (Width + 31) / 32;
+	int First = 0;
+	uint32_t FirstCoverage = 0;
+
+	while (First < WordsCount && (FirstCoverage = GetMaskWordCoverage(MaskLine, ColorLine, ColoredOnes, ColoredZeros, Width, First)) == 0)
+	{
+		First++;
+	}
+
+	bool IsFound = First < WordsCount;
+	if (IsFound)
+	{
+		int Last = WordsCount - 1;
+		uint32_t LastCoverage = FirstCoverage;
+		while (Last > First && (LastCoverage = GetMaskWordCoverage(MaskLine, ColorLine, ColoredOnes, ColoredZeros, Width, Last)) == 0)
+		{
+			Last--;
+		}
+		if (Last == First)
+		{
+			LastCoverage = FirstCoverage;
+		}
+
+		// The first pixel of a word is its highest bit
+		*FirstIndex = First * 32 + CountLeadingZeros(FirstCoverage);
+		*LastIndex = Last * 32 + 31 - CountTrailingZeros(LastCoverage);
+	}
+
+	return IsFound;
+}
+
+/**
+ * Get the covered pixels of 32 consecutive pixels of a line of the AND mask.
+ *
+ * @param MaskLine the AND mask of the line (1 bit per pixel).
+ * @param ColorLine the palette indexes of a monochrome line (1 bit per pixel), nullptr to only read the mask.
+ * @param ColoredOnes all bits set if the palette index 1 is colored.
+ * @param ColoredZeros all bits set if the palette index 0 is colored.
+ * @param Width the number of pixels of the line.
+ * @param WordIndex the index of the group of 32 pixels in the line.
+ * @return The bits 31 - i set if the pixel 32 * WordIndex + i is covered.
+ */
+uint32_t MouseCursorSizeHelper::GetMaskWordCoverage(const uint8_t* MaskLine, const uint8_t* ColorLine, const uint32_t& ColoredOnes, const uint32_t& ColoredZeros, const int& Width, const int& WordIndex)
+{
+	// The first pixel is the highest bit of the first byte
+	uint32_t Coverage = ~ReadUInt32BigEndian(MaskLine + size_t(WordIndex) * 4);
+
+	if (ColorLine != nullptr)
+	{
+		uint32_t Indexes = ReadUInt32BigEndian(ColorLine + size_t(WordIndex) * 4);
+		Coverage |= (Indexes & ColoredOnes) | (~Indexes & ColoredZeros);
+	}
+
+	// The bits after the end of the line are padding
+	int PixelsCount = Width - WordIndex * 32;
+	if (PixelsCount < 32)
+	{
+		Coverage &= ~(~uint32_t(0) >> PixelsCount);
+	}
+
+	return Coverage;
+}
+
+/**
+ * Get the fastest line scan function supported by the processor.
+ *
+ * @return The line scan function to use.
+ */
+MouseCursorSizeHelper::LINESCANFUNCTION MouseCursorSizeHelper::GetLineScanFunction()
+{
+	LINESCANFUNCTION ScanLine = ScanLineScalar;
+
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
+	ScanLine = IsAvx2Supported() ? ScanLineAvx2 : ScanLineSse2;
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+	ScanLine = ScanLineNeon;
+#endif
+
+	return ScanLine;
+}
+
+/**
+ * Build the table of the valid pixels of a mask byte.
+ * In the mask, the bit 7 - i is set if the pixel i is transparent.
+ *
+ * @return The table giving for each mask byte the bits i set if the pixel i is not masked.
+ */
+constexpr std::array<uint8_t, 256> MouseCursorSizeHelper::BuildMaskExpansionTable()
+{
+	std::array<uint8_t, 256> Table = {};
+
+	for (int Byte = 0; Byte < 256; Byte++) {
+		for (int i = 0; i < 8; i++) {
+			if ((Byte & (0x80 >> i)) == 0)
+			{
+				Table[Byte] |= uint8_t(1 << i);
+			}
+		}
+	}
+
+	return Table;
+}
+
+const std::array<uint8_t, 256> MouseCursorSizeHelper::MaskExpansionTable = MouseCursorSizeHelper::BuildMaskExpansionTable();
+
+/**
+ * Check if a pixel is valid: not 100% transparent and not masked.
+ *
+ * @param Line the pixels of the line.
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param IndexX the index of the pixel in the line.
+ * @return True if the pixel is valid.
+ */
+bool MouseCursorSizeHelper::IsValidPixel(const uint8_t* Line, const uint8_t* MaskLine, const int& IndexX)
+{
+	bool IsMasked = MaskLine != nullptr && (MaskLine[IndexX / 8] & (0x80 >> (IndexX % 8))) != 0;
+
+	return !IsMasked && Line[size_t(IndexX) * BYTES_PER_PIXEL + 3] != 0;
+}
+
+/**
+ * Get the bits of the pixels of a block of 16 pixels which are not masked.
+ *
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param IndexX the index of the first pixel of the block, a multiple of 16.
+ * @return The bits i set if the pixel i of the block is not masked.
+ */
+uint32_t MouseCursorSizeHelper::GetUnmaskedPixelsBits(const uint8_t* MaskLine, const int& IndexX)
+{
+	uint32_t Bits = 0xFFFF;
+
+	if (MaskLine != nullptr)
+	{
+		Bits = MaskExpansionTable[MaskLine[IndexX / 8]] | (uint32_t(MaskExpansionTable[MaskLine[IndexX / 8 + 1]]) << 8);
+	}
+
+	return Bits;
+}
+
+/**
+ * Get the indexes of the first and last valid pixels of a line.
+ * A pixel is valid when it is not 100% transparent and not masked.
+ *
+ * @param Line the pixels of the line.
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param Width the number of pixels in the line.
+ * @param FirstIndex the index of the first valid pixel.
+ * @param LastIndex the index of the last valid pixel.
+ * @return True if the line contains a valid pixel.
+ */
+bool MouseCursorSizeHelper::ScanLineScalar(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	int First = 0;
+	while (First < Width && !IsValidPixel(Line, MaskLine, First))
+	{
+		First++;
+	}
+
+	if (First == Width)
+	{
+		return false;
+	}
+
+	int Last = Width - 1;
+	while (!IsValidPixel(Line, MaskLine, Last))
+	{
+		Last--;
+	}
+
+	*FirstIndex = First;
+	*LastIndex = Last;
+	return true;
+}
+
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
+
+/**
+ * Check if the processor and the system support AVX2 instructions.
+ *
+ * @return True if AVX2 instructions can be used.
+ */
+bool MouseCursorSizeHelper::IsAvx2Supported()
+{
+#if defined(_MSC_VER)
+	int CpuInfo[4];
+	__cpuid(CpuInfo, 0);
+	if (CpuInfo[0] < 7)
+	{
+		return false;
+	}
+
+	// The OS must save the AVX registers (OSXSAVE and XCR0 bits)
+	__cpuid(CpuInfo, 1);
+	bool IsAvxEnabled = (CpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+	__cpuidex(CpuInfo, 7, 0);
+	return IsAvxEnabled && (CpuInfo[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif // _MSC_VER
+}
+
+/**
+ * Get the mask of the pixels which are not 100% transparent in a block of 16 pixels, with SSE2.
+ *
+ * @param Pixels the 16 pixels of the block.
+ * @return The mask with the bit i set if the pixel i is not 100% transparent.
+ */
+MOUSE_CURSOR_SIZE_HELPER_TARGET("sse2")
+uint32_t MouseCursorSizeHelper::GetValidPixelsMaskSse2(const uint8_t* Pixels)
+{
+	const __m128i AlphaMask = _mm_set1_epi32(int(0xFF000000));
+	const __m128i Zero = _mm_setzero_si128();
+
+	__m128i Transparent0 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels)), AlphaMask), Zero);
+	__m128i Transparent1 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels + 16)), AlphaMask), Zero);
+	__m128i Transparent2 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels + 32)), AlphaMask), Zero);
+	__m128i Transparent3 = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels + 48)), AlphaMask), Zero);
+
+	// Pack the 16 comparison results to bytes to get them with one movemask
+	__m128i Transparent = _mm_packs_epi16(_mm_packs_epi32(Transparent0, Transparent1), _mm_packs_epi32(Transparent2, Transparent3));
+
+	return uint32_t(~_mm_movemask_epi8(Transparent)) & 0xFFFF;
+}
+
+/**
+ * Get the indexes of the first and last valid pixels of a line, with SSE2.
+ * The alpha bytes of 16 pixels are tested at once.
+ *
+ * @param Line the pixels of the line.
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param Width the number of pixels in the line.
+ * @param FirstIndex the index of the first valid pixel.
+ * @param LastIndex the index of the last valid pixel.
+ * @return True if the line contains a valid pixel.
+ */
+MOUSE_CURSOR_SIZE_HELPER_TARGET("sse2")
+bool MouseCursorSizeHelper::ScanLineSse2(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	const int BlocksEnd = Width & ~15;
+
+	int First = -1;
+	for (int x = 0; x < BlocksEnd && First < 0; x += 16)
+	{
+		uint32_t Mask = GetValidPixelsMaskSse2(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsBits(MaskLine, x);
+		if (Mask != 0)
+		{
+			First = x + CountTrailingZeros(Mask);
+		}
+	}
+
+	// Scan the remaining pixels which don't fill a block
+	int Last = -1;
+	for (int x = Width - 1; x >= BlocksEnd && Last < 0; x--)
+	{
+		if (IsValidPixel(Line, MaskLine, x))
+		{
+			Last = x;
+		}
+	}
+
+	if (First < 0)
+	{
+		if (Last < 0)
+		{
+			return false;
+		}
+		for (First = BlocksEnd; !IsValidPixel(Line, MaskLine, First); First++);
+	}
+
+	for (int x = BlocksEnd - 16; x >= 0 && Last < 0; x -= 16)
+	{
+		uint32_t Mask = GetValidPixelsMaskSse2(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsBits(MaskLine, x);
+		if (Mask != 0)
+		{
+			Last = x + 31 - CountLeadingZeros(Mask);
+		}
+	}
+
+	*FirstIndex = First;
+	*LastIndex = Last;
+	return true;
+}
+
+/**
+ * Get the mask of the pixels which are not 100% transparent in a block of 16 pixels, with AVX2.
+ *
+ * @param Pixels the 16 pixels of the block.
+ * @return The mask with the bit i set if the pixel i is not 100% transparent.
+ */
+MOUSE_CURSOR_SIZE_HELPER_TARGET("avx2")
+uint32_t MouseCursorSizeHelper::GetValidPixelsMaskAvx2(const uint8_t* Pixels)
+{
+	const __m256i AlphaMask = _mm256_set1_epi32(int(0xFF000000));
+	const __m256i Zero = _mm256_setzero_si256();
+
+	__m256i Transparent0 = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Pixels)), AlphaMask), Zero);
+	__m256i Transparent1 = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Pixels + 32)), AlphaMask), Zero);
+
+	uint32_t Transparent = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(Transparent0)))
+		| (uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(Transparent1))) << 8);
+
+	return ~Transparent & 0xFFFF;
+}
+
+/**
+ * Get the indexes of the first and last valid pixels of a line, with AVX2.
+ * The alpha bytes of 16 pixels are tested at once.
+ *
+ * @param Line the pixels of the line.
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param Width the number of pixels in the line.
+ * @param FirstIndex the index of the first valid pixel.
+ * @param LastIndex the index of the last valid pixel.
+ * @return True if the line contains a valid pixel.
+ */
+MOUSE_CURSOR_SIZE_HELPER_TARGET("avx2")
+bool MouseCursorSizeHelper::ScanLineAvx2(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	const int BlocksEnd = Width & ~15;
+
+	int First = -1;
+	for (int x = 0; x < BlocksEnd && First < 0; x += 16)
+	{
+		uint32_t Mask = GetValidPixelsMaskAvx2(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsBits(MaskLine, x);
+		if (Mask != 0)
+		{
+			First = x + CountTrailingZeros(Mask);
+		}
+	}
+
+	// Scan the remaining pixels which don't fill a block
+	int Last = -1;
+	for (int x = Width - 1; x >= BlocksEnd && Last < 0; x--)
+	{
+		if (IsValidPixel(Line, MaskLine, x))
+		{
+			Last = x;
+		}
+	}
+
+	if (First < 0)
+	{
+		if (Last < 0)
+		{
+			return false;
+		}
+		for (First = BlocksEnd; !IsValidPixel(Line, MaskLine, First); First++);
+	}
+
+	for (int x = BlocksEnd - 16; x >= 0 && Last < 0; x -= 16)
+	{
+		uint32_t Mask = GetValidPixelsMaskAvx2(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsBits(MaskLine, x);
+		if (Mask != 0)
+		{
+			Last = x + 31 - CountLeadingZeros(Mask);
+		}
+	}
+
+	*FirstIndex = First;
+	*LastIndex = Last;
+	return true;
+}
+
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+
+/**
+ * Build the table of the valid pixels of a mask byte, with 4 bits per pixel.
+ * In the mask, the bit 7 - i is set if the pixel i is transparent.
+ *
+ * @return The table giving for each mask byte the bits 4 * i to 4 * i + 3 set if the pixel i is not masked.
+ */
+constexpr std::array<uint32_t, 256> MouseCursorSizeHelper::BuildMaskNibblesExpansionTable()
+{
+	std::array<uint32_t, 256> Table = {};
+
+	for (int Byte = 0; Byte < 256; Byte++) {
+		for (int i = 0; i < 8; i++) {
+			if ((Byte & (0x80 >> i)) == 0)
+			{
+				Table[Byte] |= uint32_t(0xF) << (4 * i);
+			}
+		}
+	}
+
+	return Table;
+}
+
+const std::array<uint32_t, 256> MouseCursorSizeHelper::MaskNibblesExpansionTable = MouseCursorSizeHelper::BuildMaskNibblesExpansionTable();
+
+/**
+ * Get the nibbles of the pixels of a block of 16 pixels which are not masked.
+ *
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param IndexX the index of the first pixel of the block, a multiple of 16.
+ * @return The bits 4 * i to 4 * i + 3 set if the pixel i of the block is not masked.
+ */
+uint64_t MouseCursorSizeHelper::GetUnmaskedPixelsNibbles(const uint8_t* MaskLine, const int& IndexX)
+{
+	uint64_t Nibbles = 0xFFFFFFFFFFFFFFFF;
+
+	if (MaskLine != nullptr)
+	{
+		Nibbles = MaskNibblesExpansionTable[MaskLine[IndexX / 8]] | (uint64_t(MaskNibblesExpansionTable[MaskLine[IndexX / 8 + 1]]) << 32);
+	}
+
+	return Nibbles;
+}
+
+/**
+ * Get the mask of the pixels which are not 100% transparent in a block of 16 pixels, with NEON.
+ *
+ * @param Pixels the 16 pixels of the block.
+ * @return The mask with the bits 4 * i to 4 * i + 3 set if the pixel i is not 100% transparent.
+ */
+uint64_t MouseCursorSizeHelper::GetValidPixelsMaskNeon(const uint8_t* Pixels)
+{
+	const uint32x4_t AlphaMask = vdupq_n_u32(0xFF000000);
+
+	uint32x4_t Pixels0 = vreinterpretq_u32_u8(vld1q_u8(Pixels));
+	uint32x4_t Pixels1 = vreinterpretq_u32_u8(vld1q_u8(Pixels + 16));
+	uint32x4_t Pixels2 = vreinterpretq_u32_u8(vld1q_u8(Pixels + 32));
+	uint32x4_t Pixels3 = vreinterpretq_u32_u8(vld1q_u8(Pixels + 48));
+
+	uint16x8_t Valid01 = vcombine_u16(vmovn_u32(vtstq_u32(Pixels0, AlphaMask)), vmovn_u32(vtstq_u32(Pixels1, AlphaMask)));
+	uint16x8_t Valid23 = vcombine_u16(vmovn_u32(vtstq_u32(Pixels2, AlphaMask)), vmovn_u32(vtstq_u32(Pixels3, AlphaMask)));
+	uint8x16_t Valid = vcombine_u8(vmovn_u16(Valid01), vmovn_u16(Valid23));
+
+	// NEON has no movemask, shift and narrow the bytes to get one nibble per pixel
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(Valid), 4)), 0);
+}
+
+/**
+ * Get the indexes of the first and last valid pixels of a line, with NEON.
+ * The alpha bytes of 16 pixels are tested at once.
+ *
+ * @param Line the pixels of the line.
+ * @param MaskLine the AND mask of the line, nullptr if there is none.
+ * @param Width the number of pixels in the line.
+ * @param FirstIndex the index of the first valid pixel.
+ * @param LastIndex the index of the last valid pixel.
+ * @return True if the line contains a valid pixel.
+ */
+bool MouseCursorSizeHelper::ScanLineNeon(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex)
+{
+	const int BlocksEnd = Width & ~15;
+
+	int First = -1;
+	for (int x = 0; x < BlocksEnd && First < 0; x += 16)
+	{
+		uint64_t Mask = GetValidPixelsMaskNeon(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsNibbles(MaskLine, x);
+		if (Mask != 0)
+		{
+			First = x + CountTrailingZeros64(Mask) / 4;
+		}
+	}
+
+	// Scan the remaining pixels which don't fill a block
+	int Last = -1;
+	for (int x = Width - 1; x >= BlocksEnd && Last < 0; x--)
+	{
+		if (IsValidPixel(Line, MaskLine, x))
+		{
+			Last = x;
+		}
+	}
+
+	if (First < 0)
+	{
+		if (Last < 0)
+		{
+			return false;
+		}
+		for (First = BlocksEnd; !IsValidPixel(Line, MaskLine, First); First++);
+	}
+
+	for (int x = BlocksEnd - 16; x >= 0 && Last < 0; x -= 16)
+	{
+		uint64_t Mask = GetValidPixelsMaskNeon(Line + x * BYTES_PER_PIXEL) & GetUnmaskedPixelsNibbles(MaskLine, x);
+		if (Mask != 0)
+		{
+			Last = x + 15 - CountLeadingZeros64(Mask) / 4;
+		}
+	}
+
+	*FirstIndex = First;
+	*LastIndex = Last;
+	return true;
+}
+
+#endif // MOUSE_CURSOR_SIZE_HELPER_X86
+
+/**
+ * Count the number of zero bits after the lowest set bit.
+ *
+ * @param Value the value to scan, must not be 0.
+ * @return The index of the lowest set bit.
+ */
+int MouseCursorSizeHelper::CountTrailingZeros(const uint32_t& Value)
+{
+#if defined(_MSC_VER)
+	unsigned long Index;
+	_BitScanForward(&Index, Value);
+	return int(Index);
+#else
+	return __builtin_ctz(Value);
+#endif // _MSC_VER
+}
+
+/**
+ * Count the number of zero bits before the highest set bit.
+ *
+ * @param Value the value to scan, must not be 0.
+ * @return 31 minus the index of the highest set bit.
+ */
+int MouseCursorSizeHelper::CountLeadingZeros(const uint32_t& Value)
+{
+#if defined(_MSC_VER)
+	unsigned long Index;
+	_BitScanReverse(&Index, Value);
+	return 31 - int(Index);
+#else
+	return __builtin_clz(Value);
+#endif // _MSC_VER
+}
+
+/**
+ * Count the number of zero bits after the lowest set bit.
+ *
+ * @param Value the value to scan, must not be 0.
+ * @return The index of the lowest set bit.
+ */
+int MouseCursorSizeHelper::CountTrailingZeros64(const uint64_t& Value)
+{
+#if defined(_MSC_VER)
+	uint32_t LowBits = uint32_t(Value);
+	return LowBits != 0 ? CountTrailingZeros(LowBits) : 32 + CountTrailingZeros(uint32_t(Value >> 32));
+#else
+	return __builtin_ctzll(Value);
+#endif // _MSC_VER
+}
+
+/**
+ * Count the number of zero bits before the highest set bit.
+ *
+ * @param Value the value to scan, must not be 0.
+ * @return 63 minus the index of the highest set bit.
+ */
+int MouseCursorSizeHelper::CountLeadingZeros64(const uint64_t& Value)
+{
+#if defined(_MSC_VER)
+	uint32_t HighBits = uint32_t(Value >> 32);
+	return HighBits != 0 ? CountLeadingZeros(HighBits) : 32 + CountLeadingZeros(uint32_t(Value));
+#else
+	return __builtin_clzll(Value);
+#endif // _MSC_VER
+}
+
+/**
+ * Scale the real mouse cursor size depending on the mouse cursor size multiplier defined on the system.
+ *
+ * @param CursorSize the real mouse cursor size to scale.
+ * @param MouseScale the mouse cursor size multiplier defined on the system.
+ */
+void MouseCursorSizeHelper::ScaleCursorSizeByMouseSystemScale(std::pair<float, float>* CursorSize, const float& MouseScale)
+{
+	CursorSize->first = CursorSize->first + (MouseScale - 1) * (CursorSize->first / 2);
+	CursorSize->second = CursorSize->second + (MouseScale - 1) * (CursorSize->second / 2);
+}
+
+/**
+ * Scale the real mouse cursor size depending on the DPI defined on the system.
+ *
+ * @param CursorSize the real mouse cursor size to scale.
+ * @param DpiScale the DPI scale defined on the system, in percent.
+ */
+void MouseCursorSizeHelper::ScaleCursorSizeByDPI(std::pair<float, float>* CursorSize, const float& DpiScale)
+{
+	float AppliedDPI = DpiScale / 100.0F;
+
+	CursorSize->first *= AppliedDPI;
+	CursorSize->second *= AppliedDPI;
+}
+
+/**
+ * Get the DPI defined for the main monitor of system.
+ *
+ * @return The DPI defined on the system for the main monitor.
+ */
+float MouseCursorSizeHelper::GetDPIScaleOfWindowsSystem()
+{
+	int DpiX = int(DEFAULT_APPLIED_DPI);
+
+#ifdef _WIN32
+
+	// Indicates that the application is DPI aware, once for the whole process
+	static const BOOL IsProcessDPIAware = SetProcessDPIAware();
+	(void)IsProcessDPIAware;
+
+	// Get the device context for the primary display
+	HDC HdcScreen = GetDC(NULL);
+	if (HdcScreen != NULL) {
+		// The pixels are square, so the horizontal DPI is the only DPI scale of the settings
+		DpiX = GetDeviceCaps(HdcScreen, LOGPIXELSX);
+
+		// Free the device context from the primary screen
+		ReleaseDC(NULL, HdcScreen);
+	}
+
+#endif // _WIN32
+
+	return float(DpiX);
+}
+
+/**
+ * Get the DPI defined on the system.
+ *
+ * @return The DPI defined on the system.
+ */
+float MouseCursorSizeHelper::GetDPIScale()
+{
+	float AppliedDPI = GetDPIScaleOfWindowsSystem();
+
+	return float(DPI_FACTOR) * AppliedDPI;
+}
+
+/**
+ * Ceil the pair of float passed as parameter.
+ * For example: {3.44F, 10.12F} become {3.0F, 10.0F}.
+ * 
+ * @param Pair the pair to ceil.
+ */
+void MouseCursorSizeHelper::CeilPair(std::pair<float, float>* Pair)
+{
+	Pair->first = ceil(Pair->first);
+	Pair->second = ceil(Pair->second);
+}
+
+/**
+ * Run tasks on a small pool of threads, the calling thread included.
+ * Each thread takes the next task to run until all of them are done.
+ *
+ * @param Count the number of tasks to run.
+ * @param Task the function running the task of the index passed as parameter.
+ */
+void MouseCursorSizeHelper::RunInParallel(const size_t& Count, const std::function<void(size_t)>& Task)
+{
+	std::atomic<size_t> NextIndex(0);
+	auto RunTasks = [&]() {
+		for (size_t Index = NextIndex++; Index < Count; Index = NextIndex++)
+		{
+			Task(Index);
+		}
+	};
+
+	size_t ThreadsCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), Count);
+	std::vector<std::thread> Threads;
+	for (size_t i = 1; i < ThreadsCount; i++)
+	{
+		Threads.emplace_back(RunTasks);
+	}
+
+	RunTasks();
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
 }
 
 /**
- * Invert the lines order of an array to iinvert its height.
+ * Run a function on blocks of RESAMPLE_ROWS_PER_TASK rows, on a small pool of threads if asked.
  *
- * @param Array the array to be processed.
- * @param SizeData the size informations.
+ * @param RowsCount the number of rows.
+ * @param IsParallel true to run the blocks on several threads.
+ * @param Rows the function processing the rows from its first parameter to its second one (excluded).
  */
-void MouseCursorSizeHelper::InvertArrayHeight(std::vector<uint32_t>* Array, const SIZEDATA& SizeData)
+void MouseCursorSizeHelper::RunRowsInParallel(const int& RowsCount, const bool& IsParallel, const std::function<void(int, int)>& Rows)
 {
-	std::vector<uint32_t> TempArray;
-	TempArray.assign(Array->begin(), Array->end());
-
-	for (int y = 0, yInverted = SizeData.height - 1; y < SizeData.height && yInverted >= 0; y++, yInverted--) {
-		for (int x = 0; x < SizeData.width; x++) {
-			Array->at(size_t(y * SizeData.width + x)) = TempArray[size_t(yInverted * SizeData.width + x)];
-		}
+	if (!IsParallel)
+	{
+		Rows(0, RowsCount);
+		return;
 	}
+
+	size_t TasksCount = size_t((RowsCount + RESAMPLE_ROWS_PER_TASK - 1) / RESAMPLE_ROWS_PER_TASK);
+	RunInParallel(TasksCount, [&](size_t Index) {
+		int FirstRow = int(Index) * RESAMPLE_ROWS_PER_TASK;
+		Rows(FirstRow, std::min(FirstRow + RESAMPLE_ROWS_PER_TASK, RowsCount));
+	});
 }
 
 /**
- * Extract the pixels from the cursor file.
+ * Resample an image to another size, for example to scale a custom cursor to the size of the
+ * system cursor. The filter is separable: the rows are resampled horizontally, then the columns
+ * vertically, with the weights of each destination index computed once for the whole image.
+ * The colors are premultiplied by their alpha while they are filtered.
  *
- * @param File the file of the cursor icon.
- * @param BmpHeader the bitmap header with metadatas of the cursor icon.
- * @param SizeData the size informations.
- * @return The pixel array of the mouse cursor picture.
+ * @param Source the image to resample.
+ * @param Width the width of the resampled image.
+ * @param Height the height of the resampled image.
+ * @param Filter the resampling filter (RESAMPLE_FILTER_BOX, RESAMPLE_FILTER_BILINEAR or RESAMPLE_FILTER_LANCZOS).
+ * @param Destination the resampled image.
+ * @return True if the images and the filter are valid.
  */
-std::vector<uint32_t> MouseCursorSizeHelper::ExtractPixels(std::ifstream& File, const BITMAPINFOHEADER& BmpHeader, SIZEDATA* SizeData)
+bool MouseCursorSizeHelper::ResampleImage(const RGBAIMAGE& Source, const int& Width, const int& Height, const int& Filter, RGBAIMAGE* Destination)
 {
-	std::vector<uint32_t> Pixels = {};
+	if (Source.width <= 0 || Source.height <= 0 || Width <= 0 || Height <= 0
+		|| Source.pixels.size() < size_t(Source.width) * size_t(Source.height) * BYTES_PER_PIXEL
+		|| Filter < RESAMPLE_FILTER_BOX || Filter > RESAMPLE_FILTER_LANCZOS)
+	{
+		return false;
+	}
 
-	// Validate size and format
-	if (BmpHeader.biBitCount == 32 && BmpHeader.biCompression == BI_RGB) {
-		SizeData->width = BmpHeader.biWidth;
-		SizeData->height = abs(BmpHeader.biHeight) / 2; // Half the height is for the mask
-		Pixels.resize(size_t(SizeData->width * SizeData->height));
-
-		// Read the pixels (colors and alpha channel)
-		File.read(reinterpret_cast<char*>(Pixels.data()), Pixels.size() * sizeof(uint32_t));
-
-		// Read the mask (1 byte per pixel)
-		int MaskWidth = ((SizeData->width + 31) / 32) * BYTES_PER_PIXEL; // Width rounded to the nearest multiple of 32 bits
-		std::vector<uint8_t> Mask(MaskWidth * SizeData->height);
-		File.read(reinterpret_cast<char*>(Mask.data()), Mask.size());
-
-		// Combine pixels and mask to set transparency
-		for (int y = 0; y < SizeData->height; y++) {
-			for (int x = 0; x < SizeData->width; x++) {
-				int MaskByteIndex = (y * MaskWidth) + (x / 8);
-				int MaskBitIndex = 7 - (x % 8);
-				bool IsTransparent = (Mask[MaskByteIndex] & (1 << MaskBitIndex)) != 0;
-
-				if (IsTransparent) {
-					Pixels[size_t(y * SizeData->width + x)] = 0; // Completely transparent pixel
+	RESAMPLEWEIGHTS HorizontalWeights;
+	RESAMPLEWEIGHTS VerticalWeights;
+	BuildResampleWeights(Source.width, Width, Filter, &HorizontalWeights);
+	BuildResampleWeights(Source.height, Height, Filter, &VerticalWeights);
+
+	// Each source row resampled horizontally, with premultiplied colors
+	size_t SourceStride = size_t(Source.width) * BYTES_PER_PIXEL;
+	size_t RowSize = size_t(Width) * BYTES_PER_PIXEL;
+	std::vector<float> ResampledRows(size_t(Source.height) * RowSize);
+	bool IsParallel = size_t(Width) * size_t(Height) >= RESAMPLE_PARALLEL_MIN_PIXELS;
+
+	RunRowsInParallel(Source.height, IsParallel, [&](int FirstRow, int EndRow) {
+		std::vector<float> Row(SourceStride);
+		for (int y = FirstRow; y < EndRow; y++)
+		{
+			PremultiplyRow(Source.pixels.data() + size_t(y) * SourceStride, Source.width, Row.data());
+			ResampleRowHorizontally(Row.data(), HorizontalWeights, ResampledRows.data() + size_t(y) * RowSize);
+		}
+	});
+
+	Destination->width = Width;
+	Destination->height = Height;
+	Destination->pixels.resize(size_t(Height) * RowSize);
+
+	RunRowsInParallel(Height, IsParallel, [&](int FirstRow, int EndRow) {
+		std::vector<float> Row(RowSize);
+		for (int y = FirstRow; y < EndRow; y++)
+		{
+			std::fill(Row.begin(), Row.end(), 0.0F);
+			const float* Weights = VerticalWeights.weights.data() + size_t(y) * VerticalWeights.tapsCount;
+			for (int i = 0; i < VerticalWeights.tapsCount; i++)
+			{
+				if (Weights[i] != 0.0F)
+				{
+					AccumulateRow(ResampledRows.data() + size_t(VerticalWeights.starts[y] + i) * RowSize, Weights[i], RowSize, Row.data());
 				}
 			}
+			UnpremultiplyRow(Row.data(), Width, Destination->pixels.data() + size_t(y) * RowSize);
 		}
+	});
 
-		// Invert the height to put the array right side up
-		InvertArrayHeight(&Pixels, *SizeData);
-	}
-
-	return Pixels;
+	return true;
 }
 
 /**
- * Get the datas of the cursor file
+ * Resample an image to the real current mouse cursor size with scales.
  *
- * @param File the file of the cursor icon.
- * @param Header the header with metadatas of the cursor icon.
- * @param SizeData the size informations.
- * @return The pixel array of the mouse cursor picture.
+ * @param Source the image to resample, trimmed to its visible pixels.
+ * @param Filter the resampling filter (RESAMPLE_FILTER_BOX, RESAMPLE_FILTER_BILINEAR or RESAMPLE_FILTER_LANCZOS).
+ * @param Destination the image resampled to the size returned by GetCurrentMouseCursorSize.
+ * @return True if the images and the filter are valid.
  */
-std::vector<uint32_t> MouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, const ICONDIR& Header, SIZEDATA* SizeData)
+bool MouseCursorSizeHelper::ResampleImageToCursorSize(const RGBAIMAGE& Source, const int& Filter, RGBAIMAGE* Destination)
 {
-	std::vector<uint32_t> PixelArray = {};
-
-	// The type of file is a .cur file
-	if (Header.idType == 2)
-	{
-		std::vector<ICONDIRENTRY> Pictures(Header.idCount);
-		File.read(reinterpret_cast<char*>(Pictures.data()), Header.idCount * sizeof(ICONDIRENTRY));
-
-		// Read data for the smallest frame of the file
-		int SmallestFrameIndex = GetIndexOfDesiredFrame(Pictures, SizeData);
-		if (SmallestFrameIndex >= 0 && SmallestFrameIndex < Pictures.size())
-		{
-			ICONDIRENTRY& Entry = Pictures[SmallestFrameIndex];
-			File.seekg(Entry.dwImageOffset, std::ios::beg);
+	std::pair<float, float> CursorSize = GetCurrentMouseCursorSize();
 
-			BITMAPINFOHEADER BmpHeader;
-			File.read(reinterpret_cast<char*>(&BmpHeader), sizeof(BITMAPINFOHEADER));
+	return ResampleImage(Source, int(CursorSize.first), int(CursorSize.second), Filter, Destination);
+}
 
-			PixelArray = ExtractPixels(File, BmpHeader, SizeData);
-		}
+/**
+ * Get the radius of a resampling filter, in source pixels when the image is not reduced.
+ *
+ * @param Filter the resampling filter.
+ * @return The distance beyond which the filter is 0.
+ */
+float MouseCursorSizeHelper::GetResampleFilterRadius(const int& Filter)
+{
+	if (Filter == RESAMPLE_FILTER_BOX)
+	{
+		return 0.5F;
 	}
 
-	return PixelArray;
+	return Filter == RESAMPLE_FILTER_BILINEAR ? 1.0F : RESAMPLE_LANCZOS_RADIUS;
 }
 
 /**
- * Get bits array of mouse cursor image from its BITMAP with Windows library.
+ * Get the value of a resampling filter at a distance from its center.
  *
- * @param SizeData the size informations.
- * @return The pixel array of the mouse cursor picture.
+ * @param Filter the resampling filter.
+ * @param Distance the distance from the center of the filter, in filter units.
+ * @return The weight of a pixel at this distance, before normalization.
  */
-std::vector<uint32_t> MouseCursorSizeHelper::GetPixelArrayOfCurrentMouseImage(SIZEDATA* SizeData)
+float MouseCursorSizeHelper::GetResampleFilterValue(const int& Filter, const float& Distance)
 {
-	std::vector<uint32_t> PixelArray = {};
-	std::string CursorFileName = GetRegistryValueString(REG_CURSOR_SOURCES, REG_KEY_CURSOR_FILE);
-
-	PurifyPath(&CursorFileName);
-	if (!CursorFileName.empty())
+	if (Filter == RESAMPLE_FILTER_BOX)
 	{
-		std::ifstream File(CursorFileName, std::ios::binary);
-
-		if (!File.fail() && File.is_open()) {
-
-			// Read the header (ICONDIR)
-			ICONDIR Header;
-			File.read(reinterpret_cast<char*>(&Header), sizeof(ICONDIR));
+		return Distance >= -0.5F && Distance < 0.5F ? 1.0F : 0.0F;
+	}
 
-			PixelArray = GetCursorFileDatas(File, Header, SizeData);
+	float AbsoluteDistance = std::fabs(Distance);
+	if (Filter == RESAMPLE_FILTER_BILINEAR)
+	{
+		return std::max(1.0F - AbsoluteDistance, 0.0F);
+	}
 
-			File.close();
-		}
+	// Lanczos: sinc(x) * sinc(x / radius) inside the radius
+	if (AbsoluteDistance < 1e-6F)
+	{
+		return 1.0F;
+	}
+	if (AbsoluteDistance >= RESAMPLE_LANCZOS_RADIUS)
+	{
+		return 0.0F;
 	}
 
-	return PixelArray;
+	const float Pi = 3.14159265358979F;
+	float X = Pi * AbsoluteDistance;
+	return RESAMPLE_LANCZOS_RADIUS * std::sin(X) * std::sin(X / RESAMPLE_LANCZOS_RADIUS) / (X * X);
 }
 
 /**
- * Compute the mouse cursor size from its image pixels array.
+ * Compute the weights of the source indexes of each destination index along one axis.
+ * When the image is reduced, the filter is stretched to cover all the source pixels.
+ * Every destination index has the same number of taps, the unused ones having a weight of 0,
+ * and its window of source indexes is kept inside the source.
  *
- * @param PixelArray the pixels array of the mouse cursor image.
- * @param SizeData the size informations.
- * @return The computed original real size of mouse cursor (without scales).
+ * @param SourceSize the number of source pixels along the axis.
+ * @param DestinationSize the number of destination pixels along the axis.
+ * @param Filter the resampling filter.
+ * @param Weights the starts and the normalized weights of each destination index.
  */
-std::pair<float, float> MouseCursorSizeHelper::ComputeCursorSizeFromPixelArray(const std::vector<uint32_t>& PixelArray, const SIZEDATA& SizeData)
+void MouseCursorSizeHelper::BuildResampleWeights(const int& SourceSize, const int& DestinationSize, const int& Filter, RESAMPLEWEIGHTS* Weights)
 {
-	std::pair<float, float> CursorSize = std::pair<float, float>(DEFAULT_ORIGIN_MOUSE_WIDTH, DEFAULT_ORIGIN_MOUSE_HEIGHT);
+	float Scale = float(SourceSize) / float(DestinationSize);
+	float FilterScale = std::max(Scale, 1.0F);
+	float Radius = GetResampleFilterRadius(Filter) * FilterScale;
 
-	if (!PixelArray.empty())
+	// The source pixels covered by the filter of each destination pixel
+	std::vector<int> Firsts(static_cast<size_t>(DestinationSize));
+	std::vector<int> Ends(static_cast<size_t>(DestinationSize));
+	int TapsCount = 1;
+	for (int i = 0; i < DestinationSize; i++)
 	{
-		FIRSTLASTINDEXES FirstLastIndexes = InitFirstLastIndexesStruct();
-		float Width = 0;
-		float Height = 0;
+		float Center = (float(i) + 0.5F) * Scale;
+		Firsts[i] = std::max(int(std::floor(Center - Radius + 0.5F)), 0);
+		Ends[i] = std::max(std::min(int(std::floor(Center + Radius + 0.5F)), SourceSize), Firsts[i]);
+		TapsCount = std::max(TapsCount, Ends[i] - Firsts[i]);
+	}
+	TapsCount = std::min(TapsCount, SourceSize);
 
-		// Compute the first and last indexes from the valid pixels
-		for (int y = 0; y < SizeData.height; y++) {
-			for (int x = 0; x < SizeData.width; x++) {
-				uint32_t Pixel = PixelArray[size_t(y * SizeData.width + x)];
-				uint8_t Alpha = (Pixel >> 24) & 0xFF;
+	Weights->tapsCount = TapsCount;
+	Weights->starts.resize(size_t(DestinationSize));
+	Weights->weights.assign(size_t(DestinationSize) * size_t(TapsCount), 0.0F);
+	for (int i = 0; i < DestinationSize; i++)
+	{
+		float Center = (float(i) + 0.5F) * Scale;
+		int Start = std::min(Firsts[i], SourceSize - TapsCount);
+		float* DestinationWeights = Weights->weights.data() + size_t(i) * TapsCount;
 
-				GetFirstAndLastIndexesFromPixel(Alpha, &FirstLastIndexes, x, y);
-			}
-			// Compute valid width of the line
-			float LineWidth = float(FirstLastIndexes.lastIndexWidth - FirstLastIndexes.firstIndexWidth + 1);
-			if (Width < LineWidth)
+		float Sum = 0.0F;
+		for (int j = Firsts[i]; j < Ends[i]; j++)
+		{
+			float Weight = GetResampleFilterValue(Filter, (float(j) + 0.5F - Center) / FilterScale);
+			DestinationWeights[j - Start] = Weight;
+			Sum += Weight;
+		}
+
+		if (Sum != 0.0F)
+		{
+			for (int j = 0; j < TapsCount; j++)
 			{
-				Width = LineWidth;
+				DestinationWeights[j] /= Sum;
 			}
 		}
-
-		// Compute valid Height
-		Height = float(FirstLastIndexes.lastIndexHeight - FirstLastIndexes.firstIndexHeight + 1);
-		CursorSize = std::pair<float, float>(Width, Height);
+		else
+		{
+			// No source pixel under the filter, the nearest one is kept
+			int Nearest = std::min(std::max(int(Center), 0), SourceSize - 1);
+			Start = std::min(Nearest, SourceSize - TapsCount);
+			DestinationWeights[Nearest - Start] = 1.0F;
+		}
+		Weights->starts[i] = Start;
 	}
+}
 
-	return CursorSize;
+/**
+ * Convert a row of RGBA bytes to floats, with the colors premultiplied by their alpha,
+ * with the fastest instructions of the processor.
+ *
+ * @param Pixels the RGBA bytes of the row.
+ * @param Width the number of pixels of the row.
+ * @param Row the premultiplied colors and the alpha of each pixel, from 0 to 255.
+ */
+void MouseCursorSizeHelper::PremultiplyRow(const uint8_t* Pixels, const int& Width, float* Row)
+{
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
+	PremultiplyRowSse2(Pixels, Width, Row);
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+	PremultiplyRowNeon(Pixels, Width, Row);
+#else
+	for (int x = 0; x < Width; x++)
+	{
+		const uint8_t* Pixel = Pixels + size_t(x) * BYTES_PER_PIXEL;
+		float Alpha = float(Pixel[3]) * (1.0F / 255.0F);
+		Row[x * 4] = float(Pixel[0]) * Alpha;
+		Row[x * 4 + 1] = float(Pixel[1]) * Alpha;
+		Row[x * 4 + 2] = float(Pixel[2]) * Alpha;
+		Row[x * 4 + 3] = float(Pixel[3]);
+	}
+#endif
 }
 
 /**
- * Compute the first and last index depending on the pixel color.
- * These indexes will be used to compute the real size of the cursor.
- * 
+ * Convert a row of premultiplied floats back to RGBA bytes. The values overshot by the
+ * negative lobes of the Lanczos filter are clamped.
  *
- * @param Color the color of the current pixel to process.
- * @param IndexesStruct the structure of indexes to compute.
- * @param IndexX the index of the current pixel on the line.
- * @param IndexY the index of the current pixel on the column.
+ * @param Row the premultiplied colors and the alpha of each pixel, from 0 to 255.
+ * @param Width the number of pixels of the row.
+ * @param Pixels the RGBA bytes of the row.
  */
-void MouseCursorSizeHelper::GetFirstAndLastIndexesFromPixel(const uint8_t& Alpha, FIRSTLASTINDEXES* IndexesStruct, const int& IndexX, const int& IndexY)
+void MouseCursorSizeHelper::UnpremultiplyRow(const float* Row, const int& Width, uint8_t* Pixels)
 {
-	// If pixel is not 100% transparent
-	if (Alpha > 0)
+	for (int x = 0; x < Width; x++)
 	{
-		// Compute the first and last index where there is a valid pixel in line
-		if (!IndexesStruct->isFirstIndexWidthFound)
+		uint8_t* Pixel = Pixels + size_t(x) * BYTES_PER_PIXEL;
+		float Alpha = Row[x * 4 + 3];
+		if (Alpha < 0.5F)
 		{
-			IndexesStruct->firstIndexWidth = IndexX;
-			IndexesStruct->isFirstIndexWidthFound = true;
+			Pixel[0] = Pixel[1] = Pixel[2] = Pixel[3] = 0;
+			continue;
 		}
-		else
+
+		// The colors are divided by the alpha before its clamping, so an overshoot keeps the hue
+		float Factor = 255.0F / Alpha;
+		for (int Channel = 0; Channel < 3; Channel++)
 		{
-			IndexesStruct->lastIndexWidth = IndexX;
+			float Color = std::min(std::max(Row[x * 4 + Channel] * Factor, 0.0F), 255.0F);
+			Pixel[Channel] = uint8_t(Color + 0.5F);
 		}
+		Pixel[3] = uint8_t(std::min(Alpha, 255.0F) + 0.5F);
+	}
+}
 
-		// Compute the first and last index where there is a valid pixel for height
-		if (IndexY != IndexesStruct->lastYValue)
+/**
+ * Resample a row of premultiplied pixels horizontally, with the fastest instructions of the processor.
+ *
+ * @param Row the premultiplied pixels of the source row.
+ * @param Weights the horizontal weights.
+ * @param Destination the premultiplied pixels of the resampled row.
+ */
+void MouseCursorSizeHelper::ResampleRowHorizontally(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination)
+{
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
+	ResampleRowHorizontallySse2(Row, Weights, Destination);
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+	ResampleRowHorizontallyNeon(Row, Weights, Destination);
+#else
+	size_t DestinationSize = Weights.starts.size();
+	for (size_t x = 0; x < DestinationSize; x++)
+	{
+		const float* Pixels = Row + size_t(Weights.starts[x]) * 4;
+		const float* PixelWeights = Weights.weights.data() + x * Weights.tapsCount;
+		float Sum[4] = { 0.0F, 0.0F, 0.0F, 0.0F };
+		for (int i = 0; i < Weights.tapsCount; i++)
 		{
-			if (!IndexesStruct->isFirstIndexHeightFound)
-			{
-				IndexesStruct->firstIndexHeight = IndexY;
-				IndexesStruct->isFirstIndexHeightFound = true;
-			}
-			else
+			for (int Channel = 0; Channel < 4; Channel++)
 			{
-				IndexesStruct->lastIndexHeight = IndexY;
+				Sum[Channel] += PixelWeights[i] * Pixels[i * 4 + Channel];
 			}
-			IndexesStruct->lastYValue = IndexY;
 		}
+		std::copy(Sum, Sum + 4, Destination + x * 4);
 	}
+#endif
 }
 
 /**
- * Scale the real mouse cursor size depending on the mouse cursor size multiplier defined on the system.
+ * Add a weighted row to a row, with the fastest instructions of the processor.
  *
- * @param CursorSize the real mouse cursor size to scale.
+ * @param Row the row to add.
+ * @param Weight the weight of the row to add.
+ * @param Count the number of floats of the rows, a multiple of 4.
+ * @param Destination the row receiving the weighted row.
  */
-void MouseCursorSizeHelper::ScaleCursorSizeByMouseSystemScale(std::pair<float, float>* CursorSize)
+void MouseCursorSizeHelper::AccumulateRow(const float* Row, const float& Weight, const size_t& Count, float* Destination)
 {
-	float MouseScale = GetMouseCursorScale();
-
-	CursorSize->first = CursorSize->first + (MouseScale - 1) * (CursorSize->first / 2);
-	CursorSize->second = CursorSize->second + (MouseScale - 1) * (CursorSize->second / 2);
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
+	AccumulateRowSse2(Row, Weight, Count, Destination);
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+	AccumulateRowNeon(Row, Weight, Count, Destination);
+#else
+	for (size_t i = 0; i < Count; i++)
+	{
+		Destination[i] += Weight * Row[i];
+	}
+#endif
 }
 
+#if defined(MOUSE_CURSOR_SIZE_HELPER_X86)
 /**
- * Scale the real mouse cursor size depending on the DPI defined on the system.
+ * Convert a row of RGBA bytes to premultiplied floats, with SSE2. The bytes of 4 pixels are
+ * loaded at once, and each pixel is widened to 4 floats multiplied at once by the alpha,
+ * the alpha itself by 1.
  *
- * @param CursorSize the real mouse cursor size to scale.
+ * @param Pixels the RGBA bytes of the row.
+ * @param Width the number of pixels of the row.
+ * @param Row the premultiplied colors and the alpha of each pixel, from 0 to 255.
  */
-void MouseCursorSizeHelper::ScaleCursorSizeByDPI(std::pair<float, float>* CursorSize)
+MOUSE_CURSOR_SIZE_HELPER_TARGET("sse2")
+void MouseCursorSizeHelper::PremultiplyRowSse2(const uint8_t* Pixels, const int& Width, float* Row)
 {
-	float AppliedDPI = GetDPIScale() / 100.0F;
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128 ColorsMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 AlphaOne = _mm_set_ps(1.0F, 0.0F, 0.0F, 0.0F);
+	const __m128 InverseMaximum = _mm_set1_ps(1.0F / 255.0F);
+	auto Premultiply = [&](const __m128i& Words, float* Destination) {
+		__m128 Channels = _mm_cvtepi32_ps(_mm_unpacklo_epi16(Words, Zero));
 
-	CursorSize->first *= AppliedDPI;
-	CursorSize->second *= AppliedDPI;
+		// (alpha / 255, alpha / 255, alpha / 255, 1)
+		__m128 Alpha = _mm_mul_ps(_mm_shuffle_ps(Channels, Channels, _MM_SHUFFLE(3, 3, 3, 3)), InverseMaximum);
+		__m128 Factors = _mm_or_ps(_mm_and_ps(Alpha, ColorsMask), AlphaOne);
+		_mm_storeu_ps(Destination, _mm_mul_ps(Channels, Factors));
+	};
+
+	int x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Pixels + size_t(x) * BYTES_PER_PIXEL));
+		__m128i Low = _mm_unpacklo_epi8(Bytes, Zero);
+		__m128i High = _mm_unpackhi_epi8(Bytes, Zero);
+		Premultiply(Low, Row + size_t(x) * 4);
+		Premultiply(_mm_srli_si128(Low, 8), Row + size_t(x + 1) * 4);
+		Premultiply(High, Row + size_t(x + 2) * 4);
+		Premultiply(_mm_srli_si128(High, 8), Row + size_t(x + 3) * 4);
+	}
+	for (; x < Width; x++)
+	{
+		int32_t Pixel;
+		std::memcpy(&Pixel, Pixels + size_t(x) * BYTES_PER_PIXEL, sizeof(Pixel));
+		Premultiply(_mm_unpacklo_epi8(_mm_cvtsi32_si128(Pixel), Zero), Row + size_t(x) * 4);
+	}
 }
 
 /**
- * Get the mouse cursor size multiplier defined on the system, using registry.
+ * Resample a row of premultiplied pixels horizontally, with SSE2.
+ * The 4 channels of a pixel are weighted at once.
  *
- * @return The mouse cursor size multiplier defined on the system.
+ * @param Row the premultiplied pixels of the source row.
+ * @param Weights the horizontal weights.
+ * @param Destination the premultiplied pixels of the resampled row.
  */
-float MouseCursorSizeHelper::GetMouseCursorScale()
+MOUSE_CURSOR_SIZE_HELPER_TARGET("sse2")
+void MouseCursorSizeHelper::ResampleRowHorizontallySse2(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination)
 {
-	return GetRegistryValueFloat(REG_ACCESSIBILITY_GROUP, REG_KEY_CURSOR_SIZE, DEFAULT_MOUSE_SCALE);
+	size_t DestinationSize = Weights.starts.size();
+	for (size_t x = 0; x < DestinationSize; x++)
+	{
+		const float* Pixels = Row + size_t(Weights.starts[x]) * 4;
+		const float* PixelWeights = Weights.weights.data() + x * Weights.tapsCount;
+		__m128 Sum = _mm_setzero_ps();
+		for (int i = 0; i < Weights.tapsCount; i++)
+		{
+			Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(PixelWeights[i]), _mm_loadu_ps(Pixels + i * 4)));
+		}
+		_mm_storeu_ps(Destination + x * 4, Sum);
+	}
 }
 
 /**
- * Get the DPI defined for the main monitor of system.
+ * Add a weighted row to a row, with SSE2. 4 floats are added at once.
  *
- * @return The DPI defined on the system for the main monitor.
+ * @param Row the row to add.
+ * @param Weight the weight of the row to add.
+ * @param Count the number of floats of the rows, a multiple of 4.
+ * @param Destination the row receiving the weighted row.
  */
-float MouseCursorSizeHelper::GetDPIScaleOfWindowsSystem()
+MOUSE_CURSOR_SIZE_HELPER_TARGET("sse2")
+void MouseCursorSizeHelper::AccumulateRowSse2(const float* Row, const float& Weight, const size_t& Count, float* Destination)
 {
-	int DpiX = int(DEFAULT_APPLIED_DPI);
-	int DpiY = int(DEFAULT_APPLIED_DPI);
-
-#ifdef _WIN32
-
-	// Indicates that the application is DPI aware
-	SetProcessDPIAware();
-
-	// Get the device context for the primary display
-	HDC HdcScreen = GetDC(NULL);
-	if (HdcScreen != NULL) {
-		DpiX = GetDeviceCaps(HdcScreen, LOGPIXELSX);
-		DpiY = GetDeviceCaps(HdcScreen, LOGPIXELSY);
-
-		// Free the device context from the primary screen
-		ReleaseDC(NULL, HdcScreen);
+	const __m128 Weights = _mm_set1_ps(Weight);
+	for (size_t i = 0; i < Count; i += 4)
+	{
+		_mm_storeu_ps(Destination + i, _mm_add_ps(_mm_loadu_ps(Destination + i), _mm_mul_ps(Weights, _mm_loadu_ps(Row + i))));
+	}
+}
+#elif defined(MOUSE_CURSOR_SIZE_HELPER_NEON)
+/**
+ * Convert a row of RGBA bytes to premultiplied floats, with NEON. The bytes of 4 pixels are
+ * deinterleaved, then the colors of the 4 pixels are multiplied at once by their alphas.
+ *
+ * @param Pixels the RGBA bytes of the row.
+ * @param Width the number of pixels of the row.
+ * @param Row the premultiplied colors and the alpha of each pixel, from 0 to 255.
+ */
+void MouseCursorSizeHelper::PremultiplyRowNeon(const uint8_t* Pixels, const int& Width, float* Row)
+{
+	int x = 0;
+	for (; x + 8 <= Width; x += 8)
+	{
+		uint8x8x4_t Bytes = vld4_u8(Pixels + size_t(x) * BYTES_PER_PIXEL);
+		for (int Half = 0; Half < 2; Half++)
+		{
+			float32x4x4_t Channels;
+			for (int Channel = 0; Channel < 4; Channel++)
+			{
+				uint16x8_t Words = vmovl_u8(Bytes.val[Channel]);
+				Channels.val[Channel] = vcvtq_f32_u32(vmovl_u16(Half == 0 ? vget_low_u16(Words) : vget_high_u16(Words)));
+			}
+			float32x4_t Alpha = vmulq_n_f32(Channels.val[3], 1.0F / 255.0F);
+			for (int Channel = 0; Channel < 3; Channel++)
+			{
+				Channels.val[Channel] = vmulq_f32(Channels.val[Channel], Alpha);
+			}
+			vst4q_f32(Row + size_t(x + Half * 4) * 4, Channels);
+		}
+	}
+	for (; x < Width; x++)
+	{
+		const uint8_t* Pixel = Pixels + size_t(x) * BYTES_PER_PIXEL;
+		float Alpha = float(Pixel[3]) * (1.0F / 255.0F);
+		Row[x * 4] = float(Pixel[0]) * Alpha;
+		Row[x * 4 + 1] = float(Pixel[1]) * Alpha;
+		Row[x * 4 + 2] = float(Pixel[2]) * Alpha;
+		Row[x * 4 + 3] = float(Pixel[3]);
 	}
-
-#endif // _WIN32
-
-	return float(DpiX);
 }
 
 /**
- * Get the DPI defined on the system.
+ * Resample a row of premultiplied pixels horizontally, with NEON.
+ * The 4 channels of a pixel are weighted at once.
  *
- * @return The DPI defined on the system.
+ * @param Row the premultiplied pixels of the source row.
+ * @param Weights the horizontal weights.
+ * @param Destination the premultiplied pixels of the resampled row.
  */
-float MouseCursorSizeHelper::GetDPIScale()
+void MouseCursorSizeHelper::ResampleRowHorizontallyNeon(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination)
 {
-	float AppliedDPI = GetDPIScaleOfWindowsSystem();
+	size_t DestinationSize = Weights.starts.size();
+	for (size_t x = 0; x < DestinationSize; x++)
+	{
+		const float* Pixels = Row + size_t(Weights.starts[x]) * 4;
+		const float* PixelWeights = Weights.weights.data() + x * Weights.tapsCount;
+		float32x4_t Sum = vdupq_n_f32(0.0F);
+		for (int i = 0; i < Weights.tapsCount; i++)
+		{
+			Sum = vmlaq_n_f32(Sum, vld1q_f32(Pixels + i * 4), PixelWeights[i]);
+		}
+		vst1q_f32(Destination + x * 4, Sum);
+	}
+}
 
-	return float(DPI_FACTOR) * AppliedDPI;
+/**
+ * Add a weighted row to a row, with NEON. 4 floats are added at once.
+ *
+ * @param Row the row to add.
+ * @param Weight the weight of the row to add.
+ * @param Count the number of floats of the rows, a multiple of 4.
+ * @param Destination the row receiving the weighted row.
+ */
+void MouseCursorSizeHelper::AccumulateRowNeon(const float* Row, const float& Weight, const size_t& Count, float* Destination)
+{
+	for (size_t i = 0; i < Count; i += 4)
+	{
+		vst1q_f32(Destination + i, vmlaq_n_f32(vld1q_f32(Destination + i), vld1q_f32(Row + i), Weight));
+	}
 }
+#endif // MOUSE_CURSOR_SIZE_HELPER_X86
 
 /**
- * Ceil the pair of float passed as parameter.
- * For example: {3.44F, 10.12F} become {3.0F, 10.0F}.
- * 
- * @param Pair the pair to ceil.
+ * Get the size and the last modification time of a file without opening it.
+ * The time has the precision of the file system, so a file rewritten within
+ * the same second still gets another modification time.
+ *
+ * @param Path the path of the file.
+ * @param FileSize the size of the file, -1 if the file is not found.
+ * @param ModificationTime the last modification time of the file (in 100 nanoseconds on Windows, in nanoseconds elsewhere), 0 if the file is not found.
  */
-void MouseCursorSizeHelper::CeilPair(std::pair<float, float>* Pair)
+void MouseCursorSizeHelper::GetFileSizeAndModificationTime(const std::string& Path, int64_t* FileSize, int64_t* ModificationTime)
 {
-	Pair->first = ceil(Pair->first);
-	Pair->second = ceil(Pair->second);
+	*FileSize = -1;
+	*ModificationTime = 0;
+
+	if (!Path.empty())
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA FileAttributes;
+		if (GetFileAttributesExA(Path.c_str(), GetFileExInfoStandard, &FileAttributes))
+		{
+			*FileSize = int64_t((uint64_t(FileAttributes.nFileSizeHigh) << 32) | FileAttributes.nFileSizeLow);
+			*ModificationTime = int64_t((uint64_t(FileAttributes.ftLastWriteTime.dwHighDateTime) << 32) | FileAttributes.ftLastWriteTime.dwLowDateTime);
+		}
+#else
+		struct stat FileStatus;
+		if (stat(Path.c_str(), &FileStatus) == 0)
+		{
+#if defined(__APPLE__)
+			const struct timespec& Time = FileStatus.st_mtimespec;
+#else
+			const struct timespec& Time = FileStatus.st_mtim;
+#endif // __APPLE__
+			*FileSize = int64_t(FileStatus.st_size);
+			*ModificationTime = int64_t(Time.tv_sec) * 1000000000 + int64_t(Time.tv_nsec);
+		}
+#endif // _WIN32
+	}
 }
 
 /**
  * Get the value in float format of registry key passed as parameter.
  *
- * @param RegLocation the location of the registry key.
+ * @param RegLocation the opened location of the registry key.
  * @param RegKey the registry key to read.
  * @param DefaultValue the default value to make equal the variable if the registry key is not found.
  * @return The value of the registry key in float if found. The default value otherwise.
  */
-float MouseCursorSizeHelper::GetRegistryValueFloat(const LPCSTR& RegLocation, const LPCSTR& RegKey, const float& DefaultValue)
+float MouseCursorSizeHelper::GetRegistryValueFloat(const HKEY& RegLocation, const LPCSTR& RegKey, const float& DefaultValue)
 {
 	float resultValue = DefaultValue;
 
@@ -443,13 +5971,16 @@ float MouseCursorSizeHelper::GetRegistryValueFloat(const LPCSTR& RegLocation, co
 	DWORD Value = 0;
 	DWORD DataSize = sizeof(Value);
 
-	long ResultRegCode = RegGetValueA(HKEY_CURRENT_USER, RegLocation, RegKey, RRF_RT_REG_DWORD, NULL, &Value, &DataSize);
+	long ResultRegCode = RegGetValueA(RegLocation, NULL, RegKey, RRF_RT_REG_DWORD, NULL, &Value, &DataSize);
 
 	// If the registry exists and value gotten
 	if (ResultRegCode == ERROR_SUCCESS)
 	{
 		resultValue = float(Value);
 	}
+#else
+	(void)RegLocation;
+	(void)RegKey;
 #endif // _WIN32
 
 	return resultValue;
@@ -457,123 +5988,261 @@ float MouseCursorSizeHelper::GetRegistryValueFloat(const LPCSTR& RegLocation, co
 
 /**
  * Get the value in string format of registry key passed as parameter.
+ * The value is written in place, so the string is only reallocated when it is too small.
+ * The size of the value is only queried when the capacity of the string is not enough.
  *
- * @param RegLocation the location of the registry key.
+ * @param RegLocation the opened location of the registry key.
  * @param RegKey the registry key to read.
- * @return The value of the registry key in string format if found. An empty string otherwise.
+ * @param Value the value of the registry key in string format if found. An empty string otherwise.
  */
-std::string MouseCursorSizeHelper::GetRegistryValueString(const LPCSTR& RegLocation, const LPCSTR& RegKey)
+void MouseCursorSizeHelper::GetRegistryValueString(const HKEY& RegLocation, const LPCSTR& RegKey, std::string* Value)
 {
-	std::string Value = "";
+	Value->clear();
 
 #ifdef _WIN32
-	HKEY hSubKey;
-	if (RegOpenKeyExA(HKEY_CURRENT_USER, RegLocation, 0, KEY_READ, &hSubKey) == ERROR_SUCCESS)
+	const DWORD Flags = RRF_RT_REG_SZ | RRF_RT_REG_EXPAND_SZ | RRF_NOEXPAND;
+	Value->resize(std::max<size_t>(Value->capacity(), MAX_PATH));
+
+	// The size includes the null character
+	DWORD Size = DWORD(Value->size());
+	long ResultRegCode = RegGetValueA(RegLocation, NULL, RegKey, Flags, NULL, &(*Value)[0], &Size);
+	if (ResultRegCode == ERROR_MORE_DATA)
 	{
-		DWORD type;
-		DWORD size;
-		if (RegQueryValueExA(hSubKey, RegKey, NULL, &type, NULL, &size) == ERROR_SUCCESS)
-		{
-			std::string ValueTemp(size, 0);
-			if (RegQueryValueExA(hSubKey, RegKey, NULL, &type, LPBYTE(ValueTemp.data()), &size) == ERROR_SUCCESS)
-			{
-				Value = ValueTemp;
-			}
-		}
-		RegCloseKey(hSubKey);
+		Value->resize(Size);
+		ResultRegCode = RegGetValueA(RegLocation, NULL, RegKey, Flags, NULL, &(*Value)[0], &Size);
 	}
-#endif // _WIN32
 
-	return Value;
+	if (ResultRegCode == ERROR_SUCCESS)
+	{
+		Value->resize(strlen(Value->c_str()));
+	}
+	else
+	{
+		Value->clear();
+	}
+#else
+	(void)RegLocation;
+	(void)RegKey;
+#endif // _WIN32
 }
 
 /**
- * Get the value of environment variable.
+ * Append the value of an environment variable to a path.
  *
- * @param EnvName the name of the environment variable to read.
- * @return The value of the environment variable if it exists. An empty string otherwise.
+ * @param EnvName the name of the environment variable, not null terminated.
+ * @param EnvNameSize the number of characters of the name.
+ * @param Path the path receiving the value.
+ * @return True if the environment variable exists and is not empty.
  */
-std::string MouseCursorSizeHelper::GetValueOfEnvVariable(const std::string& EnvName)
+bool MouseCursorSizeHelper::AppendValueOfEnvVariable(const char* EnvName, const size_t& EnvNameSize, std::string* Path)
 {
-	std::string EnvValue = "";
+	bool IsAppended = false;
+
+#ifdef _WIN32
+	char Name[MAX_PATH];
+	char Buffer[MAX_PATH];
+	if (EnvNameSize < MAX_PATH)
+	{
+		memcpy(Name, EnvName, EnvNameSize);
+		Name[EnvNameSize] = 0;
 
-	char buffer[MAX_PATH];
-	DWORD size = GetEnvironmentVariableA(LPCSTR(EnvName.c_str()), buffer, MAX_PATH);
-	if (size != 0) {
-		EnvValue = std::string(buffer);
+		DWORD Size = GetEnvironmentVariableA(Name, Buffer, MAX_PATH);
+		IsAppended = Size != 0 && Size < MAX_PATH;
+		if (IsAppended)
+		{
+			Path->append(Buffer, Size);
+		}
 	}
+#else
+	(void)EnvName;
+	(void)EnvNameSize;
+	(void)Path;
+#endif // _WIN32
 
-	return EnvValue;
+	return IsAppended;
 }
 
 /**
- * Get the key value of all environment variables contained in path.
+ * Replace all evironment variables contained in path by their values. This makes the path valid.
+ * The variables are expanded in a single pass, without any temporary string.
  *
- * @param Path the path in which to look for environment variables.
- * @return The key value of all environment variables contained in path.
+ * @param RawPath the path to process.
+ * @param Path the processed path, the capacity of the string is reused.
  */
-std::map<std::string, std::string> MouseCursorSizeHelper::GetAllEnvNameValueInPath(const std::string& Path)
+void MouseCursorSizeHelper::PurifyPath(const std::string& RawPath, std::string* Path)
 {
-	std::map<std::string, std::string> EnvKeyValue = {};
-
-	int count = 0;
+	TRACESPAN Span(TRACE_EVENT_PURIFY_PATH);
 
-	// Count number occurences of '%'
-	for (char c : Path)
+#ifdef _WIN32
+	// The number of tags must be valid
+	if (std::count(RawPath.begin(), RawPath.end(), '%') % 2 != 0)
 	{
-		count += c == '%';
+		*Path = RawPath;
+		return;
 	}
 
-	// The number of tags is valid
-	if (count % 2 == 0)
+	Path->clear();
+	size_t Position = 0;
+	while (Position < RawPath.size())
 	{
-		std::string EnvName = "";
-		bool CanWrite = false;
+		size_t TagStart = RawPath.find('%', Position);
+		if (TagStart == std::string::npos)
+		{
+			Path->append(RawPath, Position, std::string::npos);
+			break;
+		}
+
+		size_t TagEnd = RawPath.find('%', TagStart + 1);
+		Path->append(RawPath, Position, TagStart - Position);
 
-		// Get the variable names in path
-		for (char c : Path)
+		// An unknown or empty variable is kept as it is
+		if (TagEnd == TagStart + 1 || !AppendValueOfEnvVariable(RawPath.data() + TagStart + 1, TagEnd - TagStart - 1, Path))
 		{
-			if (c == '%')
-			{
-				CanWrite = !CanWrite;
-			}
-			else if (CanWrite)
+			Path->append(RawPath, TagStart, TagEnd - TagStart + 1);
+		}
+
+		Position = TagEnd + 1;
+	}
+#else
+	*Path = RawPath;
+#endif // _WIN32
+}
+
+/**
+ * Get the DPI of the X Window System from the Xft.dpi resource of the X resources file.
+ *
+ * @param ResourcesPath the path of the X resources file.
+ * @return The Xft.dpi resource if found, the default DPI otherwise.
+ */
+float MouseCursorSizeHelper::GetXftDpi(const std::string& ResourcesPath)
+{
+	float Dpi = DEFAULT_APPLIED_DPI;
+	std::ifstream File(ResourcesPath);
+	std::string Line;
+	while (std::getline(File, Line))
+	{
+		size_t Start = Line.find_first_not_of(" \t");
+		if (Start != std::string::npos && (Line.compare(Start, 8, "Xft.dpi:") == 0 || Line.compare(Start, 8, "Xft*dpi:") == 0))
+		{
+			float Value = float(atof(Line.c_str() + Start + 8));
+			if (Value > 0)
 			{
-				EnvName += c;
+				Dpi = Value;
 			}
+		}
+	}
+
+	return Dpi;
+}
 
-			if (!EnvName.empty() && !CanWrite)
+/**
+ * Find a cursor file of an Xcursor theme, in the directories of a search path.
+ * When the theme has no such cursor, the themes it inherits are searched too.
+ *
+ * @param Theme the name of the theme.
+ * @param SearchPath the directories of the themes, separated by colons.
+ * @param CursorName the name of the cursor file in the theme.
+ * @param Path the path of the cursor file if found, an empty path otherwise. The capacity of the string is reused.
+ * @return True if the cursor file is found.
+ */
+bool MouseCursorSizeHelper::FindXcursorFile(const std::string& Theme, const std::string& SearchPath, const char* CursorName, std::string* Path)
+{
+	std::string CurrentTheme = Theme;
+	std::string InheritedTheme;
+	for (int i = 0; i < XCURSOR_MAX_INHERITED_THEMES && !CurrentTheme.empty(); i++)
+	{
+		InheritedTheme.clear();
+		const char* Directory = SearchPath.c_str();
+		while (Directory != nullptr)
+		{
+			const char* DirectoryEnd = strchr(Directory, ':');
+			size_t DirectorySize = DirectoryEnd != nullptr ? size_t(DirectoryEnd - Directory) : strlen(Directory);
+			if (DirectorySize > 0)
 			{
-				EnvKeyValue.insert({ EnvName, GetValueOfEnvVariable(EnvName) });
-				EnvName = "";
+				Path->clear();
+				AppendExpandedHome(Directory, DirectorySize, Path);
+				Path->append("/").append(CurrentTheme);
+				size_t ThemeDirectorySize = Path->size();
+				Path->append("/cursors/").append(CursorName);
+
+				int64_t FileSize;
+				int64_t ModificationTime;
+				GetFileSizeAndModificationTime(*Path, &FileSize, &ModificationTime);
+				if (FileSize > 0)
+				{
+					return true;
+				}
+
+				// The first index of the theme found gives the inherited theme
+				Path->resize(ThemeDirectorySize);
+				if (InheritedTheme.empty())
+				{
+					GetInheritedXcursorTheme(*Path, &InheritedTheme);
+				}
 			}
+
+			Directory = DirectoryEnd != nullptr ? DirectoryEnd + 1 : nullptr;
 		}
+
+		CurrentTheme.swap(InheritedTheme);
 	}
 
-	return EnvKeyValue;
+	Path->clear();
+
+	return false;
 }
 
 /**
- * Replace all evironment variables contained in path by their values. This makes the path valid.
+ * Get the first theme inherited by an Xcursor theme, from the Inherits key of its index file.
  *
- * @param Path the path to process.
+ * @param ThemeDirectory the directory of the theme.
+ * @param Theme the name of the inherited theme if found, an empty string otherwise.
+ * @return True if the theme inherits another one.
  */
-void MouseCursorSizeHelper::PurifyPath(std::string* Path)
+bool MouseCursorSizeHelper::GetInheritedXcursorTheme(const std::string& ThemeDirectory, std::string* Theme)
 {
-#ifdef _WIN32
-	std::map<std::string, std::string> EnvKeyValue = GetAllEnvNameValueInPath(*Path);
+	Theme->clear();
 
-	for (std::pair<std::string, std::string> EnvPair : EnvKeyValue)
+	std::ifstream File(ThemeDirectory + "/index.theme");
+	std::string Line;
+	while (Theme->empty() && std::getline(File, Line))
 	{
-		if (!EnvPair.first.empty() && !EnvPair.second.empty())
+		size_t Start = Line.find_first_not_of(" \t");
+		if (Start != std::string::npos && Line.compare(Start, 8, "Inherits") == 0)
 		{
-			std::string KeyName = "%" + EnvPair.first + "%";
-			size_t KeyPosition = Path->find(KeyName);
-			if (KeyPosition >= 0)
+			size_t Equal = Line.find_first_not_of(" \t", Start + 8);
+			if (Equal != std::string::npos && Line[Equal] == '=')
 			{
-				Path->replace(KeyPosition, KeyName.size(), EnvPair.second);
+				size_t NameStart = Line.find_first_not_of(" \t", Equal + 1);
+				size_t NameEnd = Line.find_first_of(" \t,;\r", NameStart);
+				if (NameStart != std::string::npos)
+				{
+					Theme->assign(Line, NameStart, NameEnd == std::string::npos ? std::string::npos : NameEnd - NameStart);
+				}
 			}
 		}
 	}
-#endif // _WIN32
+
+	return !Theme->empty();
+}
+
+/**
+ * Append a directory to a path, with its leading tilde replaced by the HOME environment variable.
+ *
+ * @param Directory the directory to append, not null terminated.
+ * @param DirectorySize the number of characters of the directory.
+ * @param Path the path receiving the directory.
+ */
+void MouseCursorSizeHelper::AppendExpandedHome(const char* Directory, const size_t& DirectorySize, std::string* Path)
+{
+	const char* Home = getenv("HOME");
+	if (DirectorySize > 0 && Directory[0] == '~' && Home != nullptr)
+	{
+		Path->append(Home);
+		Path->append(Directory + 1, DirectorySize - 1);
+	}
+	else
+	{
+		Path->append(Directory, DirectorySize);
+	}
 }
\ No newline at end of file
@@ -9,14 +9,42 @@
 #ifndef MOUSE_CURSOR_SIZE_HELPER_H
 #define MOUSE_CURSOR_SIZE_HELPER_H
 
+#include <stdint.h>
+
 #ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // The min and max macros of windows.h would hide std::min and std::max
+#endif // !NOMINMAX
 #include <windows.h>
+#else
+typedef const char* LPCSTR;
+typedef void* HKEY;
+constexpr uint32_t BI_RGB = 0;
 #endif // _WIN32
 
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <condition_variable>
+#include <future>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define MOUSE_CURSOR_SIZE_HELPER_COROUTINES // The awaitable query is available from C++20
+#endif // __cpp_impl_coroutine
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+#include <chrono>
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
 
 constexpr int DEFAULT_IMAGE_CURSOR_SIZE = 32;
 constexpr float DEFAULT_ORIGIN_MOUSE_WIDTH = 12;
@@ -29,8 +57,68 @@ constexpr LPCSTR REG_KEY_CURSOR_FILE = "Arrow";
 constexpr LPCSTR REG_KEY_CURSOR_BASE_SIZE = "CursorBaseSize";
 constexpr LPCSTR REG_ACCESSIBILITY_GROUP = "Software\\Microsoft\\Accessibility";
 constexpr LPCSTR REG_KEY_CURSOR_SIZE = "CursorSize";
+constexpr LPCSTR REG_KEYS_CURSOR_ROLES[] = {
+    "Arrow", "Help", "AppStarting", "Wait", "Crosshair", "IBeam", "NWPen", "No", "SizeNS",
+    "SizeWE", "SizeNWSE", "SizeNESW", "SizeAll", "UpArrow", "Hand", "Pin", "Person"
+};
 constexpr int BYTES_PER_PIXEL = 4;
+constexpr uint32_t ANI_FLAG_ICON_FRAMES = 0x1;
+constexpr size_t ANI_MIN_PARALLEL_FRAMES = 8;
+constexpr uint32_t PNG_MAX_PICTURE_SIZE = 4096;
+constexpr size_t INFLATE_WINDOW_SIZE = 32768;
 constexpr double DPI_FACTOR = 100.0 / DEFAULT_APPLIED_DPI;
+constexpr uint32_t PERSISTENT_CACHE_MAGIC = 0x4353434D; // "MCSC"
+constexpr uint32_t PERSISTENT_CACHE_VERSION = 3;
+constexpr uint32_t PERSISTENT_CACHE_SLOTS = 64;
+constexpr uint64_t HASH_OFFSET_BASIS = 0xCBF29CE484222325;
+constexpr uint64_t HASH_PRIME = 0x100000001B3;
+constexpr uint64_t PATH_HASH_SEED = 0x9E3779B97F4A7C15;
+constexpr const char* XCURSOR_DEFAULT_PATH = "~/.local/share/icons:~/.icons:/usr/share/icons:/usr/share/pixmaps";
+constexpr const char* XCURSOR_DEFAULT_THEME = "default";
+constexpr const char* XCURSOR_ARROW_NAME = "left_ptr";
+constexpr int XCURSOR_MAX_INHERITED_THEMES = 8;
+constexpr float XCURSOR_SIZE_PER_DPI = 16.0F / 72.0F;
+constexpr uint32_t XCURSOR_MAGIC = 0x72756358; // "Xcur"
+constexpr uint32_t XCURSOR_FILE_HEADER_SIZE = 16;
+constexpr uint32_t XCURSOR_TOC_ENTRY_SIZE = 12;
+constexpr uint32_t XCURSOR_MAX_TOC_ENTRIES = 0x10000;
+constexpr uint32_t XCURSOR_IMAGE_TYPE = 0xFFFD0002;
+constexpr uint32_t XCURSOR_IMAGE_HEADER_SIZE = 36;
+constexpr uint32_t XCURSOR_IMAGE_MAX_SIZE = 0x7FFF;
+constexpr int XCURSOR_MAX_NOMINAL_SIZES = 32;
+constexpr uint32_t WATCHER_DEFAULT_POLL_INTERVAL = 1000;
+constexpr float PUBLISHED_MAX_SIZE = 65535;
+constexpr int STATS_STAGE_QUERY = 0;
+constexpr int STATS_STAGE_READ_SETTINGS = 1;
+constexpr int STATS_STAGE_OPEN_FILE = 2;
+constexpr int STATS_STAGE_SELECT_FRAME = 3;
+constexpr int STATS_STAGE_COMPUTE_SIZE = 4;
+constexpr int STATS_STAGE_SCALE = 5;
+constexpr int STATS_STAGES_COUNT = 6;
+constexpr int STATS_HISTOGRAM_BUCKETS = 32;
+constexpr int TRACE_EVENT_QUERY = 0;
+constexpr int TRACE_EVENT_READ_SETTINGS = 1;
+constexpr int TRACE_EVENT_PURIFY_PATH = 2;
+constexpr int TRACE_EVENT_OPEN_FILE = 3;
+constexpr int TRACE_EVENT_READ_DIRECTORY = 4;
+constexpr int TRACE_EVENT_DECODE_FRAME = 5;
+constexpr int TRACE_EVENT_APPLY_MASK = 6;
+constexpr int TRACE_EVENT_FLIP = 7;
+constexpr int TRACE_EVENT_SCAN = 8;
+constexpr int TRACE_EVENT_SCALE = 9;
+constexpr int TRACE_EVENTS_COUNT = 10;
+constexpr uint64_t TRACE_RING_CAPACITY = 4096;
+constexpr int MONITOR_MAX_DPI_SCALE = 500;
+constexpr int CURSOR_MIN_SCALE = 1;
+constexpr int CURSOR_MAX_SCALE = 15;
+constexpr int CURSOR_SCALES_COUNT = CURSOR_MAX_SCALE - CURSOR_MIN_SCALE + 1;
+constexpr int CURSOR_BASE_SIZE_PER_SCALE = 16;
+constexpr int RESAMPLE_FILTER_BOX = 0;
+constexpr int RESAMPLE_FILTER_BILINEAR = 1;
+constexpr int RESAMPLE_FILTER_LANCZOS = 2;
+constexpr float RESAMPLE_LANCZOS_RADIUS = 3;
+constexpr size_t RESAMPLE_PARALLEL_MIN_PIXELS = 128 * 128;
+constexpr int RESAMPLE_ROWS_PER_TASK = 16;
 
 /**
   * This class was created to get the real size of the mouse cursor
@@ -50,7 +138,560 @@ public:
     */
     static std::pair<float, float> GetCurrentMouseCursorSize();
 
+    struct QUERYWORKSPACE;
+
+    /**
+    * Get the real current mouse cursor size with scales, with buffers owned by the caller.
+    * Once the workspace is warmed up by a first call, the query does not allocate any heap
+    * memory, unless the cursor file is an animated cursor.
+    *
+    * @param Workspace the buffers reused from one call to another, used by one thread at a time.
+    * @return The pair of the real mouse cursor width and height.
+    */
+    static std::pair<float, float> GetCurrentMouseCursorSize(QUERYWORKSPACE* Workspace);
+
+    /**
+    * Forget the memoized mouse cursor size. The next call of
+    * GetCurrentMouseCursorSize will compute the size again.
+    */
+    static void Invalidate();
+
+    struct CACHESTATISTICS {
+        uint64_t hits;                  // Calls answered with the memoized size
+        uint64_t misses;                // Calls which computed the size again
+    };
+
+    /**
+    * Get the counters of the memoized mouse cursor size.
+    *
+    * @return The number of cache hits and misses since the start of the program.
+    */
+    static CACHESTATISTICS GetCacheStatistics();
+
+    /**
+    * Enable a persistent cache of the computed sizes, stored in a file shared by all the
+    * processes. At startup, a cached size is read back without opening the cursor file.
+    *
+    * @param Path the path of the cache file, an empty path to disable the persistent cache.
+    */
+    static void SetPersistentCachePath(const std::string& Path);
+
+    /**
+    * Get the real sizes of all the mouse cursors of the current scheme with scales.
+    * The settings are read once for all the cursors and the cursor files are decoded concurrently.
+    *
+    * @return The pair of the real mouse cursor width and height of each cursor role (Arrow, Hand, IBeam...).
+    */
+    static std::map<std::string, std::pair<float, float>> GetCurrentMouseCursorSchemeSizes();
+
+    struct CURSORFILEINFO {
+        int frameIndex;                 // Index of the chosen frame in the file
+        int frameWidth;                 // Width of the chosen frame
+        int frameHeight;                // Height of the chosen frame
+        float trimmedWidth;             // Width of the visible part of the frame
+        float trimmedHeight;            // Height of the visible part of the frame
+        int hotspotX;                   // Horizontal position of the hotspot in the frame
+        int hotspotY;                   // Vertical position of the hotspot in the frame
+        bool isRealSize;                // The chosen frame has the desired size
+    };
+
+    /**
+    * Analyze a cursor file without reading any system setting.
+    *
+    * @param Path the path of the cursor file.
+    * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+    * @param Info the informations about the chosen frame of the file.
+    * @return True if the file is a cursor file with a supported frame.
+    */
+    static bool AnalyzeCursorFile(const std::string& Path, const int& DesiredSize, CURSORFILEINFO* Info);
+
+    /**
+    * Analyze a cursor file embedded in the program. In a constant expression, the informations
+    * are computed at compile time. Only the bitmap pictures are supported, not the PNG ones.
+    *
+    * @param File the bytes of the cursor file.
+    * @param Size the number of bytes of the cursor file.
+    * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+    * @return The informations about the chosen frame of the file, with a frame index of -1 if the file is not a cursor file with a supported frame.
+    */
+    static constexpr CURSORFILEINFO AnalyzeEmbeddedCursorFile(const uint8_t* File, const size_t& Size, const int& DesiredSize);
+
+    /**
+    * Analyze a cursor file embedded in the program. In a constant expression, the informations
+    * are computed at compile time. Only the bitmap pictures are supported, not the PNG ones.
+    *
+    * @param File the bytes of the cursor file.
+    * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+    * @return The informations about the chosen frame of the file, with a frame index of -1 if the file is not a cursor file with a supported frame.
+    */
+    template <size_t Size>
+    static constexpr CURSORFILEINFO AnalyzeEmbeddedCursorFile(const std::array<uint8_t, Size>& File, const int& DesiredSize);
+
+    struct CURSORFRAMEMETRICS {
+        int nominalSize;                // Size choosing the frame as the real size (-1 for a frame which is not square)
+        int frameWidth;                 // Width of the frame
+        int frameHeight;                // Height of the frame
+        float trimmedWidth;             // Width of the visible part of the frame, without scales
+        float trimmedHeight;            // Height of the visible part of the frame, without scales
+        int hotspotX;                   // Horizontal position of the hotspot in the frame
+        int hotspotY;                   // Vertical position of the hotspot in the frame
+    };
+
+    struct CURSORMETRICS {
+        std::vector<CURSORFRAMEMETRICS> frames;     // Frames of the cursor file, in the order of the file
+        int defaultFrameIndex;                      // Frame chosen by a .cur file without the desired size (the smallest one)
+        bool isNearestSize;                         // The frame of the nearest nominal size is chosen (Xcursor), not only the one of the exact size
+
+        /**
+        * Get the frame chosen for a cursor base size and a DPI scale, like a query would.
+        *
+        * @param CursorBaseSize the cursor base size, -1 if not defined.
+        * @param DpiScale the DPI scale in percent.
+        * @param IsRealSize true if the chosen frame has the desired size, so its size is not scaled.
+        * @return The metrics of the chosen frame.
+        */
+        const CURSORFRAMEMETRICS& SelectFrame(const float& CursorBaseSize, const float& DpiScale, bool* IsRealSize) const;
+
+        /**
+        * Get the real mouse cursor size for some settings, without decoding the file again.
+        *
+        * @param CursorBaseSize the cursor base size, -1 if not defined.
+        * @param MouseScale the mouse cursor size multiplier.
+        * @param DpiScale the DPI scale in percent.
+        * @return The pair of the real mouse cursor width and height, as computed by a query with these settings.
+        */
+        std::pair<float, float> GetSize(const float& CursorBaseSize, const float& MouseScale, const float& DpiScale) const;
+
+        /**
+        * Get the real mouse cursor size for a size of the accessibility settings of Windows,
+        * whose cursor base size is 32 pixels plus 16 pixels by step above 1.
+        *
+        * @param Scale the size of the accessibility settings, from CURSOR_MIN_SCALE to CURSOR_MAX_SCALE.
+        * @param DpiScale the DPI scale in percent.
+        * @return The pair of the real mouse cursor width and height.
+        */
+        std::pair<float, float> GetSizeOfScale(const int& Scale, const float& DpiScale) const;
+
+        /**
+        * Get the real mouse cursor sizes for all the sizes of the accessibility settings of Windows.
+        *
+        * @param DpiScale the DPI scale in percent.
+        * @return The pair of the real mouse cursor width and height of each size, from CURSOR_MIN_SCALE to CURSOR_MAX_SCALE.
+        */
+        std::array<std::pair<float, float>, CURSOR_SCALES_COUNT> GetSizesOfScales(const float& DpiScale) const;
+    };
+
+    /**
+    * Analyze all the frames of a cursor file once, to get the real mouse cursor size
+    * for any settings without decoding the file again.
+    * The animated cursors (.ani) are not supported.
+    *
+    * @param Path the path of the cursor file.
+    * @param Metrics the trimmed size and the hotspot of each frame of the file.
+    * @return True if the file is a .cur or an Xcursor file with at least one frame.
+    */
+    static bool AnalyzeCursorMetrics(const std::string& Path, CURSORMETRICS* Metrics);
+
+    struct SPRITEVIEW {
+        const uint32_t* pixels;         // First pixel of the top line of the view (nullptr for an empty view)
+        ptrdiff_t stride;               // Number of pixels from a line to the line below it (negative for a bottom-up frame)
+        int width;                      // Width of the view
+        int height;                     // Height of the view
+
+        /**
+        * Get a line of the view, without any copy.
+        *
+        * @param IndexY the index of the line, from the top of the view.
+        * @return The first pixel of the line.
+        */
+        const uint32_t* GetLine(const int& IndexY) const;
+    };
+
+    struct CURSORSPRITE {
+        std::vector<uint32_t> pixels;   // Decoded pixels of the whole frame (0xAARRGGBB), lines in the order of the file
+        int frameIndex;                 // Index of the chosen frame in the file
+        int frameWidth;                 // Width of the frame
+        int frameHeight;                // Height of the frame
+        bool isBottomUp;                // The lines of the frame are stored from bottom to top
+        int trimmedLeft;                // First visible column of the frame
+        int trimmedTop;                 // First visible line of the frame, from its top
+        int trimmedWidth;               // Width of the visible part of the frame (0 if no pixel is visible)
+        int trimmedHeight;              // Height of the visible part of the frame (0 if no pixel is visible)
+        int hotspotX;                   // Horizontal position of the hotspot, from the first visible column
+        int hotspotY;                   // Vertical position of the hotspot, from the first visible line
+
+        /**
+        * Get the visible part of the frame as a view on the decoded pixels, without any copy.
+        * The view is invalidated when the pixels of the sprite are modified or released.
+        *
+        * @return The view on the visible pixels, from top to bottom.
+        */
+        SPRITEVIEW GetTrimmedView() const;
+    };
+
+    /**
+    * Decode the frame of a cursor file chosen for a desired size, and locate its visible part
+    * and its hotspot in the decoded pixels. The visible part is the bounding box of the visible pixels.
+    * The colors are decoded for the 32 bits per pixel bitmaps and the Xcursor images (premultiplied);
+    * the other frames only give the visibility of their pixels, in their alpha.
+    * The animated cursors (.ani) are not supported.
+    *
+    * @param Path the path of the cursor file.
+    * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+    * @param Sprite the decoded pixels of the chosen frame, with its visible part and its hotspot.
+    * @return True if the file is a cursor file with a supported frame.
+    */
+    static bool ExtractCursorSprite(const std::string& Path, const int& DesiredSize, CURSORSPRITE* Sprite);
+
+    struct CURSORSETTINGS {
+        std::string cursorPath;         // Purified path of the cursor file
+        float cursorBaseSize;           // Cursor base size (-1 if not defined)
+        float mouseScale;               // Mouse cursor size multiplier
+        float dpiScale;                 // DPI scale in percent
+    };
+
+    struct SETTINGSPROVIDER {
+        virtual ~SETTINGSPROVIDER() = default;
+
+        /**
+        * Read all the settings needed to compute the mouse cursor size at once.
+        * This is called once per query, concurrently by several threads.
+        *
+        * @param Settings the settings read, the capacity of its path is reused.
+        */
+        virtual void ReadSettings(CURSORSETTINGS* Settings) = 0;
+
+        /**
+        * Get the generation of the settings, which changes each time the settings may have changed.
+        * A query reuses the settings it read before while their generation stays the same.
+        * This is called once per query, concurrently by several threads, so it must be cheap.
+        *
+        * @param Generation the current generation of the settings.
+        * @return True if the generation follows the changes of the settings, false to read them at each query.
+        */
+        virtual bool GetSettingsGeneration(uint64_t* Generation);
+
+        /**
+        * Read again the settings whose changes are not followed by the generation.
+        * This is called by each query reusing the settings it read before, so it must be cheap.
+        *
+        * @param Settings the settings read before, receiving the unwatched ones.
+        */
+        virtual void ReadUnwatchedSettings(CURSORSETTINGS* Settings);
+
+        /**
+        * Read the path of the cursor file of a role of the cursor scheme (Arrow, Hand, IBeam...).
+        *
+        * @param Role the name of the role, one of REG_KEYS_CURSOR_ROLES.
+        * @param Path the purified path of the cursor file of the role, the capacity is reused.
+        * @return True if the role was resolved, false to use the cursor file of the settings.
+        */
+        virtual bool ReadRolePath(const LPCSTR& Role, std::string* Path);
+    };
+
+    /**
+    * Settings of Windows, read from the registry and from the DPI of the main monitor.
+    * Each registry key is opened once per read for all its values, and the registry values are
+    * only read again after a change notified by the registry. The DPI of the main monitor is not
+    * notified, so it is read again at each query.
+    */
+    struct REGISTRYSETTINGSPROVIDER : SETTINGSPROVIDER {
+        REGISTRYSETTINGSPROVIDER();
+        ~REGISTRYSETTINGSPROVIDER() override;
+        void ReadSettings(CURSORSETTINGS* Settings) override;
+        bool GetSettingsGeneration(uint64_t* Generation) override;
+        void ReadUnwatchedSettings(CURSORSETTINGS* Settings) override;
+        bool ReadRolePath(const LPCSTR& Role, std::string* Path) override;
+
+    private:
+        std::mutex notificationsMutex;          // Protects the notifications and the generation
+        bool isNotificationsOpened;             // The notifications were opened by the first generation requested
+        bool isWatched;                         // All the keys are watched, so the generation follows their changes
+        std::array<HKEY, 2> registryKeys;       // Keys of the cursor and accessibility settings (Windows only)
+        std::array<void*, 2> registryEvents;    // Events signaled when a key changed (Windows only)
+        uint64_t generation;                    // Number of changes notified
+    };
+
+    /**
+    * Settings of the X Window System: the XCURSOR_SIZE and XCURSOR_THEME environment
+    * variables and the Xft.dpi resource of the X resources file. The cursor file is the
+    * arrow cursor of the theme, searched in the XCURSOR_PATH directories and in the
+    * inherited themes. The theme is only searched again when the environment changed,
+    * and the X resources file is only read again when it changed.
+    */
+    struct XCURSORSETTINGSPROVIDER : SETTINGSPROVIDER {
+        XCURSORSETTINGSPROVIDER();
+        void ReadSettings(CURSORSETTINGS* Settings) override;
+
+    private:
+        std::mutex cacheMutex;              // Protects the cached settings
+        bool isCursorPathFound;             // The cursor path was searched for the cached environment
+        std::string theme;                  // XCURSOR_THEME used to search the cursor path
+        std::string searchPath;             // XCURSOR_PATH used to search the cursor path
+        std::string cursorPath;             // Path of the arrow cursor of the theme (empty if not found)
+        std::string resourcesPath;          // Path of the X resources file
+        int64_t resourcesSize;              // Size of the X resources file when read (-1 if not found)
+        int64_t resourcesModificationTime;  // Last modification time of the X resources file when read
+        float xftDpi;                       // Xft.dpi resource of the X resources file
+    };
+
+    /**
+    * Settings stored in memory, without any system call. Useful for the tests and
+    * the benchmarks, and for the programs knowing the settings by other means.
+    */
+    struct MEMORYSETTINGSPROVIDER : SETTINGSPROVIDER {
+        explicit MEMORYSETTINGSPROVIDER(const CURSORSETTINGS& Settings);
+        void SetSettings(const CURSORSETTINGS& Settings);
+        uint64_t GetReadsCount() const;
+        void ReadSettings(CURSORSETTINGS* Settings) override;
+        bool GetSettingsGeneration(uint64_t* Generation) override;
+
+    private:
+        mutable std::mutex settingsMutex;   // Protects the settings
+        CURSORSETTINGS settings;            // Settings returned by each read
+        uint64_t generation;                // Number of changes of the settings
+        std::atomic<uint64_t> readsCount;   // Number of reads since the creation
+    };
+
+    /**
+    * Change the source of the settings read by each query. The memoized size is kept
+    * until the settings read differ from the ones it was computed with.
+    *
+    * @param Provider the provider of the settings, nullptr to use the one of the platform again.
+    */
+    static void SetSettingsProvider(const std::shared_ptr<SETTINGSPROVIDER>& Provider);
+
+    struct CURSORSIZESNAPSHOT {
+        float width;                    // Real mouse cursor width with scales
+        float height;                   // Real mouse cursor height with scales
+        uint32_t version;               // Incremented each time the size changes (0 if no size was published)
+    };
+
+    /**
+    * Start a background thread publishing the mouse cursor size again each time the cursor
+    * file or the settings change. The changes are notified by the system when possible
+    * (inotify on Linux, registry notifications on Windows) and polled otherwise.
+    *
+    * @param PollInterval the maximum time in milliseconds between two checks of the settings (for example WATCHER_DEFAULT_POLL_INTERVAL).
+    * @return True if the watcher was started, false if it was already running.
+    */
+    static bool StartChangeWatcher(const uint32_t& PollInterval);
+
+    /**
+    * Stop the background thread started by StartChangeWatcher. The last published size stays readable.
+    */
+    static void StopChangeWatcher();
+
+    /**
+    * Get the mouse cursor size published by the change watcher, without any lock nor system call.
+    * This can be called every frame from any thread.
+    *
+    * @return The last published size and its version, a version of 0 if the watcher was never started.
+    */
+    static CURSORSIZESNAPSHOT GetPublishedMouseCursorSize();
+
+    // Run a task later on a thread of the program (a thread pool for example)
+    typedef std::function<void(std::function<void()> Task)> TASKEXECUTOR;
+
+    /**
+    * Get the real current mouse cursor size with scales without blocking the calling thread.
+    * The concurrent requests share the same computation while it is in progress.
+    *
+    * @param Executor the function running the computation, nullptr to run it on a new thread.
+    * @return The future pair of the real mouse cursor width and height, shared by the coalesced requests.
+    */
+    static std::shared_future<std::pair<float, float>> GetCurrentMouseCursorSizeAsync(const TASKEXECUTOR& Executor);
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+    struct CURSORSIZEAWAITABLE;
+
+    /**
+    * Get the real current mouse cursor size with scales from a coroutine, with co_await.
+    * The computation starts at once, and the coroutine is resumed on the thread of the executor.
+    *
+    * @param Executor the function running the computation, nullptr to run it on a new thread.
+    * @return The awaitable pair of the real mouse cursor width and height.
+    */
+    static CURSORSIZEAWAITABLE GetCurrentMouseCursorSizeAwaitable(const TASKEXECUTOR& Executor);
+#endif // MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+
+    struct STAGETIMINGS {
+        uint64_t count;                 // Number of runs of the stage
+        uint64_t totalNanoseconds;      // Sum of the durations of the runs
+        uint64_t maxNanoseconds;        // Longest duration of a run
+        std::array<uint64_t, STATS_HISTOGRAM_BUCKETS> histogram;   // Runs by duration, the bucket i counts the durations of [2^i, 2^(i+1)[ ns
+    };
+
+    struct INSTRUMENTATIONSNAPSHOT {
+        uint64_t calls;                 // Calls of GetCurrentMouseCursorSize
+        uint64_t cacheHits;             // Calls answered with the memoized size
+        uint64_t persistentCacheHits;   // Sizes read back from the persistent cache
+        uint64_t bytesRead;             // Bytes of the opened cursor files
+        uint64_t framesDecoded;         // Frames whose visible pixels were scanned
+        uint64_t defaultSizeFallbacks;  // Sizes computed with DEFAULT_ORIGIN_MOUSE_WIDTH and DEFAULT_ORIGIN_MOUSE_HEIGHT
+        uint64_t smallestFrameFallbacks;    // Frames chosen without the cursor base size (the smallest one, the nearest one for Xcursor)
+        std::array<STAGETIMINGS, STATS_STAGES_COUNT> stages;   // Timings of each stage (STATS_STAGE_QUERY...)
+    };
+
+    /**
+    * Get the counters and the timings of the queries since the previous snapshot, and reset them.
+    * They are only measured when MOUSE_CURSOR_SIZE_HELPER_STATS is defined, all zeros otherwise.
+    *
+    * @return The counters and the timings of each stage.
+    */
+    static INSTRUMENTATIONSNAPSHOT TakeInstrumentationSnapshot();
+
+    /**
+    * Enable or disable the tracing of the stages of the queries. Each thread records its spans
+    * in its own ring buffer, which keeps its last TRACE_RING_CAPACITY spans.
+    *
+    * @param IsEnabled true to record the spans, false to stop recording them.
+    */
+    static void SetTracingEnabled(const bool& IsEnabled);
+
+    /**
+    * Write the spans recorded since the previous flush to a file, in the trace event format
+    * of Chrome and Perfetto (chrome://tracing, ui.perfetto.dev).
+    *
+    * @param Path the path of the trace file, replaced if it exists.
+    * @return True if the trace file was written.
+    */
+    static bool FlushTrace(const std::string& Path);
+
+    struct MONITORDPI {
+        uint64_t handle;                // Handle of the monitor given by the system (HMONITOR on Windows)
+        float dpiScale;                 // DPI scale of the monitor in percent
+    };
+
+    struct MONITORPROVIDER {
+        virtual ~MONITORPROVIDER() = default;
+
+        /**
+        * Enumerate the attached monitors with their DPI scale.
+        * An empty list stands for a single monitor with the DPI scale of the settings.
+        *
+        * @param Monitors the attached monitors, the capacity of the list is reused.
+        */
+        virtual void EnumerateMonitors(std::vector<MONITORDPI>* Monitors) = 0;
+    };
+
+    /**
+    * Monitors of the system. On Windows, the effective DPI of each monitor is read
+    * from Windows 8.1 on, and the DPI of the main monitor is used for all of them before.
+    * On other platforms, the list is empty and the DPI scale of the settings is used.
+    */
+    struct SYSTEMMONITORPROVIDER : MONITORPROVIDER {
+        void EnumerateMonitors(std::vector<MONITORDPI>* Monitors) override;
+    };
+
+    /**
+    * Monitors stored in memory, to drive the table of the sizes by monitor
+    * on any platform, for example in tests.
+    */
+    struct MEMORYMONITORPROVIDER : MONITORPROVIDER {
+        explicit MEMORYMONITORPROVIDER(const std::vector<MONITORDPI>& Monitors);
+        void SetMonitors(const std::vector<MONITORDPI>& Monitors);
+        void EnumerateMonitors(std::vector<MONITORDPI>* Monitors) override;
+
+    private:
+        std::mutex monitorsMutex;           // Protects the monitors
+        std::vector<MONITORDPI> monitors;   // Monitors returned by each enumeration
+    };
+
+    /**
+    * Change the source of the monitors of the table of the sizes by monitor.
+    * The table is only built again by the next call of UpdateMonitorCursorSizes.
+    *
+    * @param Provider the provider of the monitors, nullptr to use the one of the system again.
+    */
+    static void SetMonitorProvider(const std::shared_ptr<MONITORPROVIDER>& Provider);
+
+    struct MONITORCURSORSIZES {
+        std::vector<MONITORDPI> monitors;                       // Attached monitors, by index
+        std::vector<std::pair<float, float>> monitorSizes;      // Real mouse cursor size on each monitor, by index of the monitor
+        std::array<std::pair<float, float>, MONITOR_MAX_DPI_SCALE + 1> dpiScaleSizes;   // Real mouse cursor size by DPI scale in percent ({0, 0} if no monitor has this scale)
+        std::bitset<MONITOR_MAX_DPI_SCALE + 1> dpiScaleComputed;                        // DPI scales in percent whose size is computed in dpiScaleSizes
+
+        /**
+        * Get the real mouse cursor size on a monitor.
+        *
+        * @param MonitorIndex the index of the monitor in the list of the attached monitors.
+        * @return The pair of the real mouse cursor width and height on the monitor, the one of the first monitor if the index is out of the list.
+        */
+        std::pair<float, float> GetSizeOfMonitor(const size_t& MonitorIndex) const;
+
+        /**
+        * Get the real mouse cursor size for a DPI scale of an attached monitor.
+        *
+        * @param DpiScale the DPI scale in percent, rounded to the nearest integer.
+        * @return The pair of the real mouse cursor width and height, {0, 0} if no monitor has this DPI scale.
+        */
+        std::pair<float, float> GetSizeOfDpiScale(const float& DpiScale) const;
+
+        /**
+        * Find a monitor by its handle, to keep its index for the next lookups.
+        *
+        * @param Handle the handle of the monitor given by the system.
+        * @return The index of the monitor, -1 if it is not attached.
+        */
+        int FindMonitor(const uint64_t& Handle) const;
+    };
+
+    /**
+    * Build again the table of the real mouse cursor size on each attached monitor.
+    * The size is computed once for each distinct DPI scale, the frame of the cursor
+    * file being chosen for this scale. A scale above MONITOR_MAX_DPI_SCALE is computed
+    * for each of its monitors and isn't found by GetSizeOfDpiScale. Call it when a monitor is attached or detached,
+    * or when its DPI changed (WM_DISPLAYCHANGE and WM_DPICHANGED on Windows).
+    * The change watcher builds the table again when the settings change.
+    *
+    * @return The new table, whose lookups are a single array index.
+    */
+    static std::shared_ptr<const MONITORCURSORSIZES> UpdateMonitorCursorSizes();
+
+    /**
+    * Get the table of the real mouse cursor size on each attached monitor,
+    * built on the first call. The table is immutable and can be kept by the caller
+    * until the next update.
+    *
+    * @return The current table, whose lookups are a single array index.
+    */
+    static std::shared_ptr<const MONITORCURSORSIZES> GetMonitorCursorSizes();
+
+    struct RGBAIMAGE {
+        std::vector<uint8_t> pixels;    // Red, green, blue and alpha bytes of each pixel, from top to bottom, not premultiplied
+        int width;                      // Width of the image
+        int height;                     // Height of the image
+    };
+
+    /**
+    * Resample an image to another size, for example to scale a custom cursor to the size of the
+    * system cursor. The colors are premultiplied by their alpha while they are filtered, so the
+    * transparent pixels don't bleed their color. The rows of the large images are resampled
+    * on several threads.
+    *
+    * @param Source the image to resample.
+    * @param Width the width of the resampled image.
+    * @param Height the height of the resampled image.
+    * @param Filter the resampling filter (RESAMPLE_FILTER_BOX, RESAMPLE_FILTER_BILINEAR or RESAMPLE_FILTER_LANCZOS).
+    * @param Destination the resampled image.
+    * @return True if the images and the filter are valid.
+    */
+    static bool ResampleImage(const RGBAIMAGE& Source, const int& Width, const int& Height, const int& Filter, RGBAIMAGE* Destination);
+
+    /**
+    * Resample an image to the real current mouse cursor size with scales.
+    *
+    * @param Source the image to resample, trimmed to its visible pixels.
+    * @param Filter the resampling filter (RESAMPLE_FILTER_BOX, RESAMPLE_FILTER_BILINEAR or RESAMPLE_FILTER_LANCZOS).
+    * @param Destination the image resampled to the size returned by GetCurrentMouseCursorSize.
+    * @return True if the images and the filter are valid.
+    */
+    static bool ResampleImageToCursorSize(const RGBAIMAGE& Source, const int& Filter, RGBAIMAGE* Destination);
+
 private:
+    friend class CursorSizeBenchmark; // Times the stages of a query separately (Tools/CursorSizeBenchmark.cpp)
+
     struct BITMAPINFOHEADER {
         uint32_t biSize;                // Header size
         int32_t biWidth;                // Picture width
@@ -82,6 +723,32 @@ private:
         uint16_t idCount;		        // Number of pictures in file
     };
 
+    struct BYTEVIEW {
+        const uint8_t* data;            // First byte of the view
+        size_t size;                    // Number of bytes in the view
+    };
+
+    struct MAPPEDFILE {
+        BYTEVIEW view;                  // Datas of the whole file
+        bool isMapped;                  // The datas are mapped instead of read in the buffer
+        void* fileHandle;               // Handle of the mapped file (Windows only)
+        void* mappingHandle;            // Handle of the mapping (Windows only)
+        std::vector<uint8_t> buffer;    // Datas of the file when it can't be mapped
+    };
+
+    struct FRAMEVIEW {
+        BYTEVIEW pixels;                // Colors (and alpha channel at 32 bits per pixel) of the pixels
+        BYTEVIEW mask;                  // AND mask of the pixels (1 bit per pixel)
+        size_t maskStride;              // Number of bytes of a line of the mask
+        BYTEVIEW png;                   // Whole PNG picture (empty for a bitmap picture)
+        BYTEVIEW palette;               // Colors of the palette, 4 bytes per color (empty above 8 bits per pixel)
+        size_t pixelsStride;            // Number of bytes of a line of the pixels
+        int bitCount;                   // Bits per pixel of the bitmap (1, 4, 8, 24 or 32)
+        int index;                      // Index of the picture in the cursor file
+        int hotspotX;                   // Horizontal position of the hotspot
+        int hotspotY;                   // Vertical position of the hotspot
+    };
+
     struct FIRSTLASTINDEXES {
         int lastYValue;                 // Last Y value saved
         int firstIndexHeight;           // First index of height
@@ -96,28 +763,813 @@ private:
         int width;                      // Picture width
         int height;                     // Picture height
         bool isRealSize;                // The corresponding size was found
+        bool isBottomUp;                // The lines of the picture are stored from bottom to top
+        int hotspotX;                   // Horizontal position of the hotspot of the chosen frame
+        int hotspotY;                   // Vertical position of the hotspot of the chosen frame
+    };
+
+    struct CURSORFINGERPRINT {
+        CURSORSETTINGS settings;        // Settings used to compute the size
+        int64_t fileSize;               // Size of the cursor file (-1 if not found)
+        int64_t fileModificationTime;   // Last modification time of the cursor file
+    };
+
+    struct CURSORSIZECACHE {
+        bool isValid;                   // The memoized size can be used
+        uint64_t generation;            // Number of invalidations, a size computed before one of them is not memoized
+        CURSORFINGERPRINT fingerprint;  // Fingerprint of the memoized size
+        std::pair<float, float> size;   // Memoized mouse cursor size
+    };
+
+    struct CHANGEWATCHER {
+        std::thread thread;                     // Thread waiting for the changes
+        std::atomic<bool> isRunning;            // The thread keeps watching
+        uint32_t pollInterval;                  // Maximum time in milliseconds between two checks of the settings
+        std::string watchedDirectory;           // Directory of the watched cursor file
+        int wakeDescriptor;                     // Event descriptor waking the thread up (Linux only)
+        int notifyDescriptor;                   // Inotify instance (Linux only)
+        int directoryWatch;                     // Inotify watch of the directory of the cursor file (Linux only)
+        int resourcesWatch;                     // Inotify watch of the directory of the X resources file (Linux only)
+        void* wakeEvent;                        // Event waking the thread up (Windows only)
+        std::array<HKEY, 2> registryKeys;       // Keys of the cursor and accessibility settings (Windows only)
+        std::array<void*, 2> registryEvents;    // Events signaled when a key changed (Windows only)
+        void* directoryNotification;            // Change notification of the directory of the cursor file (Windows only)
+        std::mutex wakeMutex;                   // Protects the wake request (other systems)
+        std::condition_variable wakeCondition;  // Signaled to wake the thread up (other systems)
+        bool isWakeRequested;                   // The thread must check the settings again (other systems)
+
+        ~CHANGEWATCHER();
+    };
+
+    struct ASYNCQUERY {
+        std::promise<std::pair<float, float>> promise;      // Promise of the computed size
+        std::shared_future<std::pair<float, float>> result; // Future of the size, shared by the coalesced requests
+        std::vector<std::function<void()>> continuations;   // Functions run once the size is computed (awaiting coroutines)
+        bool isDone;                                        // The size was computed, protected by AsyncQueryMutex
+    };
+
+    struct ASYNCTHREADS {
+        std::mutex mutex;                       // Protects the number of running threads
+        std::condition_variable condition;      // Signaled when a thread ends
+        size_t runningCount;                    // Number of threads started by the default executor and still running
+
+        ~ASYNCTHREADS();
+    };
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+    struct STAGECOUNTERS {
+        std::atomic<uint64_t> count;                // Number of runs of the stage
+        std::atomic<uint64_t> totalNanoseconds;     // Sum of the durations of the runs
+        std::atomic<uint64_t> maxNanoseconds;       // Longest duration of a run
+        std::array<std::atomic<uint64_t>, STATS_HISTOGRAM_BUCKETS> histogram;  // Runs by power of 2 of their duration in nanoseconds
+    };
+
+    struct INSTRUMENTATIONCOUNTERS {
+        std::atomic<uint64_t> calls;                    // Calls of GetCurrentMouseCursorSize
+        std::atomic<uint64_t> cacheHits;                // Calls answered with the memoized size
+        std::atomic<uint64_t> persistentCacheHits;      // Sizes read back from the persistent cache
+        std::atomic<uint64_t> bytesRead;                // Bytes of the opened cursor files
+        std::atomic<uint64_t> framesDecoded;            // Frames whose visible pixels were scanned
+        std::atomic<uint64_t> defaultSizeFallbacks;     // Sizes computed with the default size
+        std::atomic<uint64_t> smallestFrameFallbacks;   // Frames chosen without the cursor base size
+        std::array<STAGECOUNTERS, STATS_STAGES_COUNT> stages;  // Timings of each stage
+    };
+
+    struct STAGETIMER {
+        int stage;                                      // Timed stage (STATS_STAGE_QUERY...)
+        std::chrono::steady_clock::time_point start;    // Start of the run
+
+        explicit STAGETIMER(const int& Stage);
+        ~STAGETIMER();
+    };
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+
+    struct RESAMPLEWEIGHTS {
+        std::vector<int> starts;        // First source index of each destination index
+        std::vector<float> weights;     // Weights of the source indexes of each destination index, tapsCount per destination index
+        int tapsCount;                  // Number of source indexes of each destination index
+    };
+
+    struct TRACEEVENT {
+        std::atomic<uint64_t> start;            // Start of the span in nanoseconds of the steady clock
+        std::atomic<uint64_t> duration;         // Duration of the span in nanoseconds
+        std::atomic<uint64_t> bytes;            // Bytes processed by the span (0 if none)
+        std::atomic<uint32_t> name;             // Name of the span (TRACE_EVENT_QUERY...)
+        std::atomic<uint32_t> threadId;         // Identifier of the thread in the trace
+    };
+
+    struct TRACERING {
+        std::array<TRACEEVENT, TRACE_RING_CAPACITY> events;    // Last spans of the thread, by index modulo the capacity
+        std::atomic<uint64_t> startIndex;       // Number of spans started in the ring, only incremented by its thread
+        std::atomic<uint64_t> writeIndex;       // Number of spans completely written in the ring, only incremented by its thread
+        uint64_t flushedIndex;                  // Number of spans written before the last flush, protected by TraceMutex
+        std::atomic<bool> isOwned;              // A thread records its spans in the ring
+    };
+
+    struct TRACETHREAD {
+        TRACERING* ring;                        // Ring of the thread (nullptr before its first span)
+        uint32_t threadId;                      // Identifier of the thread in the trace
+
+        ~TRACETHREAD();
+    };
+
+    struct TRACESPAN {
+        int name;                               // Name of the span (TRACE_EVENT_QUERY...), -1 if the tracing is disabled
+        uint64_t start;                         // Start of the span in nanoseconds of the steady clock
+        uint64_t bytes;                         // Bytes processed by the span, set by the traced code
+
+        explicit TRACESPAN(const int& Name);
+        ~TRACESPAN();
+    };
+
+    struct PERSISTENTCACHEHEADER {
+        uint32_t magic;                 // PERSISTENT_CACHE_MAGIC
+        uint32_t version;               // PERSISTENT_CACHE_VERSION
+        uint32_t slotsCount;            // Number of records following the header (PERSISTENT_CACHE_SLOTS)
+        uint32_t reserved;              // Always 0
+    };
+
+    struct CURSORSIZERECORD {
+        uint64_t keyHash;               // Hash of the cursor path and of the settings (0 for an empty slot)
+        uint64_t pathHash;              // Hash of the cursor path from PATH_HASH_SEED, to tell apart the paths whose key hashes collide
+        int64_t fileSize;               // Size of the cursor file
+        int64_t fileModificationTime;   // Last modification time of the cursor file
+        uint64_t contentHash;           // Hash of the content of the cursor file
+        float cursorBaseSize;           // Cursor base size (-1 if not defined)
+        float mouseScale;               // Mouse cursor size multiplier
+        float dpiScale;                 // DPI scale in percent
+        float baseWidth;                // Trimmed width of the cursor picture, without scales
+        float baseHeight;               // Trimmed height of the cursor picture, without scales
+        float width;                    // Real mouse cursor width with scales
+        float height;                   // Real mouse cursor height with scales
+        int32_t hotspotX;               // Horizontal position of the hotspot of the chosen frame
+        int32_t hotspotY;               // Vertical position of the hotspot of the chosen frame
+        uint32_t isRealSize;            // 1 if the chosen frame has the desired size
+        uint32_t pathLength;            // Number of characters of the cursor path
+        uint32_t reserved;              // Always 0
     };
 
-    static FIRSTLASTINDEXES InitFirstLastIndexesStruct();
-    static int GetIndexOfSmallestPicture(const std::vector<ICONDIRENTRY>& Pictures);
-    static int GetIndexOfDesiredFrame(const std::vector<ICONDIRENTRY>& Pictures, SIZEDATA* SizeData);
-    static void InvertArrayHeight(std::vector<uint32_t>* Array, const SIZEDATA& SizeData);
-    static std::vector<uint32_t> ExtractPixels(std::ifstream& File, const BITMAPINFOHEADER& BmpHeader, SIZEDATA* SizeData);
-    static std::vector<uint32_t> GetCursorFileDatas(std::ifstream& File, const ICONDIR& Header, SIZEDATA* SizeData);
-    static std::vector<uint32_t> GetPixelArrayOfCurrentMouseImage(SIZEDATA* SizeData);
+    struct ANIHEADER {
+        uint32_t cbSize;                // Header size
+        uint32_t nFrames;               // Number of stored frames
+        uint32_t nSteps;                // Number of steps of the animation
+        uint32_t iWidth;                // Frames width (raw frames only)
+        uint32_t iHeight;               // Frames height (raw frames only)
+        uint32_t iBitCount;             // Bits per pixel (raw frames only)
+        uint32_t nPlanes;               // Number of planes (raw frames only)
+        uint32_t iDispRate;             // Default display rate in jiffies
+        uint32_t bfAttributes;          // ANI_FLAG_ICON_FRAMES if the frames are cursor files
+    };
+
+    struct RIFFCHUNK {
+        const uint8_t* id;              // Four characters identifier of the chunk
+        BYTEVIEW datas;                 // Datas of the chunk, without the padding byte
+    };
+
+    struct XCURSORSIZE {
+        uint32_t nominalSize;           // Nominal size of the images
+        int tocIndex;                   // Index in the table of contents of the first image of this size
+        uint32_t position;              // Position in the file of the first image of this size
+        uint32_t imagesCount;           // Number of images of this size (frames of an animation)
+    };
+
+    struct XCURSORINDEX {
+        std::array<XCURSORSIZE, XCURSOR_MAX_NOMINAL_SIZES> sizes;  // Nominal sizes in the order of the table of contents
+        int sizesCount;                 // Number of nominal sizes
+    };
+
+    struct ANIINDEX {
+        ANIHEADER header;               // Header of the animation
+        std::vector<BYTEVIEW> frames;   // Views on the cursor files of the frames, not decoded
+        BYTEVIEW rates;                 // Display rate of each step (empty if not defined)
+        BYTEVIEW sequence;              // Frame index of each step (empty if not defined)
+    };
+
+    struct BOUNDINGBOX {
+        int left;                       // First visible column, relative to the hotspot
+        int top;                        // First visible line, relative to the hotspot
+        int right;                      // Last visible column, relative to the hotspot
+        int bottom;                     // Last visible line, relative to the hotspot
+        bool isEmpty;                   // There is no visible pixel
+    };
+
+    struct PNGHEADER {
+        uint32_t width;                 // Picture width
+        uint32_t height;                // Picture height
+        uint8_t bitDepth;               // Bits per sample (or per palette index)
+        uint8_t colorType;              // 0 gray, 2 RGB, 3 palette, 4 gray and alpha, 6 RGB and alpha
+        uint8_t compression;            // Always 0 (deflate)
+        uint8_t filter;                 // Always 0 (adaptive filtering)
+        uint8_t interlace;              // 0 for no interlace, 1 for Adam7
+    };
+
+    struct HUFFMANTABLE {
+        std::array<uint16_t, 512> fastSymbols;  // Symbol and length of the codes of 9 bits at most, by reversed code
+        std::array<uint16_t, 16> counts;        // Number of codes of each length
+        std::array<uint16_t, 288> symbols;      // Symbols sorted by code
+    };
+
+    struct INFLATESTATE {
+        BYTEVIEW png;                   // Whole PNG picture containing the compressed datas
+        size_t inputOffset;             // Offset of the next compressed byte in the picture
+        size_t chunkEnd;                // End of the datas of the current IDAT chunk
+        bool isInputAvailable;          // More IDAT chunks can follow
+        uint64_t bitBuffer;             // Compressed bits read but not consumed yet
+        int bitCount;                   // Number of bits in the bit buffer
+        bool isInBlock;                 // A block is being decompressed
+        bool isFinalBlock;              // The current block is the last one
+        int blockType;                  // 0 for stored, 1 for fixed codes, 2 for dynamic codes
+        size_t storedRemaining;         // Bytes left in the current stored block
+        size_t matchRemaining;          // Bytes left to copy from the window for the current match
+        size_t matchDistance;           // Distance of the current match in the window
+        HUFFMANTABLE literals;          // Codes of the literals and lengths of the current block
+        HUFFMANTABLE distances;         // Codes of the distances of the current block
+        uint8_t* window;                // Last decompressed bytes (INFLATE_WINDOW_SIZE bytes)
+        size_t outputCount;             // Number of decompressed bytes
+    };
+
+public:
+    struct QUERYWORKSPACE {
+        CURSORFINGERPRINT fingerprint;          // Fingerprint of the last query
+        std::shared_ptr<SETTINGSPROVIDER> settingsProvider;  // Provider of the settings of the fingerprint, nullptr to read them again
+        uint64_t settingsGeneration;            // Generation of the settings of the fingerprint
+        std::vector<uint8_t> pngLines;          // Current and previous lines of a PNG picture, followed by their alpha channel
+        std::vector<uint8_t> inflateWindow;     // Last decompressed bytes of a PNG picture
+    };
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+    struct CURSORSIZEAWAITABLE {
+        std::shared_ptr<ASYNCQUERY> query;      // Computation awaited, shared by the coalesced requests
+
+        bool await_ready() const;
+        bool await_suspend(std::coroutine_handle<> Handle) const;
+        std::pair<float, float> await_resume() const;
+    };
+#endif // MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+
+private:
+
+    // Get the first and last valid pixels of a line, returns false if there is none
+    typedef bool (*LINESCANFUNCTION)(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex);
+
+    static const std::array<uint8_t, 256> MaskExpansionTable;
+    static const std::array<uint32_t, 256> MaskNibblesExpansionTable;
+
+    static std::mutex CacheMutex;
+    static CURSORSIZECACHE SizeCache;
+    static std::atomic<uint64_t> CacheHits;
+    static std::atomic<uint64_t> CacheMisses;
+    static std::mutex PersistentCacheMutex;
+    static std::string PersistentCachePath;
+    static std::mutex SettingsProviderMutex;
+    static std::shared_ptr<SETTINGSPROVIDER> CurrentSettingsProvider;
+    static std::mutex WatcherMutex;
+    static CHANGEWATCHER Watcher;
+    static std::atomic<uint64_t> PublishedSize;
+    static std::mutex AsyncQueryMutex;
+    static std::shared_ptr<ASYNCQUERY> InFlightQuery;
+    static ASYNCTHREADS AsyncThreads;
+    static std::mutex MonitorMutex;
+    static std::shared_ptr<MONITORPROVIDER> CurrentMonitorProvider;
+    static std::shared_ptr<const MONITORCURSORSIZES> MonitorSizes;
+    static std::atomic<bool> IsTracingEnabled;
+    static std::mutex TraceMutex;
+    static std::vector<std::unique_ptr<TRACERING>> TraceRings;
+    static std::atomic<uint32_t> TraceThreadsCount;
+    static const std::array<const char*, TRACE_EVENTS_COUNT> TraceEventNames;
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+    static INSTRUMENTATIONCOUNTERS Instrumentation;
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+
+    static std::pair<float, float> ComputeCurrentMouseCursorSize(const CURSORSETTINGS& Settings, QUERYWORKSPACE* Workspace, CURSORSIZERECORD* Record);
+    static bool LoadPersistentCursorSize(const CURSORFINGERPRINT& Fingerprint, std::pair<float, float>* CursorSize);
+    static void StorePersistentCursorSize(const CURSORFINGERPRINT& Fingerprint, CURSORSIZERECORD* Record);
+    static void InitPersistentRecordKey(const CURSORFINGERPRINT& Fingerprint, CURSORSIZERECORD* Record);
+    static bool IsValidPersistentCache(const BYTEVIEW& Cache);
+    static bool FindPersistentRecord(const BYTEVIEW& Cache, const CURSORSIZERECORD& Key, size_t* Slot);
+    static void WritePersistentRecord(const CURSORSIZERECORD& Record);
+    static bool GetFileContentHash(const std::string& Path, uint64_t* ContentHash);
+    static uint64_t HashBytes(const uint8_t* Bytes, const size_t& Size, const uint64_t& Seed);
+    static bool ReplaceFileAtomically(const std::string& Path, const std::vector<uint8_t>& Datas);
+    static std::shared_ptr<SETTINGSPROVIDER> GetSettingsProvider();
+    static std::shared_ptr<MONITORPROVIDER> GetMonitorProvider();
+    static void RefreshMonitorCursorSizes();
+#ifdef _WIN32
+    static BOOL CALLBACK AddEnumeratedMonitor(HMONITOR Monitor, HDC Hdc, LPRECT Rect, LPARAM Data);
+#endif // _WIN32
+    static void RunChangeWatcher();
+    static void PublishMouseCursorSize(const std::pair<float, float>& CursorSize);
+    static void WakeChangeWatcher();
+    static void SignalChangeWatcher();
+    static void OpenChangeNotifications();
+    static void CloseChangeNotifications();
+    static void WatchCursorDirectory(const std::string& CursorPath);
+    static bool WaitForChange();
+    static std::shared_ptr<ASYNCQUERY> StartAsyncQuery(const TASKEXECUTOR& Executor);
+    static void RunAsyncQuery(const std::shared_ptr<ASYNCQUERY>& Query);
+    static void CompleteAsyncQuery(const std::shared_ptr<ASYNCQUERY>& Query, const std::pair<float, float>& CursorSize, const std::exception_ptr& Error);
+    static bool AddAsyncQueryContinuation(const std::shared_ptr<ASYNCQUERY>& Query, const std::function<void()>& Continuation);
+    static void RunOnNewThread(const std::function<void()>& Task);
+    static uint64_t GetTraceTime();
+    static void RecordTraceEvent(const int& Name, const uint64_t& Start, const uint64_t& Bytes);
+    static void AcquireTraceRing(TRACETHREAD* Thread);
+#ifdef MOUSE_CURSOR_SIZE_HELPER_STATS
+    static void RecordStageTime(const int& Stage, const uint64_t& Nanoseconds);
+    static uint64_t TakeCounter(std::atomic<uint64_t>* Counter);
+#endif // MOUSE_CURSOR_SIZE_HELPER_STATS
+    static void ReadCursorSettings(CURSORSETTINGS* Settings);
+    static void ReadCursorSettings(SETTINGSPROVIDER& Provider, CURSORSETTINGS* Settings);
+    static void ReadCurrentFingerprint(QUERYWORKSPACE* Workspace);
+    static bool IsSameFingerprint(const CURSORFINGERPRINT& First, const CURSORFINGERPRINT& Second);
+    static constexpr FIRSTLASTINDEXES InitFirstLastIndexesStruct();
+    static int GetIndexOfSmallestPicture(const BYTEVIEW& Directory, const int& Count);
+    static int GetIndexOfDesiredFrame(const BYTEVIEW& Directory, const int& Count, const CURSORSETTINGS& Settings, SIZEDATA* SizeData);
+    static bool GetCursorFrameOfEntry(const BYTEVIEW& File, const BYTEVIEW& Directory, const int& FrameIndex, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static CURSORFRAMEMETRICS ComputeFrameMetrics(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, const int& NominalSize, QUERYWORKSPACE* Workspace);
+    static void InvertArrayHeight(std::vector<uint32_t>* Array, SIZEDATA* SizeData);
+    static bool GetFrameView(const BYTEVIEW& Image, const BITMAPINFOHEADER& BmpHeader, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static std::vector<uint32_t> ExtractPixels(const FRAMEVIEW& Frame, const SIZEDATA& SizeData);
+    static bool GetCursorFrame(const BYTEVIEW& File, const CURSORSETTINGS& Settings, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static std::vector<uint32_t> GetCursorFileDatas(const BYTEVIEW& File, const CURSORSETTINGS& Settings, SIZEDATA* SizeData);
+    static std::pair<float, float> GetCursorSizeOfCurrentMouseImage(const CURSORSETTINGS& Settings, SIZEDATA* SizeData, QUERYWORKSPACE* Workspace);
+    static bool IsXcursorFile(const BYTEVIEW& File);
+    static bool IndexXcursorFile(const BYTEVIEW& File, XCURSORINDEX* Index);
+    static int GetIndexOfNearestXcursorSize(const XCURSORINDEX& Index, const CURSORSETTINGS& Settings, SIZEDATA* SizeData);
+    static bool GetXcursorFrameView(const BYTEVIEW& File, const XCURSORSIZE& Size, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static bool GetXcursorFrame(const BYTEVIEW& File, const CURSORSETTINGS& Settings, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static bool IsAnimatedCursorFile(const BYTEVIEW& File);
+    static bool ReadRiffChunk(const BYTEVIEW& View, size_t* Offset, RIFFCHUNK* Chunk);
+    static bool IsChunkId(const uint8_t* Id, const char* ExpectedId);
+    static bool ReadAniHeader(const BYTEVIEW& Datas, ANIHEADER* Header);
+    static bool IndexAnimatedCursor(const BYTEVIEW& File, ANIINDEX* Index);
+    static std::vector<uint32_t> GetUsedFramesOfAnimation(const ANIINDEX& Index);
+    static bool ComputeAnimatedCursorSize(const BYTEVIEW& File, const CURSORSETTINGS& Settings, SIZEDATA* SizeData, std::pair<float, float>* CursorSize);
+    static BOUNDINGBOX ComputeFrameBoundingBox(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace);
+    static void MergeBoundingBoxes(const BOUNDINGBOX& Box, BOUNDINGBOX* Union);
+    static bool IsPngPicture(const BYTEVIEW& Image);
+    static uint32_t ReadUInt32BigEndian(const uint8_t* Bytes);
+    static bool ReadPngHeader(const BYTEVIEW& Image, PNGHEADER* Header);
+    static bool GetPngFrameView(const BYTEVIEW& Image, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    template <typename ROWFUNCTION>
+    static bool DecodePngAlphaRows(const BYTEVIEW& Png, QUERYWORKSPACE* Workspace, const ROWFUNCTION& ProcessRow);
+    static bool UnfilterPngRow(const uint8_t& Filter, uint8_t* Row, const uint8_t* PreviousRow, const size_t& RowSize, const size_t& PixelSize);
+    static void ExtractPngAlpha(const uint8_t* Row, const PNGHEADER& Header, const BYTEVIEW& Transparency, uint8_t* Alpha);
+    static uint16_t ReadPngSample(const uint8_t* Row, const size_t& Index, const int& BitDepth);
+    static std::array<uint8_t, 256> BuildPaletteVisibilityTable(const FRAMEVIEW& Frame);
+    static uint8_t GetVisiblePixelsByte(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const uint8_t* Line, const uint8_t* MaskLine, const int& Width, const int& ByteIndex);
+    static bool IsMaskedBlackRun(const FRAMEVIEW& Frame, const uint8_t* Line, const uint8_t* MaskLine, const int& ByteIndex);
+    static bool IsZeroBytes(const uint8_t* Bytes, const size_t& Count);
+    static bool IsVisibleLowDepthPixel(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const uint8_t* Line, const int& IndexX);
+    static bool ScanLowDepthLine(const FRAMEVIEW& Frame, const std::array<uint8_t, 256>& PaletteTable, const int& Width, const int& LineIndex, int* FirstIndex, int* LastIndex);
+    static std::pair<float, float> ComputeCursorSizeFromLowDepthFrame(const FRAMEVIEW& Frame, const SIZEDATA& SizeData);
+    static std::pair<float, float> ComputeCursorSizeFromPng(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace);
+    static bool ScanAlphaLine(const uint8_t* Alpha, const int& Width, int* FirstIndex, int* LastIndex);
+    static void InitInflateState(const BYTEVIEW& Png, const size_t& Offset, const size_t& Size, uint8_t* Window, INFLATESTATE* State);
+    static bool ReadNextInflateByte(INFLATESTATE* State, uint8_t* Byte);
+    static void RefillInflateBits(INFLATESTATE* State);
+    static bool ReadInflateBits(INFLATESTATE* State, const int& Count, uint32_t* Bits);
+    static bool BuildHuffmanTable(const uint8_t* Lengths, const int& Count, HUFFMANTABLE* Table);
+    static bool DecodeHuffmanSymbol(INFLATESTATE* State, const HUFFMANTABLE& Table, int* Symbol);
+    static bool ReadInflateBlockHeader(INFLATESTATE* State);
+    static bool Inflate(INFLATESTATE* State, uint8_t* Output, const size_t& Count);
+    static bool OpenMappedFile(const std::string& Path, MAPPEDFILE* File);
+    static void CloseMappedFile(MAPPEDFILE* File);
+    static bool GetSubView(const BYTEVIEW& View, const size_t& Offset, const size_t& Size, BYTEVIEW* SubView);
+    static constexpr uint16_t ReadUInt16(const uint8_t* Bytes);
+    static constexpr uint32_t ReadUInt32(const uint8_t* Bytes);
+    static bool ReadIconDir(const BYTEVIEW& File, ICONDIR* Header);
+    static bool ReadIconDirEntry(const BYTEVIEW& Directory, const int& Index, ICONDIRENTRY* Entry);
+    static bool ReadBitmapInfoHeader(const BYTEVIEW& Image, BITMAPINFOHEADER* BmpHeader);
     static std::pair<float, float> ComputeCursorSizeFromPixelArray(const std::vector<uint32_t>& PixelArray, const SIZEDATA& SizeData);
-    static void GetFirstAndLastIndexesFromPixel(const uint8_t& Alpha, FIRSTLASTINDEXES* IndexesStruct, const int& IndexX, const int& IndexY);
-    static void ScaleCursorSizeByMouseSystemScale(std::pair<float, float>* CursorSize);
-    static void ScaleCursorSizeByDPI(std::pair<float, float>* CursorSize);
-    static float GetMouseCursorScale();
+    static std::pair<float, float> ComputeCursorSizeFromFrame(const FRAMEVIEW& Frame, const SIZEDATA& SizeData, QUERYWORKSPACE* Workspace);
+    static std::pair<float, float> ComputeCursorSizeFromLines(const uint8_t* Pixels, const uint8_t* Mask, const size_t& MaskStride, const SIZEDATA& SizeData);
+    static bool ScanLineFromMask(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex, bool* IsMaskConsistent);
+    static bool ScanMaskLine(const uint8_t* MaskLine, const uint8_t* ColorLine, const uint32_t& ColoredOnes, const uint32_t& ColoredZeros, const int& Width, int* FirstIndex, int* LastIndex);
+    static uint32_t GetMaskWordCoverage(const uint8_t* MaskLine, const uint8_t* ColorLine, const uint32_t& ColoredOnes, const uint32_t& ColoredZeros, const int& Width, const int& WordIndex);
+    static constexpr void GetFirstAndLastIndexesFromLine(const int& FirstIndex, const int& LastIndex, FIRSTLASTINDEXES* IndexesStruct, const int& IndexY);
+    static LINESCANFUNCTION GetLineScanFunction();
+    static constexpr std::array<uint8_t, 256> BuildMaskExpansionTable();
+    static bool IsValidPixel(const uint8_t* Line, const uint8_t* MaskLine, const int& IndexX);
+    static uint32_t GetUnmaskedPixelsBits(const uint8_t* MaskLine, const int& IndexX);
+    static bool ScanLineScalar(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex);
+    static bool IsAvx2Supported();
+    static uint32_t GetValidPixelsMaskSse2(const uint8_t* Pixels);
+    static bool ScanLineSse2(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex);
+    static uint32_t GetValidPixelsMaskAvx2(const uint8_t* Pixels);
+    static bool ScanLineAvx2(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex);
+    static constexpr std::array<uint32_t, 256> BuildMaskNibblesExpansionTable();
+    static uint64_t GetUnmaskedPixelsNibbles(const uint8_t* MaskLine, const int& IndexX);
+    static uint64_t GetValidPixelsMaskNeon(const uint8_t* Pixels);
+    static bool ScanLineNeon(const uint8_t* Line, const uint8_t* MaskLine, const int& Width, int* FirstIndex, int* LastIndex);
+    static int CountTrailingZeros(const uint32_t& Value);
+    static int CountLeadingZeros(const uint32_t& Value);
+    static int CountTrailingZeros64(const uint64_t& Value);
+    static int CountLeadingZeros64(const uint64_t& Value);
+    static void ScaleCursorSizeByMouseSystemScale(std::pair<float, float>* CursorSize, const float& MouseScale);
+    static void ScaleCursorSizeByDPI(std::pair<float, float>* CursorSize, const float& DpiScale);
+    static void RunInParallel(const size_t& Count, const std::function<void(size_t)>& Task);
+    static void RunRowsInParallel(const int& RowsCount, const bool& IsParallel, const std::function<void(int, int)>& Rows);
+    static float GetResampleFilterRadius(const int& Filter);
+    static float GetResampleFilterValue(const int& Filter, const float& Distance);
+    static void BuildResampleWeights(const int& SourceSize, const int& DestinationSize, const int& Filter, RESAMPLEWEIGHTS* Weights);
+    static void PremultiplyRow(const uint8_t* Pixels, const int& Width, float* Row);
+    static void UnpremultiplyRow(const float* Row, const int& Width, uint8_t* Pixels);
+    static void ResampleRowHorizontally(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination);
+    static void AccumulateRow(const float* Row, const float& Weight, const size_t& Count, float* Destination);
+    static void PremultiplyRowSse2(const uint8_t* Pixels, const int& Width, float* Row);
+    static void ResampleRowHorizontallySse2(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination);
+    static void AccumulateRowSse2(const float* Row, const float& Weight, const size_t& Count, float* Destination);
+    static void PremultiplyRowNeon(const uint8_t* Pixels, const int& Width, float* Row);
+    static void ResampleRowHorizontallyNeon(const float* Row, const RESAMPLEWEIGHTS& Weights, float* Destination);
+    static void AccumulateRowNeon(const float* Row, const float& Weight, const size_t& Count, float* Destination);
+    static void GetFileSizeAndModificationTime(const std::string& Path, int64_t* FileSize, int64_t* ModificationTime);
     static float GetDPIScaleOfWindowsSystem();
     static float GetDPIScale();
     static void CeilPair(std::pair<float, float>* Pair);
-    static float GetRegistryValueFloat(const LPCSTR& RegLocation, const LPCSTR& RegKey, const float& DefaultValue);
-    static std::string GetRegistryValueString(const LPCSTR& RegLocation, const LPCSTR& RegKey);
-    static std::string GetValueOfEnvVariable(const std::string& EnvName);
-    static std::map<std::string, std::string> GetAllEnvNameValueInPath(const std::string& Path);
-    static void PurifyPath(std::string* Path);
+    static float GetRegistryValueFloat(const HKEY& RegLocation, const LPCSTR& RegKey, const float& DefaultValue);
+    static void GetRegistryValueString(const HKEY& RegLocation, const LPCSTR& RegKey, std::string* Value);
+    static bool AppendValueOfEnvVariable(const char* EnvName, const size_t& EnvNameSize, std::string* Path);
+    static void PurifyPath(const std::string& RawPath, std::string* Path);
+    static float GetXftDpi(const std::string& ResourcesPath);
+    static bool FindXcursorFile(const std::string& Theme, const std::string& SearchPath, const char* CursorName, std::string* Path);
+    static bool GetInheritedXcursorTheme(const std::string& ThemeDirectory, std::string* Theme);
+    static void AppendExpandedHome(const char* Directory, const size_t& DirectorySize, std::string* Path);
+    static constexpr int GetIndexOfEmbeddedFrame(const uint8_t* File, const size_t& Size, const int& DesiredSize, bool* IsRealSize);
+    static constexpr bool GetEmbeddedFrameView(const uint8_t* File, const size_t& Size, const int& Index, FRAMEVIEW* Frame, SIZEDATA* SizeData);
+    static constexpr bool IsVisibleEmbeddedPixel(const FRAMEVIEW& Frame, const int& LineIndex, const int& IndexX);
 };
 
+// The constexpr functions are defined in the header to be usable in the constant expressions of any file
+
+/**
+ * Analyze a cursor file embedded in the program. In a constant expression, the informations
+ * are computed at compile time. Only the bitmap pictures are supported, not the PNG ones.
+ * The frame is chosen and its lines are scanned like with AnalyzeCursorFile.
+ *
+ * @param File the bytes of the cursor file.
+ * @param Size the number of bytes of the cursor file.
+ * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+ * @return The informations about the chosen frame of the file, with a frame index of -1 if the file is not a cursor file with a supported frame.
+ */
+constexpr MouseCursorSizeHelper::CURSORFILEINFO MouseCursorSizeHelper::AnalyzeEmbeddedCursorFile(const uint8_t* File, const size_t& Size, const int& DesiredSize)
+{
+    CURSORFILEINFO Info = { -1, 0, 0, 0, 0, 0, 0, false };
+    FRAMEVIEW Frame = {};
+    SIZEDATA SizeData = {};
+
+    int FrameIndex = GetIndexOfEmbeddedFrame(File, Size, DesiredSize, &SizeData.isRealSize);
+    if (FrameIndex >= 0 && GetEmbeddedFrameView(File, Size, FrameIndex, &Frame, &SizeData))
+    {
+        FIRSTLASTINDEXES FirstLastIndexes = InitFirstLastIndexesStruct();
+        float Width = 0;
+
+        // The lines are read from top to bottom, they are stored from bottom to top
+        for (int y = 0; y < SizeData.height; y++)
+        {
+            int LineIndex = SizeData.height - 1 - y;
+            int FirstIndex = 0;
+            while (FirstIndex < SizeData.width && !IsVisibleEmbeddedPixel(Frame, LineIndex, FirstIndex))
+            {
+                FirstIndex++;
+            }
+
+            if (FirstIndex < SizeData.width)
+            {
+                int LastIndex = SizeData.width - 1;
+                while (!IsVisibleEmbeddedPixel(Frame, LineIndex, LastIndex))
+                {
+                    LastIndex--;
+                }
+
+                GetFirstAndLastIndexesFromLine(FirstIndex, LastIndex, &FirstLastIndexes, y);
+            }
+
+            // Compute valid width of the line
+            float LineWidth = float(FirstLastIndexes.lastIndexWidth - FirstLastIndexes.firstIndexWidth + 1);
+            Width = Width < LineWidth ? LineWidth : Width;
+        }
+
+        Info.frameIndex = FrameIndex;
+        Info.frameWidth = SizeData.width;
+        Info.frameHeight = SizeData.height;
+        Info.trimmedWidth = Width;
+        Info.trimmedHeight = float(FirstLastIndexes.lastIndexHeight - FirstLastIndexes.firstIndexHeight + 1);
+        Info.hotspotX = Frame.hotspotX;
+        Info.hotspotY = Frame.hotspotY;
+        Info.isRealSize = SizeData.isRealSize;
+    }
+
+    return Info;
+}
+
+/**
+ * Analyze a cursor file embedded in the program. In a constant expression, the informations
+ * are computed at compile time. Only the bitmap pictures are supported, not the PNG ones.
+ *
+ * @param File the bytes of the cursor file.
+ * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+ * @return The informations about the chosen frame of the file, with a frame index of -1 if the file is not a cursor file with a supported frame.
+ */
+template <size_t Size>
+constexpr MouseCursorSizeHelper::CURSORFILEINFO MouseCursorSizeHelper::AnalyzeEmbeddedCursorFile(const std::array<uint8_t, Size>& File, const int& DesiredSize)
+{
+    return AnalyzeEmbeddedCursorFile(File.data(), Size, DesiredSize);
+}
+
+/**
+ * Get the index of the frame of an embedded cursor file with the desired size,
+ * or of the smallest frame if there is none. This is the logic of GetIndexOfDesiredFrame.
+ *
+ * @param File the bytes of the cursor file.
+ * @param Size the number of bytes of the cursor file.
+ * @param DesiredSize the size of the frame to choose, -1 to choose the smallest one.
+ * @param IsRealSize set to true if a frame has the desired size.
+ * @return The index of the chosen frame, -1 if the file is not a cursor file.
+ */
+constexpr int MouseCursorSizeHelper::GetIndexOfEmbeddedFrame(const uint8_t* File, const size_t& Size, const int& DesiredSize, bool* IsRealSize)
+{
+    int Index = -1;
+
+    // The type of file is a .cur file, with its whole directory
+    int Count = Size >= 6 && ReadUInt16(File + 2) == 2 ? ReadUInt16(File + 4) : 0;
+    if (size_t(6 + 16 * Count) > Size)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < Count && DesiredSize != -1; i++)
+    {
+        const uint8_t* Entry = File + 6 + 16 * i;
+        if (Entry[0] == uint8_t(DesiredSize) && Entry[1] == uint8_t(DesiredSize))
+        {
+            Index = i;
+            *IsRealSize = true;
+            break;
+        }
+    }
+
+    if (Index == -1)
+    {
+        uint64_t ImageSize = 0xffffffffffffffff; // The MAX value of uint64_t
+        for (int i = 0; i < Count; i++)
+        {
+            const uint8_t* Entry = File + 6 + 16 * i;
+            uint64_t EntrySize = uint64_t(Entry[0] * Entry[1]);
+            if (ImageSize > EntrySize)
+            {
+                Index = i;
+                ImageSize = EntrySize;
+            }
+        }
+    }
+
+    return Index;
+}
+
+/**
+ * Get the views on the bitmap picture of a frame of an embedded cursor file.
+ * This is the logic of GetCursorFrame and GetFrameView, without the PNG pictures.
+ *
+ * @param File the bytes of the cursor file.
+ * @param Size the number of bytes of the cursor file.
+ * @param Index the index of the frame in the directory of the file.
+ * @param Frame the views on the pixels, on the mask and on the palette of the picture.
+ * @param SizeData the size informations.
+ * @return True if the frame is a bitmap picture with a supported format.
+ */
+constexpr bool MouseCursorSizeHelper::GetEmbeddedFrameView(const uint8_t* File, const size_t& Size, const int& Index, FRAMEVIEW* Frame, SIZEDATA* SizeData)
+{
+    const uint8_t* Entry = File + 6 + 16 * Index;
+    size_t ImageOffset = ReadUInt32(Entry + 12);
+    if (ImageOffset > Size || Size - ImageOffset < 40)
+    {
+        return false;
+    }
+
+    // Read the BITMAPINFOHEADER, a PNG picture starts with 0x89 instead of the header size
+    const uint8_t* Image = File + ImageOffset;
+    size_t ImageSize = Size - ImageOffset;
+    size_t HeaderSize = ReadUInt32(Image);
+    int64_t Width = int32_t(ReadUInt32(Image + 4));
+    int64_t Height = int32_t(ReadUInt32(Image + 8));
+    int BitCount = ReadUInt16(Image + 14);
+    uint32_t Compression = ReadUInt32(Image + 16);
+    uint32_t ColorsUsed = ReadUInt32(Image + 32);
+
+    bool IsSupportedBitCount = BitCount == 1 || BitCount == 4 || BitCount == 8 || BitCount == 24 || BitCount == 32;
+    if (HeaderSize < 40 || !IsSupportedBitCount || Compression != BI_RGB || Width <= 0)
+    {
+        return false;
+    }
+
+    Height = (Height < 0 ? -Height : Height) / 2; // Half the height is for the mask
+    size_t MaskStride = size_t((Width + 31) / 32) * BYTES_PER_PIXEL; // Width rounded to the nearest multiple of 32 bits
+    size_t PixelsStride = size_t((Width * BitCount + 31) / 32) * BYTES_PER_PIXEL; // Lines are aligned on 32 bits
+    size_t PaletteCount = 0;
+    if (BitCount <= 8)
+    {
+        PaletteCount = ColorsUsed != 0 && ColorsUsed < (1U << BitCount) ? ColorsUsed : (1U << BitCount);
+    }
+
+    // The palette is followed by the pixels, and the pixels by the mask (1 bit per pixel)
+    size_t PaletteOffset = HeaderSize;
+    size_t PixelsOffset = PaletteOffset + PaletteCount * BYTES_PER_PIXEL;
+    size_t MaskOffset = PixelsOffset + PixelsStride * size_t(Height);
+    if (HeaderSize > ImageSize || MaskOffset > ImageSize || MaskStride * size_t(Height) > ImageSize - MaskOffset)
+    {
+        return false;
+    }
+
+    Frame->palette = BYTEVIEW{ Image + PaletteOffset, PaletteCount * BYTES_PER_PIXEL };
+    Frame->pixels = BYTEVIEW{ Image + PixelsOffset, PixelsStride * size_t(Height) };
+    Frame->mask = BYTEVIEW{ Image + MaskOffset, MaskStride * size_t(Height) };
+    Frame->maskStride = MaskStride;
+    Frame->pixelsStride = PixelsStride;
+    Frame->bitCount = BitCount;
+    Frame->index = Index;
+
+    // In a .cur file, the planes and bits count fields hold the hotspot
+    Frame->hotspotX = ReadUInt16(Entry + 4);
+    Frame->hotspotY = ReadUInt16(Entry + 6);
+    SizeData->width = int(Width);
+    SizeData->height = int(Height);
+    SizeData->isBottomUp = true;
+
+    return true;
+}
+
+/**
+ * Check if a pixel of an embedded bitmap picture is visible. With an alpha channel, a pixel is
+ * visible if it is not masked and not fully transparent. Without alpha channel, a pixel is visible
+ * if it is not masked or if its color is not black.
+ *
+ * @param Frame the views on the pixels, on the mask and on the palette of the picture.
+ * @param LineIndex the index of the line in memory.
+ * @param IndexX the index of the pixel in the line.
+ * @return True if the pixel is visible.
+ */
+constexpr bool MouseCursorSizeHelper::IsVisibleEmbeddedPixel(const FRAMEVIEW& Frame, const int& LineIndex, const int& IndexX)
+{
+    const uint8_t* Line = Frame.pixels.data + size_t(LineIndex) * Frame.pixelsStride;
+    bool IsMasked = (Frame.mask.data[size_t(LineIndex) * Frame.maskStride + IndexX / 8] & (0x80 >> (IndexX % 8))) != 0;
+
+    if (Frame.bitCount == 32)
+    {
+        return !IsMasked && Line[size_t(IndexX) * BYTES_PER_PIXEL + 3] != 0;
+    }
+    if (Frame.bitCount == 24)
+    {
+        const uint8_t* Color = Line + size_t(IndexX) * 3;
+        return !IsMasked || (Color[0] | Color[1] | Color[2]) != 0;
+    }
+
+    // A byte holds 8 / BitCount indexes, the first one in the highest bits
+    int PixelsPerByte = 8 / Frame.bitCount;
+    int Shift = 8 - Frame.bitCount * (IndexX % PixelsPerByte + 1);
+    size_t PaletteIndex = (Line[IndexX / PixelsPerByte] >> Shift) & ((1 << Frame.bitCount) - 1);
+    const uint8_t* Color = Frame.palette.data + PaletteIndex * BYTES_PER_PIXEL;
+
+    return !IsMasked || (PaletteIndex * BYTES_PER_PIXEL < Frame.palette.size && (Color[0] | Color[1] | Color[2]) != 0);
+}
+
+/**
+ * Read a little endian unsigned 16 bits value.
+ *
+ * @param Bytes the bytes of the value.
+ * @return The value.
+ */
+constexpr uint16_t MouseCursorSizeHelper::ReadUInt16(const uint8_t* Bytes)
+{
+    return uint16_t(Bytes[0] | (Bytes[1] << 8));
+}
+
+/**
+ * Read a little endian unsigned 32 bits value.
+ *
+ * @param Bytes the bytes of the value.
+ * @return The value.
+ */
+constexpr uint32_t MouseCursorSizeHelper::ReadUInt32(const uint8_t* Bytes)
+{
+    return uint32_t(Bytes[0]) | (uint32_t(Bytes[1]) << 8) | (uint32_t(Bytes[2]) << 16) | (uint32_t(Bytes[3]) << 24);
+}
+
+/**
+ * Initialize FirstLastIndexes structure.
+ *
+ * @return The initialized FirstLastIndexes structure.
+ */
+constexpr MouseCursorSizeHelper::FIRSTLASTINDEXES MouseCursorSizeHelper::InitFirstLastIndexesStruct()
+{
+    FIRSTLASTINDEXES IndexesStruct = {};
+
+    IndexesStruct.lastYValue = -1; // Negative value to take first line in account for height calculation
+    IndexesStruct.firstIndexHeight = 0;
+    IndexesStruct.lastIndexHeight = 0;
+    IndexesStruct.firstIndexWidth = 0;
+    IndexesStruct.lastIndexWidth = 0;
+    IndexesStruct.isFirstIndexHeightFound = false;
+    IndexesStruct.isFirstIndexWidthFound = false;
+
+    return IndexesStruct;
+}
+
+/**
+ * Compute the first and last index depending on the first and last valid pixels of a line.
+ * These indexes will be used to compute the real size of the cursor.
+ * The result is the same as processing every pixel of the line from left to right.
+ *
+ * @param FirstIndex the index of the first valid pixel of the line.
+ * @param LastIndex the index of the last valid pixel of the line.
+ * @param IndexesStruct the structure of indexes to compute.
+ * @param IndexY the index of the line.
+ */
+constexpr void MouseCursorSizeHelper::GetFirstAndLastIndexesFromLine(const int& FirstIndex, const int& LastIndex, FIRSTLASTINDEXES* IndexesStruct, const int& IndexY)
+{
+    // Compute the first and last index where there is a valid pixel in line
+    if (!IndexesStruct->isFirstIndexWidthFound)
+    {
+        IndexesStruct->firstIndexWidth = FirstIndex;
+        IndexesStruct->isFirstIndexWidthFound = true;
+
+        // The very first valid pixel never becomes the last one
+        if (LastIndex != FirstIndex)
+        {
+            IndexesStruct->lastIndexWidth = LastIndex;
+        }
+    }
+    else
+    {
+        IndexesStruct->lastIndexWidth = LastIndex;
+    }
+
+    // Compute the first and last index where there is a valid pixel for height
+    if (IndexY != IndexesStruct->lastYValue)
+    {
+        if (!IndexesStruct->isFirstIndexHeightFound)
+        {
+            IndexesStruct->firstIndexHeight = IndexY;
+            IndexesStruct->isFirstIndexHeightFound = true;
+        }
+        else
+        {
+            IndexesStruct->lastIndexHeight = IndexY;
+        }
+        IndexesStruct->lastYValue = IndexY;
+    }
+}
+
+#ifdef MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+
+// The awaitable is defined in the header, so the helper itself can be built without C++20
+
+/**
+ * Get the real current mouse cursor size with scales from a coroutine, with co_await.
+ * The computation is started like with GetCurrentMouseCursorSizeAsync, and shared with its requests.
+ *
+ * @param Executor the function running the computation, nullptr to run it on a new thread.
+ * @return The awaitable pair of the real mouse cursor width and height.
+ */
+inline MouseCursorSizeHelper::CURSORSIZEAWAITABLE MouseCursorSizeHelper::GetCurrentMouseCursorSizeAwaitable(const TASKEXECUTOR& Executor)
+{
+    CURSORSIZEAWAITABLE Awaitable;
+    Awaitable.query = StartAsyncQuery(Executor);
+
+    return Awaitable;
+}
+
+/**
+ * Check if the awaiting coroutine can go on without being suspended.
+ * This is decided by await_suspend, under the lock of the computation.
+ *
+ * @return Always false.
+ */
+inline bool MouseCursorSizeHelper::CURSORSIZEAWAITABLE::await_ready() const
+{
+    return false;
+}
+
+/**
+ * Suspend the awaiting coroutine until the size is computed.
+ *
+ * @param Handle the awaiting coroutine, resumed on the thread of the executor.
+ * @return True if the coroutine is suspended, false if the size is already computed.
+ */
+inline bool MouseCursorSizeHelper::CURSORSIZEAWAITABLE::await_suspend(std::coroutine_handle<> Handle) const
+{
+    return AddAsyncQueryContinuation(query, [Handle]() { Handle.resume(); });
+}
+
+/**
+ * Get the computed size when the awaiting coroutine goes on.
+ *
+ * @return The pair of the real mouse cursor width and height.
+ */
+inline std::pair<float, float> MouseCursorSizeHelper::CURSORSIZEAWAITABLE::await_resume() const
+{
+    return query->result.get();
+}
+
+#endif // MOUSE_CURSOR_SIZE_HELPER_COROUTINES
+
 #endif // !MOUSE_CURSOR_SIZE_HELPER_H
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "../MouseCursorSizeHelper.h"
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <string>
+
+/**
+ * Command line tool computing the trimmed sizes of all the cursor files of a directory tree.
+ * The files are decoded on a work-stealing pool and one JSON or CSV line is written per file.
+ *
+ * Usage : CursorCorpusAnalyzer <directory> [--format json|csv] [--size desired_size] [--threads count]
+ */
+class CursorCorpusAnalyzer
+{
+public:
+    struct ANALYZEROPTIONS {
+        std::string directory;          // Root of the directory tree to analyze
+        bool isCsv;                     // Write CSV lines instead of JSON lines
+        int desiredSize;                // Size of the frame to choose, -1 to choose the smallest one
+        size_t threadsCount;            // Number of decoding threads
+    };
+
+    struct CORPUSFILE {
+        std::string path;               // Path of the cursor file
+        uint64_t size;                  // Size of the cursor file in bytes
+    };
+
+    static bool ParseArguments(const int& Argc, char** Argv, ANALYZEROPTIONS* Options);
+    static std::vector<CORPUSFILE> ListCursorFiles(const std::string& Directory);
+    static void Run(const ANALYZEROPTIONS& Options, const std::vector<CORPUSFILE>& Files);
+
+private:
+    struct WORKQUEUE {
+        std::mutex mutex;               // Lock of the queue
+        std::deque<size_t> tasks;       // Indexes of the files to decode
+    };
+
+    static bool PopOwnTask(WORKQUEUE* Queue, size_t* Task);
+    static bool StealTask(std::vector<WORKQUEUE>* Queues, const size_t& Thief, size_t* Task);
+    static std::string FormatLine(const ANALYZEROPTIONS& Options, const std::string& Path, const bool& IsAnalyzed, const MouseCursorSizeHelper::CURSORFILEINFO& Info);
+    static std::string EscapeJson(const std::string& Text);
+    static std::string EscapeCsv(const std::string& Text);
+};
+
+/**
+ * Read the options from the command line arguments.
+ *
+ * @param Argc the number of arguments.
+ * @param Argv the arguments.
+ * @param Options the read options.
+ * @return True if the arguments are valid.
+ */
+bool CursorCorpusAnalyzer::ParseArguments(const int& Argc, char** Argv, ANALYZEROPTIONS* Options)
+{
+	bool IsValid = true;
+	Options->isCsv = false;
+	Options->desiredSize = -1;
+	Options->threadsCount = std::max(1U, std::thread::hardware_concurrency());
+
+	for (int i = 1; i < Argc && IsValid; i++)
+	{
+		std::string Argument = Argv[i];
+		bool HasValue = i + 1 < Argc;
+
+		if (Argument == "--format" && HasValue)
+		{
+			std::string Format = Argv[++i];
+			Options->isCsv = Format == "csv";
+			IsValid = Options->isCsv || Format == "json";
+		}
+		else if (Argument == "--size" && HasValue)
+		{
+			Options->desiredSize = std::atoi(Argv[++i]);
+		}
+		else if (Argument == "--threads" && HasValue)
+		{
+			Options->threadsCount = size_t(std::max(1, std::atoi(Argv[++i])));
+		}
+		else if (Options->directory.empty() && Argument.rfind("--", 0) != 0)
+		{
+			Options->directory = Argument;
+		}
+		else
+		{
+			IsValid = false;
+		}
+	}
+
+	return IsValid && !Options->directory.empty();
+}
+
+/**
+ * List recursively the cursor files of a directory. Unreadable directories are skipped.
+ *
+ * @param Directory the root of the directory tree.
+ * @return The paths and sizes of the cursor files.
+ */
+std::vector<CursorCorpusAnalyzer::CORPUSFILE> CursorCorpusAnalyzer::ListCursorFiles(const std::string& Directory)
+{
+	std::vector<CORPUSFILE> Files;
+	std::error_code Error;
+	std::filesystem::recursive_directory_iterator Iterator(Directory, std::filesystem::directory_options::skip_permission_denied, Error);
+
+	for (; !Error && Iterator != std::filesystem::recursive_directory_iterator(); Iterator.increment(Error))
+	{
+		std::string Extension = Iterator->path().extension().string();
+		std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](unsigned char Character) { return char(std::tolower(Character)); });
+
+		// The Xcursor files of a theme have no extension and are stored in its cursors directory
+		bool IsXcursorFile = Extension.empty() && Iterator->path().parent_path().filename() == "cursors";
+
+		std::error_code FileError;
+		if ((Extension == ".cur" || IsXcursorFile) && Iterator->is_regular_file(FileError))
+		{
+			CORPUSFILE File;
+			File.path = Iterator->path().string();
+			File.size = Iterator->file_size(FileError);
+			Files.push_back(File);
+		}
+	}
+
+	return Files;
+}
+
+/**
+ * Decode all the files on a work-stealing pool, write one line per file on the standard output and
+ * the throughput on the error output. Each thread takes the files of its own range from the back and
+ * steals the first half of the remaining files of another thread when its range is empty.
+ *
+ * @param Options the options of the analysis.
+ * @param Files the cursor files to analyze.
+ */
+void CursorCorpusAnalyzer::Run(const ANALYZEROPTIONS& Options, const std::vector<CORPUSFILE>& Files)
+{
+	size_t ThreadsCount = std::max<size_t>(1, std::min(Options.threadsCount, Files.size()));
+	std::vector<WORKQUEUE> Queues(ThreadsCount);
+	for (size_t i = 0; i < Files.size(); i++)
+	{
+		Queues[i * ThreadsCount / Files.size()].tasks.push_back(i);
+	}
+
+	std::mutex OutputMutex;
+	std::atomic<uint64_t> AnalyzedCount(0);
+	std::atomic<uint64_t> FailedCount(0);
+	std::atomic<uint64_t> BytesCount(0);
+
+	if (Options.isCsv)
+	{
+		std::fputs("path,frame,width,height,trimmed_width,trimmed_height,hotspot_x,hotspot_y\n", stdout);
+	}
+
+	auto Worker = [&](size_t WorkerIndex)
+	{
+		size_t Task;
+		while (PopOwnTask(&Queues[WorkerIndex], &Task) || StealTask(&Queues, WorkerIndex, &Task))
+		{
+			MouseCursorSizeHelper::CURSORFILEINFO Info;
+			bool IsAnalyzed = MouseCursorSizeHelper::AnalyzeCursorFile(Files[Task].path, Options.desiredSize, &Info);
+			std::string Line = FormatLine(Options, Files[Task].path, IsAnalyzed, Info);
+
+			(IsAnalyzed ? AnalyzedCount : FailedCount)++;
+			BytesCount += Files[Task].size;
+
+			std::lock_guard<std::mutex> Lock(OutputMutex);
+			std::fwrite(Line.data(), 1, Line.size(), stdout);
+		}
+	};
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> Threads;
+	for (size_t i = 1; i < ThreadsCount; i++)
+	{
+		Threads.emplace_back(Worker, i);
+	}
+	Worker(0);
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+	std::fflush(stdout);
+
+	double Seconds = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+	uint64_t FilesCount = AnalyzedCount + FailedCount;
+	std::fprintf(stderr, "%llu files (%llu failed) in %.3f s with %zu threads: %.0f files/s, %.2f MB/s\n",
+		(unsigned long long)FilesCount, (unsigned long long)FailedCount.load(), Seconds, ThreadsCount,
+		FilesCount / Seconds, BytesCount / Seconds / (1024.0 * 1024.0));
+}
+
+/**
+ * Take the last file of the own range of a thread.
+ *
+ * @param Queue the queue of the thread.
+ * @param Task the index of the taken file.
+ * @return True if a file was taken.
+ */
+bool CursorCorpusAnalyzer::PopOwnTask(WORKQUEUE* Queue, size_t* Task)
+{
+	std::lock_guard<std::mutex> Lock(Queue->mutex);
+	bool IsFound = !Queue->tasks.empty();
+
+	if (IsFound)
+	{
+		*Task = Queue->tasks.back();
+		Queue->tasks.pop_back();
+	}
+
+	return IsFound;
+}
+
+/**
+ * Steal the first half of the remaining files of another thread, keep them in the queue of the
+ * thief and take one of them.
+ *
+ * @param Queues the queues of all the threads.
+ * @param Thief the index of the stealing thread.
+ * @param Task the index of the taken file.
+ * @return True if a file was stolen.
+ */
+bool CursorCorpusAnalyzer::StealTask(std::vector<WORKQUEUE>* Queues, const size_t& Thief, size_t* Task)
+{
+	std::deque<size_t> Stolen;
+
+	for (size_t i = 1; i < Queues->size() && Stolen.empty(); i++)
+	{
+		WORKQUEUE& Victim = (*Queues)[(Thief + i) % Queues->size()];
+		std::lock_guard<std::mutex> Lock(Victim.mutex);
+
+		size_t StolenCount = (Victim.tasks.size() + 1) / 2;
+		Stolen.assign(Victim.tasks.begin(), Victim.tasks.begin() + StolenCount);
+		Victim.tasks.erase(Victim.tasks.begin(), Victim.tasks.begin() + StolenCount);
+	}
+
+	bool IsFound = !Stolen.empty();
+	if (IsFound)
+	{
+		*Task = Stolen.back();
+		Stolen.pop_back();
+
+		WORKQUEUE& Own = (*Queues)[Thief];
+		std::lock_guard<std::mutex> Lock(Own.mutex);
+		Own.tasks.insert(Own.tasks.end(), Stolen.begin(), Stolen.end());
+	}
+
+	return IsFound;
+}
+
+/**
+ * Format the result of the analysis of a file.
+ *
+ * @param Options the options of the analysis.
+ * @param Path the path of the file.
+ * @param IsAnalyzed the file is a cursor file with a supported frame.
+ * @param Info the informations about the chosen frame of the file.
+ * @return The JSON or CSV line, with its line break.
+ */
+std::string CursorCorpusAnalyzer::FormatLine(const ANALYZEROPTIONS& Options, const std::string& Path, const bool& IsAnalyzed, const MouseCursorSizeHelper::CURSORFILEINFO& Info)
+{
+	char Fields[256] = "";
+
+	if (Options.isCsv)
+	{
+		if (IsAnalyzed)
+		{
+			std::snprintf(Fields, sizeof(Fields), ",%d,%d,%d,%g,%g,%d,%d", Info.frameIndex, Info.frameWidth, Info.frameHeight,
+				Info.trimmedWidth, Info.trimmedHeight, Info.hotspotX, Info.hotspotY);
+		}
+		else
+		{
+			std::snprintf(Fields, sizeof(Fields), ",,,,,,,");
+		}
+
+		return EscapeCsv(Path) + Fields + "\n";
+	}
+
+	if (IsAnalyzed)
+	{
+		std::snprintf(Fields, sizeof(Fields), ",\"frame\":%d,\"width\":%d,\"height\":%d,\"trimmedWidth\":%g,\"trimmedHeight\":%g,\"hotspotX\":%d,\"hotspotY\":%d}",
+			Info.frameIndex, Info.frameWidth, Info.frameHeight, Info.trimmedWidth, Info.trimmedHeight, Info.hotspotX, Info.hotspotY);
+	}
+	else
+	{
+		std::snprintf(Fields, sizeof(Fields), ",\"error\":\"unsupported cursor file\"}");
+	}
+
+	return "{\"path\":\"" + EscapeJson(Path) + "\"" + Fields + "\n";
+}
+
+/**
+ * Escape a text to be written in a JSON string.
+ *
+ * @param Text the text to escape.
+ * @return The escaped text, without the quotes.
+ */
+std::string CursorCorpusAnalyzer::EscapeJson(const std::string& Text)
+{
+	std::string Escaped;
+	Escaped.reserve(Text.size());
+
+	for (unsigned char Character : Text)
+	{
+		if (Character == '"' || Character == '\\')
+		{
+			Escaped += '\\';
+			Escaped += char(Character);
+		}
+		else if (Character < 0x20)
+		{
+			char Code[8];
+			std::snprintf(Code, sizeof(Code), "\\u%04x", Character);
+			Escaped += Code;
+		}
+		else
+		{
+			Escaped += char(Character);
+		}
+	}
+
+	return Escaped;
+}
+
+/**
+ * Escape a text to be written in a CSV field.
+ *
+ * @param Text the text to escape.
+ * @return The quoted text.
+ */
+std::string CursorCorpusAnalyzer::EscapeCsv(const std::string& Text)
+{
+	std::string Escaped = "\"";
+
+	for (char Character : Text)
+	{
+		Escaped += Character;
+		if (Character == '"')
+		{
+			Escaped += '"';
+		}
+	}
+
+	return Escaped + "\"";
+}
+
+int main(int argc, char** argv)
+{
+	CursorCorpusAnalyzer::ANALYZEROPTIONS Options;
+
+	if (!CursorCorpusAnalyzer::ParseArguments(argc, argv, &Options))
+	{
+		std::fprintf(stderr, "Usage : %s <directory> [--format json|csv] [--size desired_size] [--threads count]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<CursorCorpusAnalyzer::CORPUSFILE> Files = CursorCorpusAnalyzer::ListCursorFiles(Options.directory);
+	CursorCorpusAnalyzer::Run(Options, Files);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,645 @@
+#include "../MouseCursorSizeHelper.h"
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <new>
+#include <string>
+
+// Number of heap allocations of the program, counted by the replaced operator new
+static std::atomic<uint64_t> AllocationsCount(0);
+
+void* operator new(size_t Size)
+{
+	AllocationsCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* Memory = std::malloc(Size != 0 ? Size : 1);
+	if (Memory == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return Memory;
+}
+
+void operator delete(void* Memory) noexcept
+{
+	std::free(Memory);
+}
+
+void operator delete(void* Memory, size_t) noexcept
+{
+	std::free(Memory);
+}
+
+/**
+ * Command line tool timing each stage of a mouse cursor size query separately, and the whole query.
+ * The stages run on generated cursor files (sizes, alpha coverage and frames count) with settings
+ * stored in memory, and the results are written as a JSON document to compare the builds.
+ * The resampling of generated images is timed too, against a naive bilinear scaler.
+ *
+ * With --check-allocations, the stages are not timed: the tool fails if a query allocates
+ * heap memory once its workspace is warmed up.
+ *
+ * Usage : CursorSizeBenchmark [--time milliseconds] [--repetitions count] [--check-allocations]
+ */
+class CursorSizeBenchmark
+{
+public:
+    struct BENCHMARKOPTIONS {
+        double minTime;                 // Minimum duration of a repetition in seconds
+        int repetitionsCount;           // Number of timed repetitions of each stage
+        bool isAllocationsCheck;        // Check that the warmed up queries don't allocate, instead of timing
+    };
+
+    struct BENCHMARKCASE {
+        std::string name;               // Name of the case in the results
+        int size;                       // Width and height of the desired frame
+        bool isDense;                   // Most of the pixels are visible, instead of the outline of an arrow
+        int framesCount;                // Number of frames in the cursor file, the desired one being the last
+        std::vector<uint8_t> file;      // Content of the generated cursor file
+        std::string path;               // Path of the generated cursor file, written for the file stages
+    };
+
+    struct STAGERESULT {
+        uint64_t iterations;            // Number of calls of a repetition
+        double medianTime;              // Median time of a call in nanoseconds
+        double minTime;                 // Fastest time of a call in nanoseconds
+        double allocations;             // Heap allocations per call
+    };
+
+    static bool ParseArguments(const int& Argc, char** Argv, BENCHMARKOPTIONS* Options);
+    static std::vector<BENCHMARKCASE> GenerateCases(const std::string& Directory);
+    static void Run(const BENCHMARKOPTIONS& Options, const std::vector<BENCHMARKCASE>& Cases);
+    static bool CheckAllocations(const std::vector<BENCHMARKCASE>& Cases);
+
+private:
+    typedef MouseCursorSizeHelper Helper;
+
+    static std::vector<uint8_t> GenerateCursorFile(const int& Size, const bool& IsDense, const int& FramesCount);
+    static void AppendUInt16(const uint16_t& Value, std::vector<uint8_t>* Bytes);
+    static void AppendUInt32(const uint32_t& Value, std::vector<uint8_t>* Bytes);
+    static void RunCaseStages(const BENCHMARKOPTIONS& Options, const BENCHMARKCASE& Case, std::string* Results);
+    static void RunResampleStages(const BENCHMARKOPTIONS& Options, std::string* Results);
+    static Helper::RGBAIMAGE GenerateImage(const int& Size);
+    static void ResampleNaively(const Helper::RGBAIMAGE& Source, const int& Width, const int& Height, Helper::RGBAIMAGE* Destination);
+    template <typename STAGEFUNCTION>
+    static STAGERESULT MeasureStage(const BENCHMARKOPTIONS& Options, const STAGEFUNCTION& Stage);
+    static void AppendResult(const std::string& CaseFields, const std::string& Stage, const STAGERESULT& Result, std::string* Results);
+};
+
+// Result of the measured stages, read so the compiler can't remove them
+static volatile uint64_t Sink = 0;
+
+/**
+ * Read the options from the command line arguments.
+ *
+ * @param Argc the number of arguments.
+ * @param Argv the arguments.
+ * @param Options the read options.
+ * @return True if the arguments are valid.
+ */
+bool CursorSizeBenchmark::ParseArguments(const int& Argc, char** Argv, BENCHMARKOPTIONS* Options)
+{
+	bool IsValid = true;
+	Options->minTime = 0.01;
+	Options->repetitionsCount = 5;
+	Options->isAllocationsCheck = false;
+
+	for (int i = 1; i < Argc && IsValid; i++)
+	{
+		std::string Argument = Argv[i];
+		bool HasValue = i + 1 < Argc;
+
+		if (Argument == "--time" && HasValue)
+		{
+			Options->minTime = std::max(1, std::atoi(Argv[++i])) / 1000.0;
+		}
+		else if (Argument == "--repetitions" && HasValue)
+		{
+			Options->repetitionsCount = std::max(1, std::atoi(Argv[++i]));
+		}
+		else if (Argument == "--check-allocations")
+		{
+			Options->isAllocationsCheck = true;
+		}
+		else
+		{
+			IsValid = false;
+		}
+	}
+
+	return IsValid;
+}
+
+/**
+ * Generate the cursor files of all the cases and write them in a directory.
+ * The sizes go from 32 to 256 px, with 1 to 8 frames and a sparse or dense alpha coverage.
+ *
+ * @param Directory the directory receiving the cursor files.
+ * @return The cases, with the content and the path of their cursor file.
+ */
+std::vector<CursorSizeBenchmark::BENCHMARKCASE> CursorSizeBenchmark::GenerateCases(const std::string& Directory)
+{
+	std::vector<BENCHMARKCASE> Cases;
+
+	for (int Size : { 32, 48, 64, 128, 256 })
+	{
+		for (int FramesCount : { 1, 4, 8 })
+		{
+			for (bool IsDense : { false, true })
+			{
+				BENCHMARKCASE Case;
+				Case.name = "cur_" + std::to_string(Size) + "px_" + (IsDense ? "dense_" : "sparse_") + std::to_string(FramesCount) + "frames";
+				Case.size = Size;
+				Case.isDense = IsDense;
+				Case.framesCount = FramesCount;
+				Case.file = GenerateCursorFile(Size, IsDense, FramesCount);
+				Case.path = (std::filesystem::path(Directory) / (Case.name + ".cur")).string();
+
+				FILE* File = std::fopen(Case.path.c_str(), "wb");
+				if (File != nullptr)
+				{
+					std::fwrite(Case.file.data(), 1, Case.file.size(), File);
+					std::fclose(File);
+				}
+
+				Cases.push_back(Case);
+			}
+		}
+	}
+
+	return Cases;
+}
+
+/**
+ * Time the stages which don't depend on the cursor file, then all the stages of each case,
+ * and write the results as a JSON document on the standard output.
+ *
+ * @param Options the options of the benchmark.
+ * @param Cases the cases to time.
+ */
+void CursorSizeBenchmark::Run(const BENCHMARKOPTIONS& Options, const std::vector<BENCHMARKCASE>& Cases)
+{
+	std::string Results;
+
+	// The settings of the platform (registry on Windows, Xcursor environment elsewhere) and the mocked ones
+	Helper::CURSORSETTINGS Settings = { "", -1, DEFAULT_MOUSE_SCALE, 100 };
+	Helper::MEMORYSETTINGSPROVIDER MemoryProvider(Settings);
+#ifdef _WIN32
+	Helper::REGISTRYSETTINGSPROVIDER PlatformProvider;
+#else
+	Helper::XCURSORSETTINGSPROVIDER PlatformProvider;
+#endif // _WIN32
+
+	AppendResult("\"case\":\"settings\"", "readPlatformSettings", MeasureStage(Options, [&]() {
+		PlatformProvider.ReadSettings(&Settings);
+		return uint64_t(Settings.cursorPath.size());
+	}), &Results);
+	AppendResult("\"case\":\"settings\"", "readMemorySettings", MeasureStage(Options, [&]() {
+		MemoryProvider.ReadSettings(&Settings);
+		return uint64_t(Settings.cursorPath.size());
+	}), &Results);
+
+	for (const BENCHMARKCASE& Case : Cases)
+	{
+		std::fprintf(stderr, "%s\n", Case.name.c_str());
+		RunCaseStages(Options, Case, &Results);
+	}
+	RunResampleStages(Options, &Results);
+
+	std::printf("{\n  \"benchmark\": \"CursorSizeBenchmark\",\n  \"minTimeMs\": %g,\n  \"repetitions\": %d,\n  \"results\": [\n%s\n  ]\n}\n",
+		Options.minTime * 1000.0, Options.repetitionsCount, Results.c_str());
+}
+
+/**
+ * Check that the whole query doesn't allocate heap memory once its workspace is warmed up,
+ * with the memoized size and after an invalidation, on the cursor file of each case.
+ *
+ * @param Cases the cases to check.
+ * @return True if no warmed up query allocated.
+ */
+bool CursorSizeBenchmark::CheckAllocations(const std::vector<BENCHMARKCASE>& Cases)
+{
+	const int WarmUpCalls = 4;
+	const int CheckedCalls = 100;
+	bool IsWithoutAllocation = true;
+
+	for (const BENCHMARKCASE& Case : Cases)
+	{
+		Helper::CURSORSETTINGS Settings = { Case.path, float(Case.size), DEFAULT_MOUSE_SCALE, 100 };
+		Helper::QUERYWORKSPACE Workspace;
+		Helper::SetSettingsProvider(std::make_shared<Helper::MEMORYSETTINGSPROVIDER>(Settings));
+
+		// The first queries grow the buffers of the workspace and the memoized path
+		for (int i = 0; i < WarmUpCalls; i++)
+		{
+			Helper::Invalidate();
+			Sink = Sink + uint64_t(Helper::GetCurrentMouseCursorSize(&Workspace).first);
+		}
+
+		for (bool IsInvalidated : { false, true })
+		{
+			uint64_t Allocations = AllocationsCount.load();
+			for (int i = 0; i < CheckedCalls; i++)
+			{
+				if (IsInvalidated)
+				{
+					Helper::Invalidate();
+				}
+				Sink = Sink + uint64_t(Helper::GetCurrentMouseCursorSize(&Workspace).first);
+			}
+			Allocations = AllocationsCount.load() - Allocations;
+
+			if (Allocations != 0)
+			{
+				std::fprintf(stderr, "%s: %llu allocations in %d %s queries\n", Case.name.c_str(),
+					(unsigned long long)Allocations, CheckedCalls, IsInvalidated ? "invalidated" : "memoized");
+				IsWithoutAllocation = false;
+			}
+		}
+		Helper::SetSettingsProvider(nullptr);
+	}
+
+	return IsWithoutAllocation;
+}
+
+/**
+ * Generate a .cur file with 32 bits frames. The desired frame is the last one of the directory,
+ * so the frame selection reads all the entries. The other frames have the other usual sizes.
+ *
+ * @param Size the width and height of the desired frame.
+ * @param IsDense most of the pixels are visible, instead of the outline of an arrow.
+ * @param FramesCount the number of frames of the file.
+ * @return The content of the cursor file.
+ */
+std::vector<uint8_t> CursorSizeBenchmark::GenerateCursorFile(const int& Size, const bool& IsDense, const int& FramesCount)
+{
+	std::vector<int> Sizes;
+	for (int OtherSize : { 24, 32, 48, 64, 96, 128, 256 })
+	{
+		if (OtherSize != Size && int(Sizes.size()) < FramesCount - 1)
+		{
+			Sizes.push_back(OtherSize);
+		}
+	}
+	Sizes.push_back(Size);
+
+	std::vector<uint8_t> File;
+	AppendUInt16(0, &File);
+	AppendUInt16(2, &File);
+	AppendUInt16(uint16_t(Sizes.size()), &File);
+
+	// Each picture is a BITMAPINFOHEADER, the pixels and an empty mask
+	uint32_t ImageOffset = uint32_t(6 + 16 * Sizes.size());
+	for (int FrameSize : Sizes)
+	{
+		uint32_t ImageSize = uint32_t(40 + FrameSize * FrameSize * BYTES_PER_PIXEL + ((FrameSize + 31) / 32) * BYTES_PER_PIXEL * FrameSize);
+		File.push_back(uint8_t(FrameSize));
+		File.push_back(uint8_t(FrameSize));
+		File.push_back(0);
+		File.push_back(0);
+		AppendUInt16(uint16_t(FrameSize / 8), &File); // The hotspot
+		AppendUInt16(uint16_t(FrameSize / 8), &File);
+		AppendUInt32(ImageSize, &File);
+		AppendUInt32(ImageOffset, &File);
+		ImageOffset += ImageSize;
+	}
+
+	for (int FrameSize : Sizes)
+	{
+		AppendUInt32(40, &File);
+		AppendUInt32(uint32_t(FrameSize), &File);
+		AppendUInt32(uint32_t(FrameSize * 2), &File);
+		AppendUInt16(1, &File);
+		AppendUInt16(32, &File);
+		for (int i = 0; i < 6; i++)
+		{
+			AppendUInt32(0, &File);
+		}
+
+		// The lines are stored from bottom to top
+		for (int y = FrameSize - 1; y >= 0; y--)
+		{
+			for (int x = 0; x < FrameSize; x++)
+			{
+				int ArrowHeight = FrameSize * 3 / 4;
+				bool IsVisible = IsDense
+					? x > 0 && y > 0 && x < FrameSize - 1 && y < FrameSize - 1
+					: y < ArrowHeight && (x == 0 || x == y / 2 || (y == ArrowHeight - 1 && x <= y / 2));
+				AppendUInt32(IsVisible ? 0xFF202020 : 0, &File);
+			}
+		}
+
+		File.insert(File.end(), size_t((FrameSize + 31) / 32) * BYTES_PER_PIXEL * FrameSize, 0);
+	}
+
+	return File;
+}
+
+/**
+ * Append a little endian unsigned 16 bits value.
+ *
+ * @param Value the value.
+ * @param Bytes the bytes receiving the value.
+ */
+void CursorSizeBenchmark::AppendUInt16(const uint16_t& Value, std::vector<uint8_t>* Bytes)
+{
+	Bytes->push_back(uint8_t(Value));
+	Bytes->push_back(uint8_t(Value >> 8));
+}
+
+/**
+ * Append a little endian unsigned 32 bits value.
+ *
+ * @param Value the value.
+ * @param Bytes the bytes receiving the value.
+ */
+void CursorSizeBenchmark::AppendUInt32(const uint32_t& Value, std::vector<uint8_t>* Bytes)
+{
+	AppendUInt16(uint16_t(Value), Bytes);
+	AppendUInt16(uint16_t(Value >> 16), Bytes);
+}
+
+/**
+ * Time each stage of a query on the cursor file of a case, in the order of a query: file
+ * opening, frame selection, pixels extraction and flip, size computation from the pixel array
+ * or from the frame, scaling, then the whole query with and without the memoized size.
+ *
+ * @param Options the options of the benchmark.
+ * @param Case the case to time.
+ * @param Results the JSON results receiving the ones of the case.
+ */
+void CursorSizeBenchmark::RunCaseStages(const BENCHMARKOPTIONS& Options, const BENCHMARKCASE& Case, std::string* Results)
+{
+	char CaseFields[256];
+	std::snprintf(CaseFields, sizeof(CaseFields), "\"case\":\"%s\",\"size\":%d,\"alpha\":\"%s\",\"frames\":%d",
+		Case.name.c_str(), Case.size, Case.isDense ? "dense" : "sparse", Case.framesCount);
+
+	Helper::CURSORSETTINGS Settings = { Case.path, float(Case.size), DEFAULT_MOUSE_SCALE, 100 };
+	Helper::BYTEVIEW File = { Case.file.data(), Case.file.size() };
+	Helper::QUERYWORKSPACE Workspace;
+
+	AppendResult(CaseFields, "openFile", MeasureStage(Options, [&]() {
+		Helper::MAPPEDFILE MappedFile;
+		bool IsOpened = Helper::OpenMappedFile(Case.path, &MappedFile);
+		Helper::CloseMappedFile(&MappedFile);
+		return uint64_t(IsOpened);
+	}), Results);
+
+	Helper::FRAMEVIEW Frame;
+	Helper::SIZEDATA SizeData = {};
+	AppendResult(CaseFields, "selectFrame", MeasureStage(Options, [&]() {
+		SizeData = Helper::SIZEDATA{};
+		return uint64_t(Helper::GetCursorFrame(File, Settings, &Frame, &SizeData));
+	}), Results);
+
+	AppendResult(CaseFields, "extractPixels", MeasureStage(Options, [&]() {
+		return uint64_t(Helper::ExtractPixels(Frame, SizeData).size());
+	}), Results);
+
+	std::vector<uint32_t> PixelArray = Helper::ExtractPixels(Frame, SizeData);
+	Helper::SIZEDATA FlippedSizeData = SizeData;
+	AppendResult(CaseFields, "invertArrayHeight", MeasureStage(Options, [&]() {
+		Helper::InvertArrayHeight(&PixelArray, &FlippedSizeData);
+		return uint64_t(PixelArray[0]);
+	}), Results);
+
+	PixelArray = Helper::ExtractPixels(Frame, SizeData);
+	AppendResult(CaseFields, "computeSizeFromPixelArray", MeasureStage(Options, [&]() {
+		return uint64_t(Helper::ComputeCursorSizeFromPixelArray(PixelArray, SizeData).first);
+	}), Results);
+
+	AppendResult(CaseFields, "computeSizeFromFrame", MeasureStage(Options, [&]() {
+		return uint64_t(Helper::ComputeCursorSizeFromFrame(Frame, SizeData, &Workspace).first);
+	}), Results);
+
+	std::pair<float, float> BaseSize = Helper::ComputeCursorSizeFromFrame(Frame, SizeData, &Workspace);
+	AppendResult(CaseFields, "scale", MeasureStage(Options, [&]() {
+		std::pair<float, float> CursorSize = BaseSize;
+		Helper::ScaleCursorSizeByDPI(&CursorSize, Settings.dpiScale);
+		Helper::ScaleCursorSizeByMouseSystemScale(&CursorSize, Settings.mouseScale);
+		Helper::CeilPair(&CursorSize);
+		return uint64_t(CursorSize.first);
+	}), Results);
+
+	// The whole query reads the settings from memory, the size is computed again after each invalidation
+	Helper::SetSettingsProvider(std::make_shared<Helper::MEMORYSETTINGSPROVIDER>(Settings));
+	AppendResult(CaseFields, "query", MeasureStage(Options, [&]() {
+		Helper::Invalidate();
+		return uint64_t(Helper::GetCurrentMouseCursorSize(&Workspace).first);
+	}), Results);
+
+	AppendResult(CaseFields, "memoizedQuery", MeasureStage(Options, [&]() {
+		return uint64_t(Helper::GetCurrentMouseCursorSize(&Workspace).first);
+	}), Results);
+	Helper::SetSettingsProvider(nullptr);
+}
+
+/**
+ * Time the resampling of generated images with each filter, reduced, enlarged and enlarged
+ * to a size resampled on several threads, and the naive bilinear scaler on the same images.
+ *
+ * @param Options the options of the benchmark.
+ * @param Results the JSON results receiving the ones of the resampling.
+ */
+void CursorSizeBenchmark::RunResampleStages(const BENCHMARKOPTIONS& Options, std::string* Results)
+{
+	const std::pair<int, int> Sizes[] = { { 256, 48 }, { 32, 64 }, { 128, 512 } };
+	const std::pair<int, const char*> Filters[] = {
+		{ RESAMPLE_FILTER_BOX, "resampleBox" }, { RESAMPLE_FILTER_BILINEAR, "resampleBilinear" }, { RESAMPLE_FILTER_LANCZOS, "resampleLanczos" }
+	};
+
+	for (const std::pair<int, int>& Size : Sizes)
+	{
+		char CaseFields[256];
+		std::snprintf(CaseFields, sizeof(CaseFields), "\"case\":\"resample_%dpx_to_%dpx\",\"size\":%d,\"targetSize\":%d",
+			Size.first, Size.second, Size.first, Size.second);
+		std::fprintf(stderr, "resample_%dpx_to_%dpx\n", Size.first, Size.second);
+
+		Helper::RGBAIMAGE Source = GenerateImage(Size.first);
+		Helper::RGBAIMAGE Destination;
+		for (const std::pair<int, const char*>& Filter : Filters)
+		{
+			AppendResult(CaseFields, Filter.second, MeasureStage(Options, [&]() {
+				Helper::ResampleImage(Source, Size.second, Size.second, Filter.first, &Destination);
+				return uint64_t(Destination.pixels[0]);
+			}), Results);
+		}
+
+		AppendResult(CaseFields, "naiveBilinear", MeasureStage(Options, [&]() {
+			ResampleNaively(Source, Size.second, Size.second, &Destination);
+			return uint64_t(Destination.pixels[0]);
+		}), Results);
+	}
+}
+
+/**
+ * Generate an RGBA image looking like a cursor: an opaque disc with colored gradients,
+ * an antialiased border and transparent corners.
+ *
+ * @param Size the width and height of the image.
+ * @return The generated image.
+ */
+MouseCursorSizeHelper::RGBAIMAGE CursorSizeBenchmark::GenerateImage(const int& Size)
+{
+	Helper::RGBAIMAGE Image;
+	Image.width = Size;
+	Image.height = Size;
+	Image.pixels.resize(size_t(Size) * size_t(Size) * BYTES_PER_PIXEL);
+
+	float Radius = float(Size) / 2.0F;
+	for (int y = 0; y < Size; y++)
+	{
+		for (int x = 0; x < Size; x++)
+		{
+			uint8_t* Pixel = Image.pixels.data() + (size_t(y) * Size + x) * BYTES_PER_PIXEL;
+			float Distance = std::hypot(float(x) + 0.5F - Radius, float(y) + 0.5F - Radius);
+			Pixel[0] = uint8_t(x * 255 / Size);
+			Pixel[1] = uint8_t(y * 255 / Size);
+			Pixel[2] = uint8_t((x ^ y) & 0xFF);
+			Pixel[3] = uint8_t(std::min(std::max(Radius - Distance, 0.0F), 1.0F) * 255.0F);
+		}
+	}
+
+	return Image;
+}
+
+/**
+ * Resample an image with a bilinear interpolation of the 4 nearest source pixels, the way
+ * a scaler is usually written: the weights are computed for each pixel, the alpha is not
+ * premultiplied, the reduced images are not filtered and everything runs on one thread.
+ *
+ * @param Source the image to resample.
+ * @param Width the width of the resampled image.
+ * @param Height the height of the resampled image.
+ * @param Destination the resampled image.
+ */
+void CursorSizeBenchmark::ResampleNaively(const Helper::RGBAIMAGE& Source, const int& Width, const int& Height, Helper::RGBAIMAGE* Destination)
+{
+	Destination->width = Width;
+	Destination->height = Height;
+	Destination->pixels.resize(size_t(Width) * size_t(Height) * BYTES_PER_PIXEL);
+
+	for (int y = 0; y < Height; y++)
+	{
+		for (int x = 0; x < Width; x++)
+		{
+			float SourceX = std::min(std::max((float(x) + 0.5F) * Source.width / Width - 0.5F, 0.0F), float(Source.width - 1));
+			float SourceY = std::min(std::max((float(y) + 0.5F) * Source.height / Height - 0.5F, 0.0F), float(Source.height - 1));
+			int X0 = int(SourceX);
+			int Y0 = int(SourceY);
+			int X1 = std::min(X0 + 1, Source.width - 1);
+			int Y1 = std::min(Y0 + 1, Source.height - 1);
+			float FractionX = SourceX - float(X0);
+			float FractionY = SourceY - float(Y0);
+
+			for (int Channel = 0; Channel < BYTES_PER_PIXEL; Channel++)
+			{
+				auto SourceValue = [&](const int& IndexX, const int& IndexY) {
+					return float(Source.pixels[(size_t(IndexY) * Source.width + IndexX) * BYTES_PER_PIXEL + Channel]);
+				};
+				float Top = SourceValue(X0, Y0) + (SourceValue(X1, Y0) - SourceValue(X0, Y0)) * FractionX;
+				float Bottom = SourceValue(X0, Y1) + (SourceValue(X1, Y1) - SourceValue(X0, Y1)) * FractionX;
+				Destination->pixels[(size_t(y) * Width + x) * BYTES_PER_PIXEL + Channel] = uint8_t(Top + (Bottom - Top) * FractionY + 0.5F);
+			}
+		}
+	}
+}
+
+/**
+ * Time a stage. The number of calls of a repetition is doubled until a repetition lasts the
+ * minimum time, then the repetitions are timed and the heap allocations are counted.
+ *
+ * @param Options the options of the benchmark.
+ * @param Stage the function running the stage once, returning a value depending on its result.
+ * @return The timings of a call of the stage.
+ */
+template <typename STAGEFUNCTION>
+CursorSizeBenchmark::STAGERESULT CursorSizeBenchmark::MeasureStage(const BENCHMARKOPTIONS& Options, const STAGEFUNCTION& Stage)
+{
+	auto TimeCalls = [&](const uint64_t& Iterations)
+	{
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < Iterations; i++)
+		{
+			Sink = Sink + Stage();
+		}
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	};
+
+	STAGERESULT Result;
+	Result.iterations = 1;
+	while (TimeCalls(Result.iterations) < Options.minTime && Result.iterations < (uint64_t(1) << 40))
+	{
+		Result.iterations *= 2;
+	}
+
+	std::vector<double> Times;
+	uint64_t Allocations = AllocationsCount.load();
+	for (int i = 0; i < Options.repetitionsCount; i++)
+	{
+		Times.push_back(TimeCalls(Result.iterations) * 1e9 / double(Result.iterations));
+	}
+	Allocations = AllocationsCount.load() - Allocations;
+
+	std::sort(Times.begin(), Times.end());
+	Result.medianTime = Times[Times.size() / 2];
+	Result.minTime = Times[0];
+	Result.allocations = double(Allocations) / double(Result.iterations * Options.repetitionsCount);
+
+	return Result;
+}
+
+/**
+ * Append the result of a stage to the JSON results, one object per line.
+ *
+ * @param CaseFields the JSON fields describing the case, without braces.
+ * @param Stage the name of the stage.
+ * @param Result the timings of the stage.
+ * @param Results the JSON results receiving the result.
+ */
+void CursorSizeBenchmark::AppendResult(const std::string& CaseFields, const std::string& Stage, const STAGERESULT& Result, std::string* Results)
+{
+	char Fields[256];
+	std::snprintf(Fields, sizeof(Fields), ",\"stage\":\"%s\",\"iterations\":%llu,\"medianNs\":%.2f,\"minNs\":%.2f,\"allocationsPerCall\":%.2f}",
+		Stage.c_str(), (unsigned long long)Result.iterations, Result.medianTime, Result.minTime, Result.allocations);
+
+	*Results += (Results->empty() ? "    {" : ",\n    {") + CaseFields + Fields;
+}
+
+int main(int argc, char** argv)
+{
+	CursorSizeBenchmark::BENCHMARKOPTIONS Options;
+
+	if (!CursorSizeBenchmark::ParseArguments(argc, argv, &Options))
+	{
+		std::fprintf(stderr, "Usage : %s [--time milliseconds] [--repetitions count] [--check-allocations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::error_code Error;
+	std::filesystem::path Directory = std::filesystem::temp_directory_path(Error) / "CursorSizeBenchmark";
+	std::filesystem::create_directories(Directory, Error);
+
+	std::vector<CursorSizeBenchmark::BENCHMARKCASE> Cases = CursorSizeBenchmark::GenerateCases(Directory.string());
+	bool IsSucceeded = true;
+	if (Options.isAllocationsCheck)
+	{
+		IsSucceeded = CursorSizeBenchmark::CheckAllocations(Cases);
+		std::fprintf(stderr, IsSucceeded ? "No allocation in the warmed up queries\n" : "Allocations in the warmed up queries\n");
+	}
+	else
+	{
+		CursorSizeBenchmark::Run(Options, Cases);
+	}
+
+	std::filesystem::remove_all(Directory, Error);
+
+	return IsSucceeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
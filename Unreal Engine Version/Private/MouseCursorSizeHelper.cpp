@@ -8,32 +8,125 @@
 
 #include "MouseCursorSizeHelper.h"
 
+#include "HAL/FileManager.h"
+#include "Stats/Stats.h"
+
 #include <stdint.h>
 
+// Counters and timings of the queries, shown with the "stat MouseCursorSizeHelper" console command
+DECLARE_STATS_GROUP(TEXT("MouseCursorSizeHelper"), STATGROUP_MouseCursorSizeHelper, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Query"), STAT_MouseCursorSizeQuery, STATGROUP_MouseCursorSizeHelper);
+DECLARE_CYCLE_STAT(TEXT("Read settings"), STAT_MouseCursorSizeReadSettings, STATGROUP_MouseCursorSizeHelper);
+DECLARE_CYCLE_STAT(TEXT("Open file"), STAT_MouseCursorSizeOpenFile, STATGROUP_MouseCursorSizeHelper);
+DECLARE_CYCLE_STAT(TEXT("Select frame"), STAT_MouseCursorSizeSelectFrame, STATGROUP_MouseCursorSizeHelper);
+DECLARE_CYCLE_STAT(TEXT("Compute size"), STAT_MouseCursorSizeComputeSize, STATGROUP_MouseCursorSizeHelper);
+DECLARE_CYCLE_STAT(TEXT("Scale"), STAT_MouseCursorSizeScale, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Calls"), STAT_MouseCursorSizeCalls, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cache hits"), STAT_MouseCursorSizeCacheHits, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Bytes read"), STAT_MouseCursorSizeBytesRead, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Frames decoded"), STAT_MouseCursorSizeFramesDecoded, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Default size fallbacks"), STAT_MouseCursorSizeDefaultSizeFallbacks, STATGROUP_MouseCursorSizeHelper);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Smallest frame fallbacks"), STAT_MouseCursorSizeSmallestFrameFallbacks, STATGROUP_MouseCursorSizeHelper);
+
+FCriticalSection UMouseCursorSizeHelper::CacheCriticalSection;
+UMouseCursorSizeHelper::FCursorSizeCache UMouseCursorSizeHelper::SizeCache = {};
+std::atomic<uint64> UMouseCursorSizeHelper::CacheHits(0);
+std::atomic<uint64> UMouseCursorSizeHelper::CacheMisses(0);
+
  /**
   * Get the real current mouse cursor size with scales.
+  * The size is memoized and only computed again when the fingerprint
+  * of the cursor file or of the settings changed.
   *
   * @return The pair of the real mouse cursor width and height.
   */
 FVector2f UMouseCursorSizeHelper::GetCurrentMouseCursorSize()
+{
+	SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeQuery);
+	INC_DWORD_STAT(STAT_MouseCursorSizeCalls);
+
+	FCursorFingerprint Fingerprint = GetCurrentFingerprint();
+	uint64 Generation = 0;
+
+	{
+		FScopeLock Lock(&CacheCriticalSection);
+		if (SizeCache.isValid && IsSameFingerprint(SizeCache.fingerprint, Fingerprint))
+		{
+			CacheHits++;
+			INC_DWORD_STAT(STAT_MouseCursorSizeCacheHits);
+			return SizeCache.size;
+		}
+		Generation = SizeCache.generation;
+	}
+
+	CacheMisses++;
+	FVector2f CursorSize = ComputeCurrentMouseCursorSize(Fingerprint.settings);
+
+	// A size computed while the cache was invalidated may be outdated, so it is not memoized
+	FScopeLock Lock(&CacheCriticalSection);
+	if (SizeCache.generation == Generation)
+	{
+		SizeCache.isValid = true;
+		SizeCache.fingerprint = Fingerprint;
+		SizeCache.size = CursorSize;
+	}
+
+	return CursorSize;
+}
+
+/**
+ * Forget the memoized mouse cursor size. The next call of
+ * GetCurrentMouseCursorSize will compute the size again.
+ */
+void UMouseCursorSizeHelper::Invalidate()
+{
+	FScopeLock Lock(&CacheCriticalSection);
+	SizeCache.isValid = false;
+	SizeCache.generation++;
+}
+
+/**
+ * Get the counters of the memoized mouse cursor size.
+ *
+ * @return The number of cache hits and misses since the start of the program.
+ */
+UMouseCursorSizeHelper::FCacheStatistics UMouseCursorSizeHelper::GetCacheStatistics()
+{
+	FCacheStatistics Statistics;
+	Statistics.hits = CacheHits.load();
+	Statistics.misses = CacheMisses.load();
+
+	return Statistics;
+}
+
+/**
+ * Compute the real current mouse cursor size with scales, without the memoized size.
+ *
+ * @param Settings the settings read from the system.
+ * @return The Vector2f of the real mouse cursor width and height.
+ */
+FVector2f UMouseCursorSizeHelper::ComputeCurrentMouseCursorSize(const FCursorSettings& Settings)
 {
 	FSizedata SizeData;
 	SizeData.width = DEFAULT_IMAGE_CURSOR_SIZE;
 	SizeData.height = DEFAULT_IMAGE_CURSOR_SIZE;
 	SizeData.isRealSize = false;
+	SizeData.isBottomUp = false;
 
-	TArray<uint32> PixelArray = GetPixelArrayOfCurrentMouseImage(&SizeData);
+	TArray<uint32> PixelArray = GetPixelArrayOfCurrentMouseImage(Settings, &SizeData);
 
 	// Compute the origin real size of mouse cursor
 	FVector2f CursorSize = ComputeCursorSizeFromPixelArray(PixelArray, SizeData);
 
 	if (!SizeData.isRealSize)
 	{
+		SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeScale);
+
 		// Scale mouse cursor size by DPI
-		ScaleCursorSizeByDPI(&CursorSize);
+		ScaleCursorSizeByDPI(&CursorSize, Settings.dpiScale);
 
 		// Scale mouse cursor size by defined system mouse size
-		ScaleCursorSizeByMouseSystemScale(&CursorSize);
+		ScaleCursorSizeByMouseSystemScale(&CursorSize, Settings.mouseScale);
 	}
 
 	// Ceil mouse cursor size
@@ -42,6 +135,59 @@ FVector2f UMouseCursorSizeHelper::GetCurrentMouseCursorSize()
 	return CursorSize;
 }
 
+/**
+ * Read all the settings needed to compute the mouse cursor size.
+ *
+ * @return The settings read from the system.
+ */
+UMouseCursorSizeHelper::FCursorSettings UMouseCursorSizeHelper::ReadCursorSettings()
+{
+	SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeReadSettings);
+
+	FCursorSettings Settings;
+
+	Settings.cursorPath = GetRegistryValueString(REG_CURSOR_SOURCES, REG_KEY_CURSOR_FILE);
+	PurifyPath(&Settings.cursorPath);
+	Settings.cursorBaseSize = GetRegistryValueFloat(REG_CURSOR_SOURCES, REG_KEY_CURSOR_BASE_SIZE, -1);
+	Settings.mouseScale = GetMouseCursorScale();
+	Settings.dpiScale = GetDPIScale();
+
+	return Settings;
+}
+
+/**
+ * Get the fingerprint of the current settings and cursor file.
+ * This only needs the settings and a stat of the file, not its content.
+ *
+ * @return The fingerprint of the current mouse cursor.
+ */
+UMouseCursorSizeHelper::FCursorFingerprint UMouseCursorSizeHelper::GetCurrentFingerprint()
+{
+	FCursorFingerprint Fingerprint;
+
+	Fingerprint.settings = ReadCursorSettings();
+	GetFileSizeAndModificationTime(Fingerprint.settings.cursorPath, &Fingerprint.fileSize, &Fingerprint.fileModificationTime);
+
+	return Fingerprint;
+}
+
+/**
+ * Check if two fingerprints are the same.
+ *
+ * @param First the first fingerprint to compare.
+ * @param Second the second fingerprint to compare.
+ * @return True if both fingerprints give the same mouse cursor size.
+ */
+bool UMouseCursorSizeHelper::IsSameFingerprint(const FCursorFingerprint& First, const FCursorFingerprint& Second)
+{
+	return First.fileSize == Second.fileSize
+		&& First.fileModificationTime == Second.fileModificationTime
+		&& First.settings.cursorBaseSize == Second.settings.cursorBaseSize
+		&& First.settings.mouseScale == Second.settings.mouseScale
+		&& First.settings.dpiScale == Second.settings.dpiScale
+		&& First.settings.cursorPath == Second.settings.cursorPath;
+}
+
 /**
  * Initialize FirstLastIndexes structure.
  *
@@ -90,15 +236,18 @@ int UMouseCursorSizeHelper::GetIndexOfSmallestPicture(const TArray<FIcondirentry
  * Get the index of the desired frame in array of pictures.
  *
  * @param Pictures the array of pictures.
+ * @param Settings the settings read from the system.
  * @param SizeData the size informations.
  * @return The index of the desired frame in array of pictures.
  * If the desired frame is not founnd, the index of the smallest one is returned.
  */
-int UMouseCursorSizeHelper::GetIndexOfDesiredFrame(const TArray<FIcondirentry>& Pictures, FSizedata* SizeData)
+int UMouseCursorSizeHelper::GetIndexOfDesiredFrame(const TArray<FIcondirentry>& Pictures, const FCursorSettings& Settings, FSizedata* SizeData)
 {
+	SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeSelectFrame);
+
 	int Index = -1;
-	float CursorBaseSize = GetRegistryValueFloat(REG_CURSOR_SOURCES, REG_KEY_CURSOR_BASE_SIZE, -1);
-	float AppliedDPI = GetDPIScale() / 100.0F;
+	float CursorBaseSize = Settings.cursorBaseSize;
+	float AppliedDPI = Settings.dpiScale / 100.0F;
 
 	if (CursorBaseSize != -1)
 	{
@@ -117,27 +266,30 @@ int UMouseCursorSizeHelper::GetIndexOfDesiredFrame(const TArray<FIcondirentry>&
 	if (Index == -1)
 	{
 		Index = GetIndexOfSmallestPicture(Pictures);
+		if (CursorBaseSize != -1)
+		{
+			INC_DWORD_STAT(STAT_MouseCursorSizeSmallestFrameFallbacks);
+		}
 	}
 
 	return Index;
 }
 
 /**
- * Invert the lines order of an array to iinvert its height.
+ * Invert the lines order of an array to invert its height, in place.
  *
  * @param Array the array to be processed.
  * @param SizeData the size informations.
  */
-void UMouseCursorSizeHelper::InvertArrayHeight(TArray<uint32>* Array, const FSizedata& SizeData)
+void UMouseCursorSizeHelper::InvertArrayHeight(TArray<uint32>* Array, FSizedata* SizeData)
 {
-	TArray<uint32> TempArray;
-	TempArray.Append(*Array);
-
-	for (int y = 0, yInverted = SizeData.height - 1; y < SizeData.height && yInverted >= 0; y++, yInverted--) {
-		for (int x = 0; x < SizeData.width; x++) {
-			(*Array)[y * SizeData.width + x] = TempArray[yInverted * SizeData.width + x];
+	for (int y = 0, yInverted = SizeData->height - 1; y < yInverted; y++, yInverted--) {
+		for (int x = 0; x < SizeData->width; x++) {
+			Array->Swap(y * SizeData->width + x, yInverted * SizeData->width + x);
 		}
 	}
+
+	SizeData->isBottomUp = !SizeData->isBottomUp;
 }
 
 /**
@@ -150,22 +302,27 @@ void UMouseCursorSizeHelper::InvertArrayHeight(TArray<uint32>* Array, const FSiz
  */
 TArray<uint32> UMouseCursorSizeHelper::ExtractPixels(std::ifstream& File, const FBitmapinfoheader& BmpHeader, FSizedata* SizeData)
 {
+	SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeComputeSize);
 	TArray<uint32> Pixels = {};
 
 	// Validate size and format
 	if (BmpHeader.biBitCount == 32 && BmpHeader.biCompression == BI_RGB) {
+		INC_DWORD_STAT(STAT_MouseCursorSizeFramesDecoded);
 		SizeData->width = BmpHeader.biWidth;
 		SizeData->height = FMath::Abs(BmpHeader.biHeight) / 2; // Half the height is for the mask
+		SizeData->isBottomUp = true; // The lines of a DIB are stored from bottom to top
 		Pixels.SetNum(SizeData->width * SizeData->height);
 
 		// Read the pixels (colors and alpha channel)
 		File.read(reinterpret_cast<char*>(Pixels.GetData()), Pixels.Num() * sizeof(uint32));
+		INC_DWORD_STAT_BY(STAT_MouseCursorSizeBytesRead, File.gcount());
 
 		// Read the mask (1 byte per pixel)
 		int MaskWidth = ((SizeData->width + 31) / 32) * BYTES_PER_PIXEL; // Width rounded to the nearest multiple of 32 bits
 		TArray<uint8> Mask;
 		Mask.SetNum(MaskWidth * SizeData->height);
 		File.read(reinterpret_cast<char*>(Mask.GetData()), Mask.Num());
+		INC_DWORD_STAT_BY(STAT_MouseCursorSizeBytesRead, File.gcount());
 
 		// Combine pixels and mask to set transparency
 		for (int y = 0; y < SizeData->height; y++) {
@@ -179,9 +336,6 @@ TArray<uint32> UMouseCursorSizeHelper::ExtractPixels(std::ifstream& File, const
 				}
 			}
 		}
-
-		// Invert the height to put the array right side up
-		InvertArrayHeight(&Pixels, *SizeData);
 	}
 
 	return Pixels;
@@ -192,10 +346,11 @@ TArray<uint32> UMouseCursorSizeHelper::ExtractPixels(std::ifstream& File, const
  *
  * @param File the file of the cursor icon.
  * @param Header the header with metadatas of the cursor icon.
+ * @param Settings the settings read from the system.
  * @param SizeData the size informations.
  * @return The pixel array of the mouse cursor picture.
  */
-TArray<uint32> UMouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, const FIcondir& Header, FSizedata* SizeData)
+TArray<uint32> UMouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, const FIcondir& Header, const FCursorSettings& Settings, FSizedata* SizeData)
 {
 	TArray<uint32> PixelArray = {};
 
@@ -205,9 +360,10 @@ TArray<uint32> UMouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, c
 		TArray<FIcondirentry> Pictures;
 		Pictures.SetNum(Header.idCount);
 		File.read(reinterpret_cast<char*>(Pictures.GetData()), Header.idCount * sizeof(FIcondirentry));
+		INC_DWORD_STAT_BY(STAT_MouseCursorSizeBytesRead, File.gcount());
 
 		// Read data for the smallest frame of the file
-		int SmallestFrameIndex = GetIndexOfDesiredFrame(Pictures, SizeData);
+		int SmallestFrameIndex = GetIndexOfDesiredFrame(Pictures, Settings, SizeData);
 		if (SmallestFrameIndex >= 0 && SmallestFrameIndex < Pictures.Num())
 		{
 			FIcondirentry& Entry = Pictures[SmallestFrameIndex];
@@ -215,6 +371,7 @@ TArray<uint32> UMouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, c
 
 			FBitmapinfoheader BmpHeader;
 			File.read(reinterpret_cast<char*>(&BmpHeader), sizeof(FBitmapinfoheader));
+			INC_DWORD_STAT_BY(STAT_MouseCursorSizeBytesRead, File.gcount());
 
 			PixelArray = ExtractPixels(File, BmpHeader, SizeData);
 		}
@@ -226,26 +383,30 @@ TArray<uint32> UMouseCursorSizeHelper::GetCursorFileDatas(std::ifstream& File, c
 /**
  * Get bits array of mouse cursor image from its BITMAP with Windows library.
  *
+ * @param Settings the settings read from the system.
  * @param SizeData the size informations.
  * @return The pixel array of the mouse cursor picture.
  */
-TArray<uint32> UMouseCursorSizeHelper::GetPixelArrayOfCurrentMouseImage(FSizedata* SizeData)
+TArray<uint32> UMouseCursorSizeHelper::GetPixelArrayOfCurrentMouseImage(const FCursorSettings& Settings, FSizedata* SizeData)
 {
 	TArray<uint32> PixelArray = {};
-	std::string CursorFileName = GetRegistryValueString(REG_CURSOR_SOURCES, REG_KEY_CURSOR_FILE);
 
-	PurifyPath(&CursorFileName);
-	if (!CursorFileName.empty())
+	if (!Settings.cursorPath.empty())
 	{
-		std::ifstream File(CursorFileName, std::ios::binary);
+		std::ifstream File;
+		{
+			SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeOpenFile);
+			File.open(Settings.cursorPath, std::ios::binary);
+		}
 
 		if (!File.fail() && File.is_open()) {
 
 			// Read the header (ICONDIR)
 			FIcondir Header;
 			File.read(reinterpret_cast<char*>(&Header), sizeof(FIcondir));
+			INC_DWORD_STAT_BY(STAT_MouseCursorSizeBytesRead, File.gcount());
 
-			PixelArray = GetCursorFileDatas(File, Header, SizeData);
+			PixelArray = GetCursorFileDatas(File, Header, Settings, SizeData);
 
 			File.close();
 		}
@@ -256,6 +417,7 @@ TArray<uint32> UMouseCursorSizeHelper::GetPixelArrayOfCurrentMouseImage(FSizedat
 
 /**
  * Compute the mouse cursor size from its image pixels array.
+ * The lines are read from top to bottom, whatever their order in the array.
  *
  * @param PixelArray the pixels array of the mouse cursor image.
  * @param SizeData the size informations.
@@ -263,8 +425,14 @@ TArray<uint32> UMouseCursorSizeHelper::GetPixelArrayOfCurrentMouseImage(FSizedat
  */
 FVector2f UMouseCursorSizeHelper::ComputeCursorSizeFromPixelArray(const TArray<uint32>& PixelArray, const FSizedata& SizeData)
 {
+	SCOPE_CYCLE_COUNTER(STAT_MouseCursorSizeComputeSize);
 	FVector2f CursorSize = FVector2f(DEFAULT_ORIGIN_MOUSE_WIDTH, DEFAULT_ORIGIN_MOUSE_HEIGHT);
 
+	if (PixelArray.IsEmpty())
+	{
+		INC_DWORD_STAT(STAT_MouseCursorSizeDefaultSizeFallbacks);
+	}
+
 	if (!PixelArray.IsEmpty())
 	{
 		FFirstlastindexes FirstLastIndexes = InitFirstLastIndexesStruct();
@@ -273,8 +441,10 @@ FVector2f UMouseCursorSizeHelper::ComputeCursorSizeFromPixelArray(const TArray<u
 
 		// Compute the first and last indexes from the valid pixels
 		for (int y = 0; y < SizeData.height; y++) {
+			int LineIndex = SizeData.isBottomUp ? SizeData.height - 1 - y : y;
+
 			for (int x = 0; x < SizeData.width; x++) {
-				uint32 Pixel = PixelArray[y * SizeData.width + x];
+				uint32 Pixel = PixelArray[LineIndex * SizeData.width + x];
 				uint8 Alpha = (Pixel >> 24) & 0xFF;
 
 				GetFirstAndLastIndexesFromPixel(Alpha, &FirstLastIndexes, x, y);
@@ -342,11 +512,10 @@ void UMouseCursorSizeHelper::GetFirstAndLastIndexesFromPixel(const uint8& Alpha,
  * Scale the real mouse cursor size depending on the mouse cursor size multiplier defined on the system.
  *
  * @param CursorSize the real mouse cursor size to scale.
+ * @param MouseScale the mouse cursor size multiplier defined on the system.
  */
-void UMouseCursorSizeHelper::ScaleCursorSizeByMouseSystemScale(FVector2f* CursorSize)
+void UMouseCursorSizeHelper::ScaleCursorSizeByMouseSystemScale(FVector2f* CursorSize, const float& MouseScale)
 {
-	float MouseScale = GetMouseCursorScale();
-
 	CursorSize->X = CursorSize->X + (MouseScale - 1) * (CursorSize->X / 2);
 	CursorSize->Y = CursorSize->Y + (MouseScale - 1) * (CursorSize->Y / 2);
 }
@@ -355,10 +524,11 @@ void UMouseCursorSizeHelper::ScaleCursorSizeByMouseSystemScale(FVector2f* Cursor
  * Scale the real mouse cursor size depending on the DPI defined on the system.
  *
  * @param CursorSize the real mouse cursor size to scale.
+ * @param DpiScale the DPI scale defined on the system, in percent.
  */
-void UMouseCursorSizeHelper::ScaleCursorSizeByDPI(FVector2f* CursorSize)
+void UMouseCursorSizeHelper::ScaleCursorSizeByDPI(FVector2f* CursorSize, const float& DpiScale)
 {
-	float AppliedDPI = GetDPIScale() / 100.0F;
+	float AppliedDPI = DpiScale / 100.0F;
 
 	CursorSize->X *= AppliedDPI;
 	CursorSize->Y *= AppliedDPI;
@@ -428,6 +598,31 @@ void UMouseCursorSizeHelper::CeilVector2f(FVector2f* Vector2f)
 	Vector2f->Y = FMath::CeilToFloat(Vector2f->Y);
 }
 
+/**
+ * Get the size and the last modification time of a file without opening it.
+ *
+ * @param Path the path of the file.
+ * @param FileSize the size of the file, -1 if the file is not found.
+ * @param ModificationTime the last modification time of the file, 0 if the file is not found.
+ */
+void UMouseCursorSizeHelper::GetFileSizeAndModificationTime(const std::string& Path, int64* FileSize, int64* ModificationTime)
+{
+	*FileSize = -1;
+	*ModificationTime = 0;
+
+	if (!Path.empty())
+	{
+		IFileManager& FileManager = IFileManager::Get();
+		FString FilePath = ANSI_TO_TCHAR(Path.c_str());
+
+		*FileSize = FileManager.FileSize(*FilePath);
+		if (*FileSize >= 0)
+		{
+			*ModificationTime = FileManager.GetTimeStamp(*FilePath).GetTicks();
+		}
+	}
+}
+
 /**
  * Get the value in float format of registry key passed as parameter.
  *
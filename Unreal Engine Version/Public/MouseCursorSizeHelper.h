@@ -14,6 +14,7 @@
 #include <vector>
 #include <fstream>
 #include <map>
+#include <atomic>
 
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
@@ -55,6 +56,25 @@ public:
     UFUNCTION(BlueprintCallable, BlueprintPure)
     static FVector2f GetCurrentMouseCursorSize();
 
+    /**
+    * Forget the memoized mouse cursor size. The next call of
+    * GetCurrentMouseCursorSize will compute the size again.
+    */
+    UFUNCTION(BlueprintCallable)
+    static void Invalidate();
+
+    struct FCacheStatistics {
+        uint64 hits;                  // Calls answered with the memoized size
+        uint64 misses;                // Calls which computed the size again
+    };
+
+    /**
+    * Get the counters of the memoized mouse cursor size.
+    *
+    * @return The number of cache hits and misses since the start of the program.
+    */
+    static FCacheStatistics GetCacheStatistics();
+
 private:
     struct FBitmapinfoheader {
         uint32 biSize;                // Header size
@@ -101,19 +121,50 @@ private:
         int width;                      // Picture width
         int height;                     // Picture height
         bool isRealSize;                // The corresponding size was found
+        bool isBottomUp;                // The lines of the picture are stored from bottom to top
+    };
+
+    struct FCursorSettings {
+        std::string cursorPath;         // Purified path of the cursor file
+        float cursorBaseSize;           // Cursor base size (-1 if not defined)
+        float mouseScale;               // Mouse cursor size multiplier
+        float dpiScale;                 // DPI scale in percent
+    };
+
+    struct FCursorFingerprint {
+        FCursorSettings settings;       // Settings used to compute the size
+        int64 fileSize;                 // Size of the cursor file (-1 if not found)
+        int64 fileModificationTime;     // Last modification time of the cursor file
+    };
+
+    struct FCursorSizeCache {
+        bool isValid;                   // The memoized size can be used
+        uint64 generation;              // Number of invalidations, a size computed before one of them is not memoized
+        FCursorFingerprint fingerprint; // Fingerprint of the memoized size
+        FVector2f size;                 // Memoized mouse cursor size
     };
 
+    static FCriticalSection CacheCriticalSection;
+    static FCursorSizeCache SizeCache;
+    static std::atomic<uint64> CacheHits;
+    static std::atomic<uint64> CacheMisses;
+
+    static FVector2f ComputeCurrentMouseCursorSize(const FCursorSettings& Settings);
+    static FCursorSettings ReadCursorSettings();
+    static FCursorFingerprint GetCurrentFingerprint();
+    static bool IsSameFingerprint(const FCursorFingerprint& First, const FCursorFingerprint& Second);
     static FFirstlastindexes InitFirstLastIndexesStruct();
     static int GetIndexOfSmallestPicture(const TArray<FIcondirentry>& Pictures);
-    static int GetIndexOfDesiredFrame(const TArray<FIcondirentry>& Pictures, FSizedata* SizeData);
-    static void InvertArrayHeight(TArray<uint32>* Array, const FSizedata& SizeData);
+    static int GetIndexOfDesiredFrame(const TArray<FIcondirentry>& Pictures, const FCursorSettings& Settings, FSizedata* SizeData);
+    static void InvertArrayHeight(TArray<uint32>* Array, FSizedata* SizeData);
     static TArray<uint32> ExtractPixels(std::ifstream& File, const FBitmapinfoheader& BmpHeader, FSizedata* SizeData);
-    static TArray<uint32> GetCursorFileDatas(std::ifstream& File, const FIcondir& Header, FSizedata* SizeData);
-    static TArray<uint32> GetPixelArrayOfCurrentMouseImage(FSizedata* SizeData);
+    static TArray<uint32> GetCursorFileDatas(std::ifstream& File, const FIcondir& Header, const FCursorSettings& Settings, FSizedata* SizeData);
+    static TArray<uint32> GetPixelArrayOfCurrentMouseImage(const FCursorSettings& Settings, FSizedata* SizeData);
     static FVector2f ComputeCursorSizeFromPixelArray(const TArray<uint32>& PixelArray, const FSizedata& SizeData);
     static void GetFirstAndLastIndexesFromPixel(const uint8& Alpha, FFirstlastindexes* IndexesStruct, const int& IndexX, const int& IndexY);
-    static void ScaleCursorSizeByMouseSystemScale(FVector2f* CursorSize);
-    static void ScaleCursorSizeByDPI(FVector2f* CursorSize);
+    static void ScaleCursorSizeByMouseSystemScale(FVector2f* CursorSize, const float& MouseScale);
+    static void ScaleCursorSizeByDPI(FVector2f* CursorSize, const float& DpiScale);
+    static void GetFileSizeAndModificationTime(const std::string& Path, int64* FileSize, int64* ModificationTime);
     static float GetMouseCursorScale();
     static float GetDPIScaleOfWindowsSystem();
     static float GetDPIScale();